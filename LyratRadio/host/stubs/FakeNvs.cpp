@@ -0,0 +1,307 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "FakeNvs.h"
+
+#define NVS_ENTRY_SIZE 32
+#define NVS_KEY_SIZE 16 // with the terminating 0
+
+namespace {
+
+enum Type_e {
+    TypeI32,
+    TypeU32,
+    TypeStr,
+    TypeBlob,
+};
+
+typedef struct {
+    Type_e mType;
+    std::vector<uint8_t> mData;
+} Entry_t;
+
+std::mutex sMutex;
+std::map<std::string, Entry_t> sEntries;
+FakeNvs::Counters_t sCounters;
+size_t sCapacity = 0;
+FakeNvs::WriteHook_t sWriteHook = NULL;
+void* spWriteHookContext = NULL;
+
+///////////////////////////////////////////////////////////////////////////////
+size_t EntrySize(const Entry_t& entry)
+{
+    if (entry.mType == TypeI32 || entry.mType == TypeU32) {
+        return NVS_ENTRY_SIZE;
+    }
+    return NVS_ENTRY_SIZE + (entry.mData.size() + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE * NVS_ENTRY_SIZE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t UsedSize()
+{
+    size_t used = 0;
+    for (const auto& entry : sEntries) {
+        used += EntrySize(entry.second);
+    }
+    return used;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t Set(const char* key, Type_e type, const void* value, size_t length)
+{
+    if (key == NULL || strlen(key) >= NVS_KEY_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sWriteHook != NULL) {
+        sWriteHook(spWriteHookContext); // a flash write takes a while, others may run meanwhile
+    }
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCounters.mWrites++;
+
+    Entry_t entry;
+    entry.mType = type;
+    entry.mData.assign((const uint8_t*)value, (const uint8_t*)value + length);
+
+    if (sCapacity != 0) {
+        auto it = sEntries.find(key);
+        size_t old = (it != sEntries.end()) ? EntrySize(it->second) : 0;
+        if (UsedSize() - old + EntrySize(entry) > sCapacity) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+    }
+    sEntries[key] = entry;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// length is in/out for strings and blobs, NULL for numbers
+esp_err_t Get(const char* key, Type_e type, void* value, size_t* length)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCounters.mReads++;
+
+    auto it = sEntries.find(key);
+    if (it == sEntries.end() || it->second.mType != type) {
+        return ESP_ERR_NVS_NOT_FOUND; // a key of another type is not found either
+    }
+
+    const std::vector<uint8_t>& data = it->second.mData;
+    if (length != NULL) {
+        if (value == NULL) {
+            *length = data.size();
+            return ESP_OK;
+        }
+        if (*length < data.size()) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        *length = data.size();
+    }
+    memcpy(value, data.data(), data.size());
+    return ESP_OK;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// NVS api
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_flash_erase()
+{
+    FakeNvs::Erase();
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_open(const char*, nvs_open_mode, nvs_handle* out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void nvs_close(nvs_handle)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_set_i32(nvs_handle, const char* key, int32_t value)
+{
+    return Set(key, TypeI32, &value, sizeof(value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_set_u32(nvs_handle, const char* key, uint32_t value)
+{
+    return Set(key, TypeU32, &value, sizeof(value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_set_str(nvs_handle, const char* key, const char* value)
+{
+    return Set(key, TypeStr, value, strlen(value) + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_set_blob(nvs_handle, const char* key, const void* value, size_t length)
+{
+    return Set(key, TypeBlob, value, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_get_i32(nvs_handle, const char* key, int32_t* out_value)
+{
+    return Get(key, TypeI32, out_value, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_get_u32(nvs_handle, const char* key, uint32_t* out_value)
+{
+    return Get(key, TypeU32, out_value, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_get_str(nvs_handle, const char* key, char* out_value, size_t* length)
+{
+    return Get(key, TypeStr, out_value, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_get_blob(nvs_handle, const char* key, void* out_value, size_t* length)
+{
+    return Get(key, TypeBlob, out_value, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_erase_key(nvs_handle, const char* key)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCounters.mErases++;
+    return sEntries.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t nvs_commit(nvs_handle)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCounters.mCommits++;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE:
+        return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_LENGTH:
+        return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:
+        return "ERROR";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// test control
+///////////////////////////////////////////////////////////////////////////////
+void FakeNvs::Erase()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sEntries.clear();
+    sCounters = Counters_t();
+    sCapacity = 0;
+    sWriteHook = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FakeNvs::ClearCounters()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCounters = Counters_t();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FakeNvs::Counters_t FakeNvs::GetCounters()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sCounters;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FakeNvs::SetWriteHook(WriteHook_t hook, void* pContext)
+{
+    sWriteHook = hook;
+    spWriteHookContext = pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FakeNvs::SetCapacity(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sCapacity = bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t FakeNvs::GetUsed()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    return UsedSize();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool FakeNvs::Exists(const char* pKey)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sEntries.count(pKey) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int32_t FakeNvs::GetI32(const char* pKey)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    auto it = sEntries.find(pKey);
+    int32_t value = 0;
+    if (it != sEntries.end() && it->second.mType == TypeI32) {
+        memcpy(&value, it->second.mData.data(), sizeof(value));
+    }
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t FakeNvs::GetSize(const char* pKey)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    auto it = sEntries.find(pKey);
+    return (it != sEntries.end()) ? it->second.mData.size() : 0;
+}
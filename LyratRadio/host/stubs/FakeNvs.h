@@ -0,0 +1,51 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _FAKENVS_H_
+#define _FAKENVS_H_
+
+// In-memory NVS for the host tests: one namespace, typed entries, counters
+// of all flash accesses, an optional space limit and a hook into the writes.
+// The size of an entry follows the NVS layout: 32 bytes, strings and blobs
+// add their data in 32 byte spans.
+
+#include <stdint.h>
+#include <stddef.h>
+
+//////////////////////////////////////////////////////////////////////
+class FakeNvs {
+public:
+    typedef struct {
+        int mReads;   // nvs_get_*, found or not
+        int mWrites;  // nvs_set_*
+        int mErases;
+        int mCommits;
+    } Counters_t;
+
+    static void Erase();         // empty flash, counters, limit and hook cleared
+    static void ClearCounters();
+    static Counters_t GetCounters();
+
+    typedef void (*WriteHook_t)(void* pContext);
+    static void SetWriteHook(WriteHook_t hook, void* pContext); // called in each nvs_set_*, NULL: none
+
+    static void SetCapacity(size_t bytes); // 0: unlimited
+    static size_t GetUsed();
+
+    static bool Exists(const char* pKey);
+    static int32_t GetI32(const char* pKey); // 0 if not found
+    static size_t GetSize(const char* pKey); // data length of a string or blob
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
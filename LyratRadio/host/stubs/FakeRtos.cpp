@@ -0,0 +1,138 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "FakeRtos.h"
+
+#define FAKE_MAX_TASKS 64
+
+namespace {
+
+typedef struct {
+    TaskFunction_t mFunction;
+    void* mpParameters;
+    std::atomic<uint32_t> mNotifications;
+} Task_t;
+
+Task_t sTasks[FAKE_MAX_TASKS];
+std::atomic<int> sTaskCount(0);
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+BaseType_t xTaskCreate(TaskFunction_t function, const char*, uint32_t, void* parameters, UBaseType_t, TaskHandle_t* created)
+{
+    int i = sTaskCount.fetch_add(1);
+    if (i >= FAKE_MAX_TASKS) {
+        return pdFALSE;
+    }
+    sTasks[i].mFunction = function;
+    sTasks[i].mpParameters = parameters;
+    sTasks[i].mNotifications = 0;
+    if (created != NULL) {
+        *created = &sTasks[i];
+    }
+    return pdPASS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    ((Task_t*)task)->mNotifications++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// no task runs on the host, there is never anything to take
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t)
+{
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TickType_t xTaskGetTickCount()
+{
+    using namespace std::chrono;
+    return (TickType_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::mutex();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait)
+{
+    std::mutex* pMutex = (std::mutex*)mutex;
+    if (wait == portMAX_DELAY) {
+        pMutex->lock();
+        return pdTRUE;
+    }
+    return pMutex->try_lock() ? pdTRUE : pdFALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    ((std::mutex*)mutex)->unlock();
+    return pdTRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return new std::recursive_mutex();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t wait)
+{
+    std::recursive_mutex* pMutex = (std::recursive_mutex*)mutex;
+    if (wait == portMAX_DELAY) {
+        pMutex->lock();
+        return pdTRUE;
+    }
+    return pMutex->try_lock() ? pdTRUE : pdFALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+    ((std::recursive_mutex*)mutex)->unlock();
+    return pdTRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t FakeRtos::GetNotifications(TaskHandle_t task)
+{
+    return ((Task_t*)task)->mNotifications.exchange(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int FakeRtos::GetTaskCount()
+{
+    return sTaskCount.load();
+}
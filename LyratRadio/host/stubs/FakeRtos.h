@@ -0,0 +1,31 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _FAKERTOS_H_
+#define _FAKERTOS_H_
+
+// FreeRTOS tasks on the host are only registered: a test reads the
+// notifications a task got and runs its work by hand, so every test is
+// deterministic.
+
+#include "freertos/task.h"
+
+//////////////////////////////////////////////////////////////////////
+class FakeRtos {
+public:
+    static uint32_t GetNotifications(TaskHandle_t task); // since the last call
+    static int GetTaskCount();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
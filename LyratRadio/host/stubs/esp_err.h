@@ -0,0 +1,51 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _STUB_ESP_ERR_H_
+#define _STUB_ESP_ERR_H_
+
+// Host stand-in for the ESP-IDF error codes used by the firmware.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH (ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+const char* esp_err_to_name(esp_err_t code);
+
+// like ESP-IDF: an unexpected error aborts
+#define ESP_ERROR_CHECK(x)                                                                   \
+    do {                                                                                     \
+        esp_err_t err_rc_ = (x);                                                             \
+        if (err_rc_ != ESP_OK) {                                                             \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: %s at %s:%d\n", esp_err_to_name(err_rc_), \
+                __FILE__, __LINE__);                                                         \
+            abort();                                                                         \
+        }                                                                                    \
+    } while (0)
+
+#endif
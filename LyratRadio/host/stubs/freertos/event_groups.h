@@ -0,0 +1,20 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _STUB_EVENT_GROUPS_H_
+#define _STUB_EVENT_GROUPS_H_
+
+// Host stand-in, nothing of it is used by the units under test.
+
+#include "freertos/FreeRTOS.h"
+
+#endif
@@ -0,0 +1,29 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _STUB_TASK_H_
+#define _STUB_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// the task is registered, not run, see FakeRtos.h
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack, void* parameters,
+    UBaseType_t priority, TaskHandle_t* created);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+
+#endif
@@ -0,0 +1,47 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _STUB_NVS_H_
+#define _STUB_NVS_H_
+
+// Host stand-in for the NVS api, backed by the in-memory store of FakeNvs.h.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle;
+typedef nvs_handle nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode open_mode, nvs_handle* out_handle);
+void nvs_close(nvs_handle handle);
+
+esp_err_t nvs_set_i32(nvs_handle handle, const char* key, int32_t value);
+esp_err_t nvs_set_u32(nvs_handle handle, const char* key, uint32_t value);
+esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value);
+esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void* value, size_t length);
+
+esp_err_t nvs_get_i32(nvs_handle handle, const char* key, int32_t* out_value);
+esp_err_t nvs_get_u32(nvs_handle handle, const char* key, uint32_t* out_value);
+esp_err_t nvs_get_str(nvs_handle handle, const char* key, char* out_value, size_t* length);
+esp_err_t nvs_get_blob(nvs_handle handle, const char* key, void* out_value, size_t* length);
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char* key);
+esp_err_t nvs_commit(nvs_handle handle);
+
+#endif
@@ -0,0 +1,122 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// The settings types, the codec and the request parser run without heap:
+// every operator new of the test binary is counted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <string>
+
+#include "JsonReader.h"
+#include "NVSCodec.h"
+#include "TestRunner.h"
+
+static size_t sAllocs = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+    sAllocs++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// configuration request with a full station list, ids and urls as given
+static std::string ConfigurationRequest()
+{
+    std::string request = "{\"webradio\":{\"configuration\":{\"station_list\":[";
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        char station[160];
+        snprintf(station, sizeof(station),
+            "%s{\"st_id\":\"%08x-0601-11e8-ae97-52543be04c81\",\"st_url\":\"http://example.com/\\u00e4/%d\",\"st_decoder\":\"MP3\"}",
+            i > 0 ? "," : "", i, i);
+        request += station;
+    }
+    request += "],\"act_tune\":{\"st_id\":\"act\",\"st_url\":\"http://act.example.com\",\"st_decoder\":\"AAC\"}}}}";
+    return request;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(AllocationFreeSettings)
+{
+    static Settings_t settings;
+    static Settings_t copy;
+    static StationIndex index;
+    static uint8_t blob[4000];
+
+    size_t allocs = sAllocs;
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        char id[LYRAT_STATION_ID_SIZE];
+        snprintf(id, sizeof(id), "%08x-0601-11e8-ae97-52543be04c81", i);
+        settings.mStations.push_back(Station_t(id, "http://example.com/stream", "MP3"));
+    }
+    settings.mActTune = Station_t("act", "http://act.example.com", "AAC");
+    settings.mStations.erase(3);
+    settings.mStations.resize(LYRAT_MAX_STATIONS);
+    copy = settings;
+    index.Build(copy.mStations);
+
+    int count = 0;
+    size_t length = SerializeStations(blob, sizeof(blob), copy.mActTune, copy.mStations, count);
+    CHECK(ParseStations(blob, length, settings.mActTune, settings.mStations));
+    CHECK_EQ(sAllocs - allocs, 0u);
+
+    CHECK_EQ(count, LYRAT_MAX_STATIONS);
+    CHECK(settings.mStations == copy.mStations);
+    StationUuid_t uuid;
+    uuid.Parse(copy.mStations[5].mId.c_str());
+    CHECK_EQ(index.Find(uuid), 5);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(AllocationFreeRequest)
+{
+    static JsonReader json;
+    std::string request = ConfigurationRequest();
+    Station_t station;
+
+    size_t allocs = sAllocs;
+    CHECK(json.Parse(&request[0], request.size()));
+    int configuration = json.Find(json.Find(0, LYRAT_NET_WEBRADIO), LYRAT_NET_CONFIGURATION);
+    int stationList = json.Find(configuration, LYRAT_NET_STATIONLIST);
+    size_t size = LYRAT_NVS_STATIONS_HEADER;
+    for (int i = 0; i < json.ArraySize(stationList); i++) {
+        int token = json.ArrayItem(stationList, i);
+        station.mId.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_ID)));
+        station.mUrl.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_URL)));
+        station.mDecoder.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_DECODER)));
+        size += StationBlobSize(station);
+    }
+    CHECK_EQ(sAllocs - allocs, 0u);
+
+    CHECK_EQ(json.ArraySize(stationList), LYRAT_MAX_STATIONS);
+    CHECK(station.mUrl == "http://example.com/\xc3\xa4/31");
+    CHECK(size < 4000);
+}
@@ -0,0 +1,124 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <thread>
+
+#include "CommandQueue.h"
+#include "TestRunner.h"
+
+///////////////////////////////////////////////////////////////////////////////
+static bool Post(CommandQueue& queue, int cmd, int value)
+{
+    bool bNotify;
+    Command_t command = { cmd, value, TestRunner::Now() };
+    return queue.Push(command, bNotify);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(CommandQueueCoalesce)
+{
+    CommandQueue queue;
+    PendingCommands_t pending;
+    CHECK(!queue.Drain(pending));
+
+    bool bNotify;
+    Command_t command = { CmdNextStation, 0, 1 };
+    CHECK(queue.Push(command, bNotify));
+    CHECK(bNotify);
+    CHECK(queue.Push(command, bNotify));
+    CHECK(!bNotify); // consumer is already woken up
+    Post(queue, CmdChangeVolume, 5);
+    Post(queue, CmdChangeVolume, -2);
+    Post(queue, CmdSetOnOff, 1);
+
+    CHECK(queue.Drain(pending));
+    CHECK(!pending.mbStation);
+    CHECK_EQ(pending.mStationDelta, 2);
+    CHECK_EQ(pending.mStationTime, 1);
+    CHECK(!pending.mbVolume);
+    CHECK_EQ(pending.mVolumeDelta, 3);
+    CHECK(pending.mbOnOff && pending.mOn);
+    CHECK(!pending.mbResolved);
+
+    // an absolute value resets the relative changes before it
+    Post(queue, CmdPreviousStation, 0);
+    Post(queue, CmdSetStation, 7);
+    Post(queue, CmdNextStation, 0);
+    Post(queue, CmdChangeVolume, 5);
+    Post(queue, CmdSetVolume, 40);
+    CHECK(queue.Drain(pending));
+    CHECK(pending.mbStation);
+    CHECK_EQ(pending.mStation, 7);
+    CHECK_EQ(pending.mStationDelta, 1);
+    CHECK(pending.mbVolume);
+    CHECK_EQ(pending.mVolume, 40);
+    CHECK_EQ(pending.mVolumeDelta, 0);
+
+    // results of the resolver task are no station command, they don't start a switch time
+    Post(queue, CmdResolved, 0);
+    Post(queue, CmdResolved, 0);
+    CHECK(queue.Drain(pending));
+    CHECK(pending.mbResolved);
+    CHECK(!pending.mbStation);
+    CHECK_EQ(pending.mStationTime, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(CommandQueueFull)
+{
+    CommandQueue queue;
+    for (int i = 0; i < LYRAT_COMMAND_QUEUE_SIZE; i++) {
+        CHECK(Post(queue, CmdChangeVolume, 1));
+    }
+    CHECK(!Post(queue, CmdChangeVolume, 1));
+
+    PendingCommands_t pending;
+    CHECK(queue.Drain(pending));
+    CHECK_EQ(pending.mVolumeDelta, LYRAT_COMMAND_QUEUE_SIZE);
+    CHECK(Post(queue, CmdChangeVolume, 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// several producers against one consumer, no command is lost or doubled
+TEST(CommandQueueProducers)
+{
+    const int producers = 4;
+    const int commands = 20000;
+    CommandQueue queue;
+    std::thread threads[producers];
+
+    for (int p = 0; p < producers; p++) {
+        threads[p] = std::thread([&queue]() {
+            for (int i = 0; i < commands; i++) {
+                while (!Post(queue, CmdChangeVolume, 1)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    int total = 0;
+    PendingCommands_t pending;
+    while (total < producers * commands) {
+        if (queue.Drain(pending)) {
+            total += pending.mVolumeDelta;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    for (int p = 0; p < producers; p++) {
+        threads[p].join();
+    }
+    CHECK(!queue.Drain(pending));
+    CHECK_EQ(total, producers * commands);
+}
@@ -0,0 +1,60 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// Cost per sample of the gain element for the cases it sees in playback:
+// steady gain, a ramp, unity and silence. Cycles are host time stamp counter
+// cycles; they show the relation of the cases, not the cost on the LX6.
+
+#include <stdio.h>
+
+#include "GainStage.h"
+#include "TestRunner.h"
+
+#define BENCH_FRAMES 1024 // one chunk of the element, stereo
+#define BENCH_ROUNDS 2000
+
+static int16_t sSamples[BENCH_FRAMES * 2];
+
+///////////////////////////////////////////////////////////////////////////////
+// the chunk is processed in place again and again, the cost does not depend on the values
+static void Measure(const char* pCase, int volume, bool bMute, int rampMs)
+{
+    GainStage gain;
+    gain.SetFormat(44100, 2, 16);
+    gain.SetVolume(volume, 0);
+    gain.Process(sSamples, 1);
+    for (int s = 0; s < BENCH_FRAMES * 2; s++) {
+        sSamples[s] = (int16_t)(s * 37);
+    }
+
+    int64_t time = TestRunner::Now();
+    uint64_t cycles = TestRunner::Cycles();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        gain.Mute(bMute && (i & 1), rampMs);
+        gain.Process(sSamples, BENCH_FRAMES);
+    }
+    cycles = TestRunner::Cycles() - cycles;
+    time = TestRunner::Now() - time;
+
+    double samples = (double)BENCH_ROUNDS * BENCH_FRAMES * 2;
+    printf("  %-8s %6.2f ns/sample, %6.2f cycles/sample\n", pCase, time * 1000.0 / samples, cycles / samples);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(BenchGainStage)
+{
+    Measure("steady", 70, false, 0);
+    Measure("ramp", 70, true, 1000); // every chunk is within a ramp
+    Measure("unity", 100, false, 0);
+    Measure("silence", 0, false, 0);
+    CHECK(sSamples[0] == 0); // silence, nothing optimized away
+}
@@ -0,0 +1,104 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <stdlib.h>
+
+#include "GainStage.h"
+#include "TestRunner.h"
+
+#define RATE 48000
+#define FRAMES 480 // 10 ms
+
+///////////////////////////////////////////////////////////////////////////////
+static void Fill(int16_t* pSamples, size_t count, int16_t value)
+{
+    for (size_t i = 0; i < count; i++) {
+        pSamples[i] = value;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(GainStageVolumeCurve)
+{
+    CHECK_EQ(GainStage::VolumeToGain(0), 0);
+    CHECK_EQ(GainStage::VolumeToGain(100), LYRAT_GAIN_UNITY);
+    CHECK_EQ(GainStage::VolumeToGain(50), 1843); // -25 dB
+    for (int volume = 1; volume < 100; volume++) {
+        CHECK(GainStage::VolumeToGain(volume) > GainStage::VolumeToGain(volume - 1));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(GainStageRamp)
+{
+    GainStage gain;
+    int16_t samples[FRAMES * 2];
+    gain.SetFormat(RATE, 2, 16);
+
+    // without a ramp the gain is applied at once
+    gain.SetVolume(100, 0);
+    Fill(samples, FRAMES * 2, 10000);
+    gain.Process(samples, FRAMES);
+    CHECK_EQ(samples[0], 10000);
+    CHECK(!gain.IsSilent());
+
+    // a 10 ms fade reaches silence with the last frame of the block, monotonic
+    gain.Mute(true, 10);
+    Fill(samples, FRAMES * 2, 10000);
+    gain.Process(samples, FRAMES);
+    for (int i = 1; i < FRAMES; i++) {
+        CHECK(samples[2 * i] <= samples[2 * i - 2]);
+        CHECK_EQ(samples[2 * i], samples[2 * i + 1]);
+    }
+    CHECK(samples[0] > 9900);
+    CHECK_EQ(samples[2 * FRAMES - 1], 0);
+    CHECK(gain.IsSilent());
+
+    Fill(samples, FRAMES * 2, 10000);
+    gain.Process(samples, FRAMES);
+    CHECK_EQ(samples[0], 0);
+    CHECK_EQ(samples[2 * FRAMES - 1], 0);
+
+    // the volume is kept while muted and comes back with the fade in
+    CHECK_EQ(gain.GetVolume(), 100);
+    gain.Mute(false, 5);
+    Fill(samples, FRAMES * 2, 10000);
+    gain.Process(samples, FRAMES);
+    CHECK(samples[0] < 100);
+    CHECK_EQ(samples[2 * (FRAMES / 2) - 1], 10000);
+    CHECK_EQ(samples[2 * FRAMES - 1], 10000);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(GainStageSteadyGain)
+{
+    GainStage gain;
+    int16_t samples[FRAMES];
+    gain.SetFormat(RATE, 1, 16);
+    gain.SetVolume(50, 0);
+
+    for (int i = 0; i < FRAMES; i++) {
+        samples[i] = (int16_t)(i * 131 - 32768);
+    }
+    gain.Process(samples, FRAMES);
+    int32_t q15 = GainStage::VolumeToGain(50);
+    for (int i = 0; i < FRAMES; i++) {
+        CHECK_EQ(samples[i], (int16_t)(((int16_t)(i * 131 - 32768) * q15) >> 15));
+    }
+
+    // other sample formats pass unchanged
+    gain.SetFormat(RATE, 2, 24);
+    Fill(samples, FRAMES, 1234);
+    gain.Process(samples, FRAMES / 2);
+    CHECK_EQ(samples[0], 1234);
+    CHECK_EQ(samples[FRAMES - 1], 1234);
+}
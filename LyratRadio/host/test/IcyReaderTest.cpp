@@ -0,0 +1,206 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "IcyReader.h"
+#include "TestRunner.h"
+
+#define META_INT 1000
+
+//////////////////////////////////////////////////////////////////////
+// socket stand-in: returns at most mMaxRead bytes per call, every mTimeoutEvery-th call
+// times out (0) without losing data
+typedef struct {
+    std::string mData;
+    size_t mPos;
+    int mMaxRead;
+    int mTimeoutEvery;
+    int mCalls;
+} Stream_t;
+
+///////////////////////////////////////////////////////////////////////////////
+static int StreamRead(void* pContext, char* pBuffer, int length)
+{
+    Stream_t* pStream = (Stream_t*)pContext;
+    pStream->mCalls++;
+    if (pStream->mTimeoutEvery > 0 && pStream->mCalls % pStream->mTimeoutEvery == 0) {
+        return 0;
+    }
+    if (pStream->mPos == pStream->mData.size()) {
+        return -1;
+    }
+    int len = std::min(std::min(length, pStream->mMaxRead), (int)(pStream->mData.size() - pStream->mPos));
+    memcpy(pBuffer, pStream->mData.data() + pStream->mPos, len);
+    pStream->mPos += len;
+    return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// audio bytes that are never 0, so an interval boundary in plain audio is never an empty block
+static std::string Audio(size_t length, int seed)
+{
+    std::string audio(length, 0);
+    for (size_t i = 0; i < length; i++) {
+        audio[i] = (char)(1 + (i * 7 + seed) % 251);
+    }
+    return audio;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static std::string MetaBlock(const char* pMeta)
+{
+    size_t blocks = (strlen(pMeta) + 15) / 16;
+    std::string block(1, (char)blocks);
+    block += pMeta;
+    block.resize(1 + blocks * 16, 0);
+    return block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reads until the end with the given read size, titles are collected as they change
+static std::string ReadAll(IcyReader& icy, Stream_t& stream, int bufferSize, std::vector<std::string>* pTitles)
+{
+    std::string audio;
+    std::vector<char> buffer(bufferSize);
+    while (true) {
+        int len = icy.Read(buffer.data(), bufferSize, StreamRead, &stream);
+        if (len < 0) {
+            break;
+        }
+        audio.append(buffer.data(), len);
+        if (pTitles != NULL && icy.IsTitleChanged()) {
+            pTitles->push_back(icy.TakeTitle());
+        }
+    }
+    return audio;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// every split of the socket reads and every read size gives the same audio and titles
+TEST(IcyReaderSplitReads)
+{
+    std::string expected;
+    Stream_t stream = { "", 0, 0, 0, 0 };
+    const char* titles[] = { "StreamTitle='One';", "", "StreamTitle='One';", "StreamTitle='Two ''x'' - y';StreamUrl='';" };
+    for (int i = 0; i < 4; i++) {
+        std::string audio = Audio(META_INT, i);
+        expected += audio;
+        stream.mData += audio;
+        stream.mData += MetaBlock(titles[i]);
+    }
+    std::string tail = Audio(META_INT / 2, 9);
+    expected += tail;
+    stream.mData += tail;
+
+    static const int maxReads[] = { 1, 2, 5, 16, 17, 999, 1000, 1001, 4096 };
+    static const int bufferSizes[] = { 1, 7, 512, 1000, 2048 };
+    for (int maxRead : maxReads) {
+        for (int bufferSize : bufferSizes) {
+            for (int timeoutEvery = 0; timeoutEvery <= 3; timeoutEvery += 3) {
+                IcyReader icy;
+                icy.SetMetaInt(META_INT);
+                stream.mPos = 0;
+                stream.mMaxRead = maxRead;
+                stream.mTimeoutEvery = timeoutEvery;
+                stream.mCalls = 0;
+
+                std::vector<std::string> changes;
+                CHECK(ReadAll(icy, stream, bufferSize, &changes) == expected);
+                CHECK(icy.IsConfirmed());
+                CHECK_EQ(icy.GetMetaInt(), META_INT);
+                CHECK_EQ(changes.size(), 2u);
+                if (changes.size() == 2) {
+                    CHECK(changes[0] == "One");
+                    CHECK(changes[1] == "Two ''x'' - y");
+                }
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the server ignored the request: nothing is stripped, no byte is lost
+TEST(IcyReaderUnconfirmedInterval)
+{
+    Stream_t stream = { Audio(5 * META_INT, 3), 0, 0, 0, 0 };
+
+    static const int maxReads[] = { 1, 3, 1000, 4096 };
+    for (int maxRead : maxReads) {
+        for (int bufferSize = 1; bufferSize <= 9; bufferSize += 4) {
+            IcyReader icy;
+            icy.SetMetaInt(META_INT);
+            stream.mPos = 0;
+            stream.mMaxRead = maxRead;
+            stream.mTimeoutEvery = 0;
+
+            CHECK(ReadAll(icy, stream, bufferSize, NULL) == stream.mData);
+            CHECK_EQ(icy.GetMetaInt(), 0);
+            CHECK(!icy.IsConfirmed());
+        }
+    }
+
+    // off until the next station, a reconnect does not ask for metadata again
+    IcyReader icy;
+    icy.SetMetaInt(META_INT);
+    stream.mPos = 0;
+    stream.mMaxRead = 4096;
+    ReadAll(icy, stream, 4096, NULL);
+    icy.Restart();
+    CHECK_EQ(icy.GetMetaInt(), 0);
+    icy.SetMetaInt(META_INT);
+    CHECK_EQ(icy.GetMetaInt(), META_INT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// empty blocks can not be checked; the first block with content confirms the interval
+TEST(IcyReaderEmptyBlocks)
+{
+    std::string expected;
+    Stream_t stream = { "", 0, 4096, 0, 0 };
+    for (int i = 0; i < 3; i++) {
+        std::string audio = Audio(META_INT, i);
+        expected += audio;
+        stream.mData += audio;
+        stream.mData += MetaBlock(i < 2 ? "" : "StreamTitle='Late';");
+    }
+    expected += Audio(10, 5);
+    stream.mData += Audio(10, 5);
+
+    IcyReader icy;
+    icy.SetMetaInt(META_INT);
+    std::vector<std::string> changes;
+    CHECK(ReadAll(icy, stream, 4096, &changes) == expected);
+    CHECK(icy.IsConfirmed());
+    CHECK_EQ(changes.size(), 1u);
+
+    // each request is checked again
+    icy.Restart();
+    CHECK(!icy.IsConfirmed());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(IcyReaderParseTitle)
+{
+    char title[LYRAT_ICY_TITLE_SIZE];
+    const char meta[] = "StreamTitle='It''s me';StreamUrl='http://x';";
+
+    CHECK(IcyReader::ParseTitle(meta, sizeof(meta), title, sizeof(title)));
+    CHECK(strcmp(title, "It''s me") == 0);
+    CHECK(IcyReader::ParseTitle("StreamTitle='No end'", 20, title, sizeof(title)));
+    CHECK(strcmp(title, "No end") == 0);
+    CHECK(IcyReader::ParseTitle(meta, sizeof(meta), title, 4));
+    CHECK(strcmp(title, "It'") == 0);
+    CHECK(!IcyReader::ParseTitle("StreamUrl='x';", 14, title, sizeof(title)));
+}
@@ -0,0 +1,122 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include "JitterBuffer.h"
+#include "TestRunner.h"
+
+#define CAPACITY (32 * 1024)
+#define SECOND 1000000LL
+
+///////////////////////////////////////////////////////////////////////////////
+static StationUuid_t MakeUuid(const char* pId)
+{
+    StationUuid_t uuid;
+    uuid.Parse(pId);
+    return uuid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JitterBufferPreroll)
+{
+    JitterBuffer jitter;
+    StationUuid_t uuid = MakeUuid("9605ae29-0601-11e8-ae97-52543be04c81");
+
+    CHECK_EQ(jitter.Start(uuid, CAPACITY, 0), JitterBuffer::Pause);
+    CHECK_EQ(jitter.Sample(LYRAT_JITTER_START_WATERMARK - 1, SECOND), JitterBuffer::None);
+    CHECK_EQ(jitter.Sample(LYRAT_JITTER_START_WATERMARK, SECOND), JitterBuffer::Resume);
+    CHECK(jitter.IsPlaying());
+
+    // a slow stream starts anyway after the maximum pre-roll
+    CHECK_EQ(jitter.Start(uuid, CAPACITY, 0), JitterBuffer::Pause);
+    CHECK_EQ(jitter.Sample(0, 2 * LYRAT_JITTER_MAX_PREROLL_US), JitterBuffer::None);
+    CHECK_EQ(jitter.Sample(100, 2 * LYRAT_JITTER_MAX_PREROLL_US), JitterBuffer::Resume);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JitterBufferLearns)
+{
+    JitterBuffer jitter;
+    StationUuid_t uuid = MakeUuid("9605ae29-0601-11e8-ae97-52543be04c81");
+    StationUuid_t other = MakeUuid("9605ae29-0601-11e8-ae97-52543be04c82");
+
+    jitter.Start(uuid, CAPACITY, 0);
+    jitter.Sample(CAPACITY, 0);
+
+    // underrun: rebuffer with a grown watermark
+    CHECK_EQ(jitter.Sample(0, SECOND), JitterBuffer::Pause);
+    uint32_t grown = LYRAT_JITTER_START_WATERMARK + LYRAT_JITTER_START_WATERMARK * LYRAT_JITTER_GROW_PERCENT / 100;
+    CHECK_EQ(jitter.GetStation()->mWatermark, grown);
+    CHECK_EQ(jitter.GetStation()->mUnderruns, 1u);
+    CHECK_EQ(jitter.Sample(grown, 3 * SECOND), JitterBuffer::Resume);
+    CHECK_EQ(jitter.GetStation()->mLastStallMs, 2000u);
+
+    // the watermark never exceeds 3/4 of the ring buffer
+    for (int i = 0; i < 20; i++) {
+        jitter.Sample(0, 4 * SECOND);
+        jitter.Sample(CAPACITY, 4 * SECOND);
+    }
+    CHECK_EQ(jitter.GetStation()->mWatermark, (uint32_t)(CAPACITY * 3 / 4));
+
+    // another station starts with the default, the first one keeps its watermark
+    jitter.Start(other, CAPACITY, 0);
+    CHECK_EQ(jitter.GetStation()->mWatermark, (uint32_t)LYRAT_JITTER_START_WATERMARK);
+    jitter.Start(uuid, CAPACITY, 0);
+    CHECK_EQ(jitter.GetStation()->mWatermark, (uint32_t)(CAPACITY * 3 / 4));
+
+    // stable periods shrink it again
+    jitter.Sample(CAPACITY, 0);
+    int64_t now = 0;
+    for (int i = 0; i < 100; i++) {
+        now += LYRAT_JITTER_STABLE_US + 1;
+        jitter.Sample(CAPACITY, now);
+    }
+    CHECK(jitter.GetStation()->mWatermark >= LYRAT_JITTER_MIN_WATERMARK);
+    CHECK(jitter.GetStation()->mWatermark < LYRAT_JITTER_MIN_WATERMARK + LYRAT_JITTER_SHRINK_STEP);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// playback starts at the watermark, a stall after settled playback refills a deeper cushion
+TEST(JitterBufferDeepens)
+{
+    JitterBuffer jitter;
+    StationUuid_t uuid = MakeUuid("9605ae29-0601-11e8-ae97-52543be04c81");
+
+    jitter.Start(uuid, CAPACITY, 0);
+    CHECK_EQ(jitter.Sample(LYRAT_JITTER_START_WATERMARK, 0), JitterBuffer::Resume);
+    CHECK_EQ(jitter.GetCushion(), (uint32_t)LYRAT_JITTER_START_WATERMARK);
+
+    int64_t now = 0;
+    for (int i = 0; i < 2; i++) {
+        now += LYRAT_JITTER_DEEPEN_US + 1;
+        jitter.Sample(CAPACITY / 2, now);
+    }
+    uint32_t cushion = LYRAT_JITTER_START_WATERMARK + 2 * LYRAT_JITTER_DEEPEN_STEP;
+    CHECK_EQ(jitter.GetCushion(), cushion);
+    CHECK_EQ(jitter.GetStation()->mWatermark, (uint32_t)LYRAT_JITTER_START_WATERMARK); // start stays fast
+
+    // the rebuffer waits for the cushion, not only for the grown watermark
+    CHECK_EQ(jitter.Sample(0, now), JitterBuffer::Pause);
+    CHECK(jitter.GetStation()->mWatermark < cushion);
+    CHECK_EQ(jitter.Sample(jitter.GetStation()->mWatermark, now), JitterBuffer::None);
+    CHECK_EQ(jitter.Sample(cushion, now), JitterBuffer::Resume);
+
+    // never deeper than 3/4 of the ring buffer
+    for (int i = 0; i < 20; i++) {
+        now += LYRAT_JITTER_DEEPEN_US + 1;
+        jitter.Sample(CAPACITY / 2, now);
+    }
+    CHECK_EQ(jitter.GetCushion(), (uint32_t)(CAPACITY * 3 / 4));
+
+    // a new start begins at the watermark again
+    jitter.Start(uuid, CAPACITY, now);
+    CHECK_EQ(jitter.GetCushion(), jitter.GetStation()->mWatermark);
+}
@@ -0,0 +1,142 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// Configuration request with a full station list, parsed and read field by
+// field like DataWebRadio does. With LYRAT_CJSON_DIR set, the same work is
+// done with cJSON, the parser JsonReader replaced.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "data_json_interface.h"
+#include "JsonReader.h"
+#include "TestRunner.h"
+
+#ifdef LYRAT_BENCH_CJSON
+#include "cJSON.h"
+#endif
+
+#define BENCH_ROUNDS 2000
+
+static JsonReader sJson;
+
+///////////////////////////////////////////////////////////////////////////////
+static std::string ConfigurationRequest()
+{
+    std::string text = "{\"" LYRAT_NET_WEBRADIO "\":{\"" LYRAT_NET_CONFIGURATION "\":{\"" LYRAT_NET_STATIONLIST "\":[";
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        char station[256];
+        snprintf(station, sizeof(station),
+            "%s{\"" LYRAT_NET_ST_ID "\":\"%08x-0601-11e8-ae97-52543be04c81\",\"" LYRAT_NET_ST_URL
+            "\":\"http://stream%d.example.com:8000/live\\/radio.mp3\",\"" LYRAT_NET_ST_DECODER "\":\"MP3\"}",
+            i ? "," : "", i, i);
+        text += station;
+    }
+    text += "],\"" LYRAT_NET_VOLUME "\":50,\"" LYRAT_NET_ACTSTATION "\":3,\"" LYRAT_NET_RADIO "\":\"Kitchen\"}}}";
+    return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// returns a checksum over the read values
+static size_t ReadWithJsonReader(std::string& buffer)
+{
+    size_t sum = 0;
+    if (!sJson.Parse(&buffer[0], buffer.size())) {
+        return 0;
+    }
+    int configuration = sJson.Find(sJson.Find(0, LYRAT_NET_WEBRADIO), LYRAT_NET_CONFIGURATION);
+    int list = sJson.Find(configuration, LYRAT_NET_STATIONLIST);
+    for (int i = 0; i < sJson.ArraySize(list); i++) {
+        int station = sJson.ArrayItem(list, i);
+        sum += strlen(sJson.GetString(sJson.Find(station, LYRAT_NET_ST_ID)));
+        sum += strlen(sJson.GetString(sJson.Find(station, LYRAT_NET_ST_URL)));
+        sum += strlen(sJson.GetString(sJson.Find(station, LYRAT_NET_ST_DECODER)));
+    }
+    sum += sJson.GetInt(sJson.Find(configuration, LYRAT_NET_VOLUME), 0);
+    sum += sJson.GetInt(sJson.Find(configuration, LYRAT_NET_ACTSTATION), 0);
+    return sum;
+}
+
+#ifdef LYRAT_BENCH_CJSON
+static int sAllocs = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+static void* CountingMalloc(size_t size)
+{
+    sAllocs++;
+    return malloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static size_t ReadWithCJson(const std::string& buffer)
+{
+    size_t sum = 0;
+    cJSON* pRoot = cJSON_Parse(buffer.c_str());
+    cJSON* pConfiguration = cJSON_GetObjectItem(cJSON_GetObjectItem(pRoot, LYRAT_NET_WEBRADIO), LYRAT_NET_CONFIGURATION);
+    cJSON* pList = cJSON_GetObjectItem(pConfiguration, LYRAT_NET_STATIONLIST);
+    for (int i = 0; i < cJSON_GetArraySize(pList); i++) {
+        cJSON* pStation = cJSON_GetArrayItem(pList, i);
+        sum += strlen(cJSON_GetObjectItem(pStation, LYRAT_NET_ST_ID)->valuestring);
+        sum += strlen(cJSON_GetObjectItem(pStation, LYRAT_NET_ST_URL)->valuestring);
+        sum += strlen(cJSON_GetObjectItem(pStation, LYRAT_NET_ST_DECODER)->valuestring);
+    }
+    sum += cJSON_GetObjectItem(pConfiguration, LYRAT_NET_VOLUME)->valueint;
+    sum += cJSON_GetObjectItem(pConfiguration, LYRAT_NET_ACTSTATION)->valueint;
+    cJSON_Delete(pRoot);
+    return sum;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(BenchJsonReader)
+{
+    const std::string request = ConfigurationRequest();
+    std::string buffer;
+
+    // the buffer is unescaped in place, each round parses a fresh copy like a new packet
+    buffer = request;
+    size_t expected = ReadWithJsonReader(buffer);
+    CHECK(expected > 0);
+
+    int64_t copyTime = TestRunner::Now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        buffer = request;
+    }
+    copyTime = TestRunner::Now() - copyTime;
+
+    int64_t time = TestRunner::Now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        buffer = request;
+        CHECK_EQ(ReadWithJsonReader(buffer), expected);
+    }
+    time = TestRunner::Now() - time - copyTime;
+    printf("  JsonReader: %zu bytes, %.2f us per request, no heap\n", request.size(), (double)time / BENCH_ROUNDS);
+
+#ifdef LYRAT_BENCH_CJSON
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+    CHECK_EQ(ReadWithCJson(request), expected);
+
+    sAllocs = 0;
+    time = TestRunner::Now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        ReadWithCJson(request);
+    }
+    time = TestRunner::Now() - time;
+    printf("  cJSON:      %zu bytes, %.2f us per request, %d allocations\n", request.size(), (double)time / BENCH_ROUNDS,
+        sAllocs / BENCH_ROUNDS);
+#else
+    printf("  cJSON:      not built, configure with -DLYRAT_CJSON_DIR=<dir of cJSON.c>\n");
+#endif
+}
@@ -0,0 +1,151 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "JsonReader.h"
+#include "TestRunner.h"
+
+static JsonReader sJson; // the token array is too large for a test stack frame
+
+///////////////////////////////////////////////////////////////////////////////
+// parses a copy, the reader unescapes in place
+static bool Parse(std::string& buffer, const char* pText)
+{
+    buffer = pText;
+    return sJson.Parse(&buffer[0], buffer.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonReaderLookup)
+{
+    std::string buffer;
+    CHECK(Parse(buffer, "{\"webradio\":{\"volume\":{\"volume\":42},\"list\":[1,{\"a\":[]},\"x\"],\"on\":true}}"));
+
+    int webradio = sJson.Find(0, "webradio");
+    CHECK(webradio > 0);
+    CHECK_EQ(sJson.GetInt(sJson.Find(sJson.Find(webradio, "volume"), "volume"), -1), 42);
+    CHECK_EQ(sJson.GetInt(sJson.Find(webradio, "on"), -1), 1);
+    CHECK(!sJson.Has(webradio, "missing"));
+    CHECK(!sJson.Has(webradio, "volum"));
+
+    int list = sJson.Find(webradio, "list");
+    CHECK_EQ(sJson.ArraySize(list), 3);
+    CHECK_EQ(sJson.GetInt(sJson.ArrayItem(list, 0), -1), 1);
+    CHECK_EQ(sJson.ArraySize(sJson.Find(sJson.ArrayItem(list, 1), "a")), 0);
+    CHECK(strcmp(sJson.GetString(sJson.ArrayItem(list, 2)), "x") == 0);
+    CHECK_EQ(sJson.ArrayItem(list, 3), -1);
+
+    // -1 and wrong token types are accepted everywhere
+    CHECK_EQ(sJson.Find(-1, "x"), -1);
+    CHECK_EQ(sJson.Find(list, "x"), -1);
+    CHECK_EQ(sJson.ArraySize(webradio), 0);
+    CHECK(strcmp(sJson.GetString(-1), "") == 0);
+    CHECK(strcmp(sJson.GetString(list), "") == 0);
+    CHECK_EQ(sJson.GetInt(-1, 7), 7);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonReaderTruncated)
+{
+    const char* pText = "{\"webradio\":{\"configuration\":{\"station_list\":[{\"st_id\":\"a\\\"b\",\"st_url\":\"u\"}],\"act\":1}}}";
+    size_t length = strlen(pText);
+    std::string buffer;
+
+    // every prefix is rejected and leaves no tokens behind
+    for (size_t i = 0; i < length; i++) {
+        buffer.assign(pText, i);
+        CHECK(!sJson.Parse(&buffer[0], buffer.size()));
+        CHECK(!sJson.IsParsed(&buffer[0]));
+    }
+    // the length limits the input even without a terminating 0
+    buffer = pText;
+    buffer += "}";
+    CHECK(sJson.Parse(&buffer[0], length));
+    CHECK(!sJson.Parse(&buffer[0], buffer.size()));
+
+    std::string bad;
+    CHECK(!Parse(bad, ""));
+    CHECK(!Parse(bad, "{\"a\":1]"));
+    CHECK(!Parse(bad, "[1}"));
+    CHECK(!Parse(bad, "{}{}"));
+    CHECK(!Parse(bad, "\"top level string\""));
+    CHECK(!Parse(bad, "42"));
+    CHECK(!Parse(bad, "{\"a\":\"open}"));
+    CHECK(!Parse(bad, "{\"a\":\"escaped end\\\"}"));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonReaderLimits)
+{
+    std::string text;
+    std::string buffer;
+
+    // nesting
+    for (int depth = LYRAT_JSON_MAX_DEPTH; depth <= LYRAT_JSON_MAX_DEPTH + 1; depth++) {
+        text = std::string(depth, '[') + std::string(depth, ']');
+        CHECK_EQ(Parse(buffer, text.c_str()), depth <= LYRAT_JSON_MAX_DEPTH);
+    }
+
+    // tokens: the root array and its items
+    for (int tokens = LYRAT_JSON_MAX_TOKENS; tokens <= LYRAT_JSON_MAX_TOKENS + 1; tokens++) {
+        text = "[";
+        for (int i = 1; i < tokens; i++) {
+            text += (i > 1) ? ",0" : "0";
+        }
+        text += "]";
+        CHECK_EQ(Parse(buffer, text.c_str()), tokens <= LYRAT_JSON_MAX_TOKENS);
+        if (tokens <= LYRAT_JSON_MAX_TOKENS) {
+            CHECK_EQ(sJson.ArraySize(0), tokens - 1);
+        }
+    }
+
+    // token offsets are 16 bit
+    text = "[\"" + std::string(0x10000, 'x') + "\"]";
+    CHECK(!Parse(buffer, text.c_str()));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonReaderEscapes)
+{
+    std::string buffer;
+    CHECK(Parse(buffer, "{\"a\\\"b\":\"q\\\"\\\\\\/\\b\\f\\n\\r\\t\",\"u\":\"\\u0041\\u00e4\\u20ac\"}"));
+
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "u")), "A\xc3\xa4\xe2\x82\xac") == 0);
+    CHECK(strcmp(sJson.GetString(2), "q\"\\/\b\f\n\r\t") == 0);
+    CHECK(strcmp(sJson.GetString(2), "q\"\\/\b\f\n\r\t") == 0); // decoded once
+    CHECK(sJson.Has(0, "u")); // keys compare after decoding, too
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonReaderSurrogates)
+{
+    std::string buffer;
+
+    // U+1F600 is one 4 byte utf-8 sequence, not two 3 byte halves
+    CHECK(Parse(buffer, "{\"s\":\"\\ud83d\\ude00\",\"upper\":\"\\uD834\\uDD1E!\"}"));
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "s")), "\xf0\x9f\x98\x80") == 0);
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "upper")), "\xf0\x9d\x84\x9e!") == 0);
+
+    // lone or reversed halves become U+FFFD
+    CHECK(Parse(buffer, "{\"h\":\"\\ud83dx\",\"l\":\"\\ude00\",\"r\":\"\\ude00\\ud83d\",\"e\":\"\\ud83d\"}"));
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "h")), "\xef\xbf\xbdx") == 0);
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "l")), "\xef\xbf\xbd") == 0);
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "r")), "\xef\xbf\xbd\xef\xbf\xbd") == 0);
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "e")), "\xef\xbf\xbd") == 0);
+
+    // a high surrogate followed by another escape keeps that escape
+    CHECK(Parse(buffer, "{\"n\":\"\\ud83d\\u0041\"}"));
+    CHECK(strcmp(sJson.GetString(sJson.Find(0, "n")), "\xef\xbf\xbd" "A") == 0);
+}
@@ -0,0 +1,125 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <string.h>
+
+#include "JsonReader.h"
+#include "JsonWriter.h"
+#include "TestRunner.h"
+
+#define GUARD_SIZE 16
+
+static JsonReader sJson;
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonWriterValues)
+{
+    char buffer[128];
+    JsonWriter json(buffer, sizeof(buffer));
+
+    json.BeginObject();
+    json.BeginObject("webradio");
+    json.AddString("name", "a\"b\\c\n\x01");
+    json.AddNumber("volume", -5);
+    json.BeginArray("list");
+    json.AddNumber(NULL, 1);
+    json.AddString(NULL, "x");
+    json.BeginObject();
+    json.EndObject();
+    json.EndArray();
+    json.EndObject();
+    json.EndObject();
+
+    CHECK(!json.Overflow());
+    CHECK(strcmp(buffer, "{\"webradio\":{\"name\":\"a\\\"b\\\\c\\n\\u0001\",\"volume\":-5,\"list\":[1,\"x\",{}]}}") == 0);
+    CHECK_EQ(json.Length(), strlen(buffer));
+
+    // more closers than openers
+    json.EndObject();
+    CHECK(json.Overflow());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the pattern of the list responses: an element that does not fit is rolled back,
+// the containers are closed anyway. Every buffer size gives valid JSON.
+TEST(JsonWriterRollbackEverySize)
+{
+    const char* pEmpty = "{\"webradio\":{\"list\":[{\"n\":[]}]}}";
+
+    for (size_t size = 1; size < 200; size++) {
+        char buffer[200 + GUARD_SIZE];
+        memset(buffer, '#', sizeof(buffer));
+        JsonWriter json(buffer, size);
+
+        json.BeginObject();
+        json.BeginObject("webradio");
+        json.BeginArray("list");
+        if (json.Overflow()) {
+            CHECK(size <= strlen("{\"webradio\":{\"list\":[]}}"));
+            continue;
+        }
+        JsonWriter::Mark_t outer = json.GetMark();
+        json.BeginObject();
+        json.BeginArray("n");
+        int items = 0;
+        for (int i = 0; i < 20 && !json.Overflow(); i++) {
+            JsonWriter::Mark_t mark = json.GetMark();
+            json.BeginObject();
+            json.AddNumber("i", i);
+            json.EndObject();
+            if (json.Overflow()) {
+                json.Rollback(mark);
+                break;
+            }
+            items++;
+        }
+        json.EndArray();
+        json.EndObject();
+        if (json.Overflow()) {
+            json.Rollback(outer);
+        }
+        json.EndArray();
+        json.EndObject();
+        json.EndObject();
+
+        CHECK(buffer[size] == '#'); // nothing behind the buffer
+        CHECK(!json.Overflow());
+        CHECK(buffer[json.Length()] == 0);
+        CHECK(sJson.Parse(buffer, json.Length()));
+        if (size > strlen(pEmpty)) {
+            int list = sJson.Find(sJson.Find(0, "webradio"), "list");
+            CHECK_EQ(sJson.ArraySize(sJson.Find(sJson.ArrayItem(list, 0), "n")), items);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(JsonWriterDepthLimit)
+{
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+
+    for (int i = 0; i < LYRAT_JSON_WRITER_MAX_DEPTH - 1; i++) {
+        json.BeginArray();
+    }
+    CHECK(!json.Overflow());
+    JsonWriter::Mark_t mark = json.GetMark();
+    json.BeginArray();
+    CHECK(json.Overflow());
+
+    json.Rollback(mark);
+    for (int i = 0; i < LYRAT_JSON_WRITER_MAX_DEPTH - 1; i++) {
+        json.EndArray();
+    }
+    CHECK(!json.Overflow());
+    CHECK_EQ(json.Length(), 2u * (LYRAT_JSON_WRITER_MAX_DEPTH - 1));
+}
@@ -0,0 +1,232 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <ctype.h>
+#include <stdio.h>
+
+#include "NVSCodec.h"
+#include "TestRunner.h"
+
+///////////////////////////////////////////////////////////////////////////////
+static StationUuid_t MakeUuid(int i)
+{
+    char id[LYRAT_STATION_ID_SIZE];
+    snprintf(id, sizeof(id), "%08x-0601-11e8-ae97-52543be04c81", i);
+    StationUuid_t uuid;
+    uuid.Parse(id);
+    return uuid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(StationUuidParseFormat)
+{
+    const char* pId = "9605ae29-0601-11e8-ae97-52543be04c81";
+    StationUuid_t uuid;
+    CHECK(uuid.Parse(pId));
+
+    char text[37];
+    uuid.Format(text);
+    CHECK(strcmp(text, pId) == 0);
+
+    CHECK(uuid.Parse("9605AE29-0601-11E8-AE97-52543BE04C81"));
+    uuid.Format(text);
+    CHECK(strcmp(text, pId) == 0);
+
+    CHECK(!uuid.Parse("9605ae29-0601-11e8-ae97-52543be04c8"));
+    CHECK(!uuid.Parse("9605ae29x0601-11e8-ae97-52543be04c81"));
+    CHECK(!uuid.Parse("my station"));
+    CHECK(!uuid.Parse(""));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(StationsRoundTrip)
+{
+    Station_t actTune("act", "http://act.example.com/stream", "mp3");
+    StationList stations;
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        char id[LYRAT_STATION_ID_SIZE];
+        char url[64];
+        snprintf(id, sizeof(id), "station-%d", i);
+        snprintf(url, sizeof(url), "http://example.com/%d", i);
+        CHECK(stations.push_back(Station_t(id, url, (i & 1) ? "aac" : "mp3")));
+    }
+
+    uint8_t buffer[4000];
+    int count = 0;
+    size_t length = SerializeStations(buffer, sizeof(buffer), actTune, stations, count);
+    CHECK(length > LYRAT_NVS_STATIONS_HEADER);
+    CHECK_EQ(count, LYRAT_MAX_STATIONS);
+
+    Station_t parsedTune;
+    StationList parsed;
+    CHECK(ParseStations(buffer, length, parsedTune, parsed));
+    CHECK(parsedTune == actTune);
+    CHECK_EQ(parsed.size(), stations.size());
+    for (int i = 0; i < (int)stations.size(); i++) {
+        CHECK(parsed[i] == stations[i]);
+    }
+
+    // a corrupted payload is rejected by the crc
+    buffer[length - 1] ^= 0x01;
+    CHECK(!ParseStations(buffer, length, parsedTune, parsed));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(StationsTailDropped)
+{
+    Station_t actTune("act", "http://act.example.com/stream", "mp3");
+    StationList stations;
+    for (int i = 0; i < 8; i++) {
+        stations.push_back(Station_t("id", "http://example.com/stream", "mp3"));
+    }
+
+    uint8_t buffer[128];
+    int count = 0;
+    size_t length = SerializeStations(buffer, sizeof(buffer), actTune, stations, count);
+    CHECK(length > 0 && length <= sizeof(buffer));
+    CHECK(count < 8);
+
+    Station_t parsedTune;
+    StationList parsed;
+    CHECK(ParseStations(buffer, length, parsedTune, parsed));
+    CHECK_EQ((int)parsed.size(), count);
+
+    // not even the act tune fits
+    CHECK_EQ(SerializeStations(buffer, 16, actTune, stations, count), 0u);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the size a configuration request is checked against is the size of the blob;
+// the settings hold more than the blob: 32 presets with long urls do not fit
+TEST(StationBlobSizeLimit)
+{
+    std::string url(LYRAT_STATION_URL_SIZE - 1, 'u');
+    Station_t actTune("act", "http://act.example.com/stream", "mp3");
+    StationList stations;
+    size_t size = LYRAT_NVS_STATIONS_HEADER + StationBlobSize(actTune);
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        stations.push_back(Station_t("9605ae29-0601-11e8-ae97-52543be04c81", url.c_str(), "mp3"));
+        size += StationBlobSize(stations[i]);
+    }
+    CHECK(size > 4000);
+
+    static uint8_t buffer[LYRAT_MAX_STATIONS * 320];
+    int count = 0;
+    CHECK_EQ(SerializeStations(buffer, sizeof(buffer), actTune, stations, count), size);
+    CHECK_EQ(count, LYRAT_MAX_STATIONS);
+    CHECK(SerializeStations(buffer, 4000, actTune, stations, count) <= 4000);
+    CHECK(count < LYRAT_MAX_STATIONS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(CheckListRingAddFind)
+{
+    CheckListRing ring;
+    StationUuid_t uuid = MakeUuid(1);
+
+    CHECK(ring.Add(uuid, Invalid) >= 0);
+    CHECK(ring.Find(uuid) >= 0);
+    CHECK(ring.Add(uuid, Invalid) < 0); // unchanged
+    CHECK(ring.Add(uuid, Valid) >= 0);  // upgraded
+    CHECK(ring.Add(uuid, Invalid) < 0); // no downgrade
+    CHECK_EQ(ring.GetSlot(ring.Find(uuid)).mResult, (uint8_t)Valid);
+
+    // the oldest entries are overwritten, the index follows
+    for (int i = 2; i < LYRAT_NVS_CHECK_CAPACITY + 2; i++) {
+        ring.Add(MakeUuid(i), Valid);
+    }
+    CHECK_EQ(ring.Size(), LYRAT_NVS_CHECK_CAPACITY);
+    CHECK(ring.Find(uuid) < 0);
+    CHECK(ring.Find(MakeUuid(2)) >= 0);
+    CHECK(ring.Get(0).mUuid == MakeUuid(LYRAT_NVS_CHECK_CAPACITY + 1));
+
+    // persistence restores the index from the header
+    CheckListRing copy;
+    for (int chunk = 0; chunk < LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK; chunk++) {
+        memcpy(copy.Chunk(chunk), ring.Chunk(chunk), LYRAT_NVS_CHECK_CHUNK * sizeof(CheckRecord_t));
+    }
+    copy.SetHeader(ring.GetHeader());
+    CHECK_EQ(copy.Size(), ring.Size());
+    for (int i = 2; i < LYRAT_NVS_CHECK_CAPACITY + 2; i++) {
+        CHECK(copy.Find(MakeUuid(i)) >= 0);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(StationStatsTableUpdate)
+{
+    StationStatsTable table;
+    table.Update(MakeUuid(1), StatsPlay, 0);
+    table.Update(MakeUuid(2), StatsPlay, 0);
+    table.Update(MakeUuid(1), StatsUnderrun, 0);
+
+    CHECK_EQ(table.Size(), 2);
+    CHECK(table.Get(0).mUuid == MakeUuid(1)); // most recently used first
+    CHECK_EQ(table.Get(0).mUnderruns, 1);
+    CHECK(table.Get(0).Score() < table.Get(1).Score());
+
+    uint8_t buffer[LYRAT_NVS_STATS_HEADER + LYRAT_NVS_STATS_CAPACITY * sizeof(StationStats_t)];
+    size_t length = table.Serialize(buffer, sizeof(buffer));
+    CHECK(length > 0);
+
+    StationStatsTable parsed;
+    CHECK(parsed.Parse(buffer, length));
+    CHECK_EQ(parsed.Size(), 2);
+    CHECK(memcmp(&parsed.Get(0), &table.Get(0), sizeof(StationStats_t)) == 0);
+
+    for (int i = 0; i < LYRAT_NVS_STATS_CAPACITY + 4; i++) {
+        table.Update(MakeUuid(100 + i), StatsPlay, 0);
+    }
+    CHECK_EQ(table.Size(), LYRAT_NVS_STATS_CAPACITY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(StationIndexFind)
+{
+    StationList stations;
+    StationIndex index;
+    char id[LYRAT_STATION_ID_SIZE];
+
+    index.Build(stations);
+    CHECK_EQ(index.Find(MakeUuid(0)), -1);
+
+    // a full list: every preset is found, in upper or lower case, others are not
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        MakeUuid(i * 0x01010101).Format(id);
+        if (i & 1) {
+            for (char* p = id; *p; p++) {
+                *p = toupper(*p);
+            }
+        }
+        stations.push_back(Station_t(id, "http://example.com/stream", "mp3"));
+    }
+    index.Build(stations);
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        CHECK_EQ(index.Find(MakeUuid(i * 0x01010101)), i);
+    }
+    CHECK_EQ(index.Find(MakeUuid(LYRAT_MAX_STATIONS * 0x01010101)), -1);
+
+    // ids that are no uuid are not indexed, a duplicate is found at its first preset
+    stations[3].mId = "my station";
+    MakeUuid(0).Format(id);
+    stations[9].mId = id;
+    index.Build(stations);
+    CHECK_EQ(index.Find(MakeUuid(3 * 0x01010101)), -1);
+    CHECK_EQ(index.Find(MakeUuid(0)), 0);
+    CHECK_EQ(index.Find(MakeUuid(9 * 0x01010101)), -1);
+
+    // the presets behind a removed one move up
+    stations.erase(0);
+    index.Build(stations);
+    CHECK_EQ(index.Find(MakeUuid(0)), 8);
+    CHECK_EQ(index.Find(MakeUuid(31 * 0x01010101)), 30);
+}
@@ -0,0 +1,89 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// Settings I/O of NVSWebRadio on the in-memory NVS: the settings work of a
+// station switch, the write-back of a full station list and a start that
+// reads it. The figures are the CPU side only, FakeNvs does not model the
+// flash timing.
+
+#include <stdio.h>
+#include <memory>
+
+#include "NVSWebRadio.h"
+#include "FakeNvs.h"
+#include "TestRunner.h"
+
+const char* TAG = "bench"; // defined in WebRadio.cpp on the target
+
+#define BENCH_SWITCH_ROUNDS 20000
+#define BENCH_WRITE_ROUNDS 2000
+#define BENCH_START_ROUNDS 20 // each start registers a commit task in FakeRtos
+
+///////////////////////////////////////////////////////////////////////////////
+static void FillStations(NVSWebRadio& nvs)
+{
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        char id[LYRAT_STATION_ID_SIZE];
+        char url[64];
+        snprintf(id, sizeof(id), "%08x-0601-11e8-ae97-52543be04c81", i);
+        snprintf(url, sizeof(url), "http://stream%d.example.com:8000/live/radio.mp3", i);
+        nvs.SetStation(i, Station_t(id, url, "MP3"), LYRAT_MAX_STATIONS);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(BenchNVSWebRadio)
+{
+    FakeNvs::Erase();
+    std::unique_ptr<NVSWebRadio> nvs(new NVSWebRadio());
+    CHECK_EQ(nvs->Initialize(), ESP_OK);
+    FillStations(*nvs);
+    nvs->Flush();
+
+    // a switch as the audio loop and the control server do it, served from the cache
+    FakeNvs::ClearCounters();
+    int64_t time = TestRunner::Now();
+    for (int i = 0; i < BENCH_SWITCH_ROUNDS; i++) {
+        Station_t station;
+        nvs->SetActStation(i % LYRAT_MAX_STATIONS);
+        nvs->GetPlayStation(station);
+        nvs->AddStationStats(station.mId.c_str(), StatsPlay);
+        nvs->IncStationCheck(station, CheckListResult::Valid);
+    }
+    time = TestRunner::Now() - time;
+    FakeNvs::Counters_t counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mReads, 0);
+    CHECK_EQ(counters.mWrites, 0);
+    printf("  station switch: %.3f us per switch, no flash access\n", (double)time / BENCH_SWITCH_ROUNDS);
+
+    // write-back of everything a switch leaves dirty, with the full station list
+    time = TestRunner::Now();
+    for (int i = 0; i < BENCH_WRITE_ROUNDS; i++) {
+        nvs->SetActStation(i % LYRAT_MAX_STATIONS);
+        nvs->SetStation(i % LYRAT_MAX_STATIONS, Station_t("960c5b08-0601-11e8-ae97-52543be04c81", "http://example.com/stream", "AAC"), LYRAT_MAX_STATIONS);
+        nvs->Flush();
+    }
+    time = TestRunner::Now() - time;
+    printf("  write-back:     %.2f us per commit, station list blob %zu bytes\n", (double)time / BENCH_WRITE_ROUNDS,
+        FakeNvs::GetSize(LYRAT_NVS_STATIONS));
+
+    // start with the full list, all settings are read once
+    nvs.reset();
+    time = TestRunner::Now();
+    for (int i = 0; i < BENCH_START_ROUNDS; i++) {
+        nvs.reset(new NVSWebRadio());
+        CHECK_EQ(nvs->Initialize(), ESP_OK);
+    }
+    time = TestRunner::Now() - time;
+    CHECK_EQ(nvs->GetStationCount(), LYRAT_MAX_STATIONS);
+    printf("  start:          %.2f us per settings load\n", (double)time / BENCH_START_ROUNDS);
+}
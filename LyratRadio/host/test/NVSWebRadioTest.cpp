@@ -0,0 +1,256 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "NVSWebRadio.h"
+#include "FakeNvs.h"
+#include "FakeRtos.h"
+#include "TestRunner.h"
+
+const char* TAG = "host"; // defined in WebRadio.cpp on the target
+
+#define UUID_A "9605ae29-0601-11e8-ae97-52543be04c81"
+#define UUID_B "960c5b08-0601-11e8-ae97-52543be04c81"
+#define UUID_C "78012206-1aa1-11e9-a80b-52543be04c81"
+
+///////////////////////////////////////////////////////////////////////////////
+// first start on an empty flash, the defaults are written
+static std::unique_ptr<NVSWebRadio> StartRadio(bool bErase)
+{
+    if (bErase) {
+        FakeNvs::Erase();
+    }
+    std::unique_ptr<NVSWebRadio> nvs(new NVSWebRadio());
+    CHECK_EQ(nvs->Initialize(), ESP_OK);
+    FakeRtos::GetNotifications(nvs->GetCommitTask());
+    FakeNvs::ClearCounters();
+    return nvs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(NVSWebRadioDefaults)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+
+    CHECK_EQ(nvs->GetStationCount(), 2);
+    CHECK_EQ(nvs->GetActStation(), -1);
+    CHECK_EQ(nvs->GetVolume(), 50);
+    CHECK_EQ(nvs->GetStationCheck(UUID_A), CheckListResult::Valid);
+    CHECK(FakeNvs::Exists(LYRAT_NVS_STATIONS));
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_VOLUME), 50);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NVS_RESTART_NOROUTER), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a station switch is served from the cache: no flash read, one commit later
+TEST(NVSWebRadioSwitchWithoutFlashReads)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+
+    for (int i = 0; i < 10; i++) {
+        nvs->SetActStation(i & 1);
+        Station_t station;
+        CHECK_EQ(nvs->GetPlayStation(station), i & 1);
+        CHECK(nvs->GetStation(i & 1, station));
+        CHECK_EQ(nvs->FindStation(station.mId.c_str()), i & 1);
+        nvs->AddStationStats(station.mId.c_str(), StatsPlay);
+        nvs->IncStationCheck(station, CheckListResult::Valid);
+        {
+            NVSWebRadio::SettingsView settings(*nvs);
+            CHECK_EQ(settings->mActStation, i & 1);
+        }
+    }
+
+    FakeNvs::Counters_t counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mReads, 0);
+    CHECK_EQ(counters.mWrites, 0);
+    CHECK_EQ(counters.mCommits, 0);
+    CHECK(FakeRtos::GetNotifications(nvs->GetCommitTask()) > 0);
+
+    // the commit task writes all of it at once
+    nvs->Flush();
+    counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mReads, 0);
+    CHECK_EQ(counters.mCommits, 1);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_ACTSTATION), 1);
+    CHECK(nvs->GetCommitsSaved() > 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// only dirty values are written, and they are read back after a restart
+TEST(NVSWebRadioDirtyWriteBack)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+
+    nvs->Flush();
+    CHECK_EQ(FakeNvs::GetCounters().mCommits, 0); // nothing dirty
+
+    nvs->SetVolume(50); // unchanged
+    nvs->Flush();
+    CHECK_EQ(FakeNvs::GetCounters().mWrites, 0);
+
+    nvs->SetVolume(70);
+    nvs->SetVolume(75);
+    nvs->Flush();
+    FakeNvs::Counters_t counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mWrites, 1);
+    CHECK_EQ(counters.mCommits, 1);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_VOLUME), 75);
+
+    FakeNvs::ClearCounters();
+    nvs->SetName("Kitchen");
+    nvs->SetStation(2, Station_t(UUID_C, "http://example.com/c", "aac"), 3);
+    nvs->SetActStation(2);
+    Credentials_t credentials;
+    credentials.mSSID = "home";
+    credentials.mPassword = "secret";
+    nvs->SetCredentials(credentials);
+    nvs->Flush();
+    counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mCommits, 1);
+    CHECK_EQ(counters.mWrites, 5); // name, station blob, act station, ssid, password
+
+    // a new instance reads the values back
+    nvs.reset();
+    nvs = StartRadio(false);
+    CHECK_EQ(nvs->GetVolume(), 75);
+    CHECK_EQ(nvs->GetStationCount(), 3);
+    CHECK_EQ(nvs->FindStation(UUID_C), 2);
+    Station_t station;
+    CHECK_EQ(nvs->GetPlayStation(station), 2);
+    CHECK(station.mUrl == "http://example.com/c");
+    RadioName_t name;
+    nvs->GetName(name);
+    CHECK(name == "Kitchen");
+    Credentials_t stored;
+    nvs->GetCredentials(stored);
+    CHECK(stored.mSSID == "home");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(NVSWebRadioRemoveStation)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+    nvs->SetStation(2, Station_t(UUID_C, "http://example.com/c", "aac"), 3);
+    nvs->SetActStation(2);
+
+    CHECK_EQ(nvs->RemoveStation(UUID_B), 1);
+    CHECK_EQ(nvs->RemoveStation(UUID_B), -1);
+    CHECK_EQ(nvs->GetActStation(), 1); // moved up with its preset
+    CHECK_EQ(nvs->FindStation(UUID_C), 1);
+
+    // the act station keeps playing as act tune
+    CHECK_EQ(nvs->RemoveStation(UUID_C), 1);
+    Station_t station;
+    CHECK_EQ(nvs->GetPlayStation(station), -1);
+    CHECK(station.mId == UUID_C);
+    CHECK_EQ(nvs->GetStationCount(), 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// another task changes and reads the settings while the commit writes the flash
+static std::atomic<bool> sbOtherTaskDone(false);
+
+static void OtherTaskDuringWrite(void* pContext)
+{
+    NVSWebRadio* pNvs = (NVSWebRadio*)pContext;
+    FakeNvs::SetWriteHook(NULL, NULL);
+
+    sbOtherTaskDone = false;
+    std::thread task([pNvs]() {
+        pNvs->SetVolume(90);
+        NVSWebRadio::SettingsView settings(*pNvs);
+        sbOtherTaskDone = settings->mVolume == 90;
+    });
+    for (int i = 0; i < 1000 && !sbOtherTaskDone; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (sbOtherTaskDone) {
+        task.join();
+    }
+    else {
+        task.detach(); // blocked until the write-back returns
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the settings lock is not held across the flash writes
+TEST(NVSWebRadioWriteWithoutLock)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+
+    nvs->SetVolume(70);
+    FakeNvs::SetWriteHook(OtherTaskDuringWrite, nvs.get());
+    nvs->Flush();
+    CHECK(sbOtherTaskDone);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_VOLUME), 70); // the copy of the write-back
+    CHECK_EQ(nvs->GetVolume(), 90);
+
+    // the change is dirty again and goes with the next commit
+    FakeNvs::ClearCounters();
+    nvs->Flush();
+    CHECK_EQ(FakeNvs::GetCounters().mCommits, 1);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_VOLUME), 90);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a full partition does not abort: the oversized station list stays dirty and is retried,
+// the other values are committed anyway
+TEST(NVSWebRadioFullPartition)
+{
+    std::unique_ptr<NVSWebRadio> nvs = StartRadio(true);
+
+    Station_t station(UUID_C, "http://example.com/c", "aac");
+    nvs->SetVolume(60);
+    nvs->IncStationCheck(station, CheckListResult::Valid);
+    for (int i = 0; i < LYRAT_MAX_STATIONS; i++) {
+        nvs->SetStation(i, Station_t(UUID_C, "http://example.com/a/long/path/of/the/stream", "MP3"), LYRAT_MAX_STATIONS);
+    }
+    size_t stations = FakeNvs::GetSize(LYRAT_NVS_STATIONS);
+    FakeNvs::SetCapacity(FakeNvs::GetUsed() + 64);
+    nvs->Flush();
+
+    CHECK_EQ(FakeNvs::GetCounters().mCommits, 1);
+    CHECK_EQ(nvs->GetWriteErrors(), 1);
+    CHECK_EQ(FakeNvs::GetSize(LYRAT_NVS_STATIONS), stations); // the old list is kept
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_VOLUME), 60);
+
+    // the list keeps failing, later changes still go to flash
+    FakeNvs::ClearCounters();
+    nvs->SetActStation(3);
+    nvs->Flush();
+    CHECK_EQ(FakeNvs::GetCounters().mCommits, 1);
+    CHECK_EQ(nvs->GetWriteErrors(), 2);
+    CHECK_EQ(FakeNvs::GetI32(LYRAT_NET_ACTSTATION), 3);
+    CHECK_EQ(FakeNvs::GetSize(LYRAT_NVS_STATIONS), stations);
+
+    // the space is back, only the station list is left to write
+    FakeNvs::SetCapacity(0);
+    FakeNvs::ClearCounters();
+    nvs->Flush();
+    FakeNvs::Counters_t counters = FakeNvs::GetCounters();
+    CHECK_EQ(counters.mWrites, 1);
+    CHECK_EQ(counters.mCommits, 1);
+    CHECK_EQ(nvs->GetWriteErrors(), 2);
+    CHECK(FakeNvs::GetSize(LYRAT_NVS_STATIONS) > stations);
+
+    nvs.reset();
+    nvs = StartRadio(false);
+    CHECK_EQ(nvs->GetStationCount(), LYRAT_MAX_STATIONS);
+    CHECK_EQ(nvs->GetActStation(), 3);
+    CHECK_EQ(nvs->GetVolume(), 60);
+    CHECK_EQ(nvs->GetStationCheck(UUID_C), CheckListResult::Valid);
+}
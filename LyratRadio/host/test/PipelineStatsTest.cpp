@@ -0,0 +1,48 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <string.h>
+
+#include "PipelineStats.h"
+#include "TestRunner.h"
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(PipelineStatsTotals)
+{
+    PipelineStats stats;
+    PipelineStats::Counters_t counters;
+
+    // the remainder below one unit is carried to the next call
+    for (int i = 0; i < 4096; i++) {
+        stats.AddRead(PipelineStats::Http, 100, 250);
+    }
+    stats.AddWrite(PipelineStats::Http, 2048, 1500);
+    stats.AddProcess(PipelineStats::Decoder, 999);
+    stats.AddProcess(PipelineStats::Decoder, 1);
+    stats.AddUnderrun(PipelineStats::I2s);
+
+    stats.Get(PipelineStats::Http, counters);
+    CHECK_EQ(counters.mKbIn, 4096u * 100 / 1024);
+    CHECK_EQ(counters.mReadWaitMs, 4096u * 250 / 1000);
+    CHECK_EQ(counters.mKbOut, 2u);
+    CHECK_EQ(counters.mWriteWaitMs, 1u);
+
+    stats.Get(PipelineStats::Decoder, counters);
+    CHECK_EQ(counters.mProcessMs, 1u);
+    CHECK_EQ(counters.mChunks, 2u);
+
+    stats.Get(PipelineStats::I2s, counters);
+    CHECK_EQ(counters.mUnderruns, 1u);
+
+    CHECK(strcmp(PipelineStats::GetName(PipelineStats::Resample), "resample") == 0);
+    CHECK(strcmp(PipelineStats::GetName(PipelineStats::StageCount), "unknown") == 0);
+}
@@ -0,0 +1,66 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// Throughput of the resampler per quality and common input rate, in element
+// sized chunks. Cycles are host time stamp counter cycles per output frame.
+
+#include <stdio.h>
+
+#include "Resampler.h"
+#include "TestRunner.h"
+
+#define BENCH_OUT_RATE 44100
+#define BENCH_SECONDS 4
+#define BENCH_CHUNK_BYTES 4096
+
+static int16_t sChunk[BENCH_CHUNK_BYTES / sizeof(int16_t)];
+
+///////////////////////////////////////////////////////////////////////////////
+static void Measure(int inRate, int channels, Resampler::Quality_e quality)
+{
+    static Resampler resampler;
+    resampler.Initialize(BENCH_OUT_RATE, quality);
+    resampler.SetInputFormat(inRate, channels, 16);
+
+    size_t in = 0;
+    size_t out = 0;
+    int64_t time = TestRunner::Now();
+    uint64_t cycles = TestRunner::Cycles();
+    while (in < (size_t)inRate * BENCH_SECONDS) {
+        size_t frames = resampler.MaxInputBytes(BENCH_CHUNK_BYTES) / (channels * sizeof(int16_t));
+        out += resampler.Process(sChunk, frames);
+        in += frames;
+    }
+    cycles = TestRunner::Cycles() - cycles;
+    time = TestRunner::Now() - time;
+
+    // real time factor: seconds of audio per second of processing
+    printf("  %5d Hz %s, quality %d: %6.1f ns/frame, %6.1f cycles/frame, %5.0fx real time\n", inRate,
+        channels == 2 ? "stereo" : "mono  ", (int)quality, time * 1000.0 / out, (double)cycles / out,
+        BENCH_SECONDS * 1e6 / (time > 0 ? time : 1));
+    CHECK(out > 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(BenchResampler)
+{
+    for (int i = 0; i < (int)(sizeof(sChunk) / sizeof(sChunk[0])); i++) {
+        sChunk[i] = (int16_t)(i * 997);
+    }
+
+    Measure(48000, 2, Resampler::Low);
+    Measure(48000, 2, Resampler::Medium);
+    Measure(48000, 2, Resampler::High);
+    Measure(22050, 2, Resampler::Medium);
+    Measure(22050, 1, Resampler::Medium);
+    Measure(32000, 2, Resampler::High);
+}
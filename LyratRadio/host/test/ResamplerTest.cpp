@@ -0,0 +1,173 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+// Accuracy of the resampler: a sine is converted in element sized chunks,
+// the output is compared with the best fitting ideal sine of the output rate.
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Resampler.h"
+#include "TestRunner.h"
+
+#define OUT_RATE 44100
+#define TONE_HZ 1000.0
+#define TONE_AMPLITUDE 16000.0
+#define CHUNK_BYTES 4096 // ring buffer read of the element
+#define SKIP_FRAMES 64   // filter start and end
+
+static const double sPi = 3.14159265358979323846;
+
+typedef struct {
+    size_t mInFrames;
+    size_t mOutFrames;
+    double mSnrLeft;  // dB
+    double mSnrRight; // dB, the right channel carries the inverted tone
+    bool mbMonoEqual; // mono input: left == right
+} Result_t;
+
+///////////////////////////////////////////////////////////////////////////////
+// signal to noise of y against a sine of the tone frequency, amplitude and phase
+// by least squares: y ~ a * sin + b * cos
+static double Snr(const std::vector<double>& y)
+{
+    double w = 2 * sPi * TONE_HZ / OUT_RATE;
+    double ss = 0;
+    double cc = 0;
+    double sc = 0;
+    double ys = 0;
+    double yc = 0;
+    for (size_t i = SKIP_FRAMES; i < y.size() - SKIP_FRAMES; i++) {
+        double s = sin(w * i);
+        double c = cos(w * i);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y[i] * s;
+        yc += y[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = SKIP_FRAMES; i < y.size() - SKIP_FRAMES; i++) {
+        double fit = a * sin(w * i) + b * cos(w * i);
+        signal += fit * fit;
+        noise += (y[i] - fit) * (y[i] - fit);
+    }
+    return 10 * log10(signal / (noise > 0 ? noise : 1e-9));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static Result_t Convert(int inRate, int channels, Resampler::Quality_e quality, double seconds)
+{
+    static Resampler resampler;
+    resampler.Initialize(OUT_RATE, quality);
+    resampler.SetInputFormat(inRate, channels, 16);
+
+    Result_t result = { 0, 0, 0, 0, true };
+    std::vector<double> left;
+    std::vector<double> right;
+    size_t total = (size_t)(inRate * seconds);
+    int16_t chunk[CHUNK_BYTES / sizeof(int16_t)];
+
+    while (result.mInFrames < total) {
+        size_t frames = resampler.MaxInputBytes(CHUNK_BYTES) / (channels * sizeof(int16_t));
+        for (size_t i = 0; i < frames; i++) {
+            double value = TONE_AMPLITUDE * sin(2 * sPi * TONE_HZ * (result.mInFrames + i) / inRate);
+            chunk[i * channels] = (int16_t)lround(value);
+            if (channels == 2) {
+                chunk[i * channels + 1] = (int16_t)lround(-value);
+            }
+        }
+        size_t out = resampler.Process(chunk, frames);
+        const int16_t* pOut = resampler.GetOutput();
+        for (size_t i = 0; i < out; i++) {
+            left.push_back(pOut[2 * i]);
+            right.push_back(pOut[2 * i + 1]);
+            result.mbMonoEqual &= channels == 2 || pOut[2 * i] == pOut[2 * i + 1];
+        }
+        result.mInFrames += frames;
+    }
+
+    result.mOutFrames = left.size();
+    result.mSnrLeft = Snr(left);
+    if (channels == 2) {
+        for (size_t i = 0; i < right.size(); i++) {
+            right[i] = -right[i];
+        }
+        result.mSnrRight = Snr(right);
+    }
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// no drift: the output count follows the exact rate ratio, minus the filter delay
+TEST(ResamplerFrameCount)
+{
+    static const int rates[] = { 8000, 22050, 32000, 48000, 96000 };
+
+    for (int rate : rates) {
+        Result_t result = Convert(rate, 2, Resampler::Medium, 2.0);
+        double expected = (double)result.mInFrames * OUT_RATE / rate;
+        CHECK(fabs(result.mOutFrames - expected) <= 8);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(ResamplerAccuracy)
+{
+    static const struct {
+        int mRate;
+        Resampler::Quality_e mQuality;
+        double mMinSnr;
+    } cases[] = {
+        { 48000, Resampler::Low, 45 },
+        { 48000, Resampler::Medium, 58 },
+        { 48000, Resampler::High, 64 },
+        { 32000, Resampler::Medium, 55 },
+        { 22050, Resampler::Medium, 70 },
+        { 22050, Resampler::High, 80 },
+    };
+
+    for (const auto& c : cases) {
+        Result_t result = Convert(c.mRate, 2, c.mQuality, 0.5);
+        printf("  %5d Hz -> %d Hz, quality %d: snr %.1f / %.1f dB\n", c.mRate, OUT_RATE, (int)c.mQuality,
+            result.mSnrLeft, result.mSnrRight);
+        CHECK(result.mSnrLeft >= c.mMinSnr);
+        CHECK(result.mSnrRight >= c.mMinSnr);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(ResamplerMonoAndSameRate)
+{
+    Result_t result = Convert(22050, 1, Resampler::Medium, 0.5);
+    CHECK(result.mbMonoEqual);
+    CHECK(result.mSnrLeft >= 70);
+
+    // the same rate is copied, mono is doubled
+    result = Convert(OUT_RATE, 1, Resampler::High, 0.2);
+    CHECK(result.mbMonoEqual);
+    CHECK_EQ(result.mOutFrames, result.mInFrames);
+    CHECK(result.mSnrLeft >= 80);
+
+    // other sample formats are not converted
+    Resampler resampler;
+    resampler.Initialize(OUT_RATE, Resampler::Medium);
+    resampler.SetInputFormat(48000, 2, 24);
+    CHECK_EQ(resampler.MaxInputBytes(CHUNK_BYTES), (size_t)CHUNK_BYTES);
+    CHECK(resampler.IsBypass());
+}
@@ -0,0 +1,100 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "TestRunner.h"
+
+#define TEST_MAX_TESTS 128
+
+typedef struct {
+    const char* mpName;
+    TestRunner::Test_t mTest;
+} TestEntry_t;
+
+static TestEntry_t sTests[TEST_MAX_TESTS];
+static int sTestCount = 0;
+static int sFailures = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+void TestRunner::Register(const char* pName, Test_t test)
+{
+    if (sTestCount == TEST_MAX_TESTS) {
+        fprintf(stderr, "too many tests, %s is not registered\n", pName);
+        return;
+    }
+    sTests[sTestCount].mpName = pName;
+    sTests[sTestCount].mTest = test;
+    sTestCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void TestRunner::Fail(const char* pFile, int line, const char* pExpression)
+{
+    printf("  %s:%d: CHECK(%s) failed\n", pFile, line, pExpression);
+    sFailures++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int TestRunner::Run(const char* pFilter)
+{
+    int failed = 0;
+    int run = 0;
+
+    for (int i = 0; i < sTestCount; i++) {
+        if (pFilter != NULL && strstr(sTests[i].mpName, pFilter) == NULL) {
+            continue;
+        }
+        printf("[ RUN  ] %s\n", sTests[i].mpName);
+        int failures = sFailures;
+        sTests[i].mTest();
+        run++;
+        if (sFailures != failures) {
+            printf("[ FAIL ] %s\n", sTests[i].mpName);
+            failed++;
+        }
+        else {
+            printf("[  OK  ] %s\n", sTests[i].mpName);
+        }
+    }
+
+    printf("%d tests, %d failed\n", run, failed);
+    return failed == 0 ? 0 : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int64_t TestRunner::Now()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t TestRunner::Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    return TestRunner::Run(argc > 1 ? argv[1] : NULL);
+}
@@ -0,0 +1,58 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _TESTRUNNER_H_
+#define _TESTRUNNER_H_
+
+// Minimal test runner for the host build. Tests register themselves with
+// TEST(name), a failed CHECK is reported and the test goes on.
+// 'lyrat_tests [filter]' runs all tests whose name contains the filter.
+
+#include <stdint.h>
+#include <stddef.h>
+
+//////////////////////////////////////////////////////////////////////
+class TestRunner {
+public:
+    typedef void (*Test_t)();
+
+    static void Register(const char* pName, Test_t test);
+    static void Fail(const char* pFile, int line, const char* pExpression);
+    static int Run(const char* pFilter);
+
+    // for the benchmarks: us, monotonic; time stamp counter, 0 if the host has none
+    static int64_t Now();
+    static uint64_t Cycles();
+
+    class AutoRegister {
+    public:
+        AutoRegister(const char* pName, Test_t test) { Register(pName, test); }
+    };
+};
+
+#define TEST(name)                                                   \
+    static void name();                                              \
+    static TestRunner::AutoRegister name##Register(#name, name);     \
+    static void name()
+
+#define CHECK(expression)                                            \
+    do {                                                             \
+        if (!(expression)) {                                         \
+            TestRunner::Fail(__FILE__, __LINE__, #expression);       \
+        }                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
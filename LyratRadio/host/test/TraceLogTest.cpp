@@ -0,0 +1,72 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <string.h>
+
+#include "TraceLog.h"
+#include "TestRunner.h"
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(TraceLogRead)
+{
+    static TraceLog trace;
+    TraceLog::Entry_t entries[LYRAT_TRACE_PAGE_ENTRIES];
+    uint32_t from = 0;
+    uint32_t lost;
+
+    for (int i = 0; i < 10; i++) {
+        trace.Add(i, TraceLog::Command, i, -i);
+    }
+    CHECK_EQ(trace.Read(from, entries, LYRAT_TRACE_PAGE_ENTRIES, lost), 10u);
+    CHECK_EQ(from, 10u);
+    CHECK_EQ(lost, 0u);
+    CHECK_EQ(entries[9].mArg0, 9);
+    CHECK_EQ(entries[9].mArg1, -9);
+    CHECK_EQ(entries[9].mEvent, (uint16_t)TraceLog::Command);
+
+    // entries that were overwritten before the reader came are counted as lost
+    for (int i = 0; i < LYRAT_TRACE_ENTRIES + 5; i++) {
+        trace.Add(i, TraceLog::AudioEvent, i);
+    }
+    CHECK_EQ(trace.Read(from, entries, 1, lost), 1u);
+    CHECK_EQ(lost, 5u);
+    CHECK_EQ(entries[0].mArg0, 5);
+
+    // reading page by page continues behind the last entry
+    size_t total = 1;
+    size_t count;
+    while ((count = trace.Read(from, entries, LYRAT_TRACE_PAGE_ENTRIES, lost)) > 0) {
+        CHECK_EQ(lost, 0u);
+        total += count;
+    }
+    CHECK_EQ(total, (size_t)LYRAT_TRACE_ENTRIES);
+    CHECK_EQ(from, trace.GetHead());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+TEST(TraceLogEncode)
+{
+    TraceLog::Entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(&entry, "Man", 3);
+
+    char text[32];
+    CHECK_EQ(TraceLog::Encode(&entry, 1, text, sizeof(text)), 24u);
+    CHECK(strncmp(text, "TWFu", 4) == 0);
+    CHECK_EQ(strlen(text), 24u);
+    CHECK_EQ(TraceLog::Encode(&entry, 1, text, 24), 0u); // no room for the terminating 0
+
+    TraceLog::Entry_t entries[LYRAT_TRACE_PAGE_ENTRIES];
+    char page[(sizeof(entries) + 2) / 3 * 4 + 1];
+    memset(entries, 0, sizeof(entries));
+    CHECK_EQ(TraceLog::Encode(entries, LYRAT_TRACE_PAGE_ENTRIES, page, sizeof(page)), sizeof(page) - 1);
+}
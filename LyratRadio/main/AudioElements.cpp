@@ -0,0 +1,176 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_element.h"
+#include "ringbuf.h"
+
+#include "AudioElements.h"
+
+extern const char* TAG;
+
+// element data, owned by the element
+typedef struct {
+    void* mpProcessor; // GainStage or Resampler
+    PipelineStats* mpStats;
+    PipelineStats::Stage_e mStage;
+    bool mbFromDecoder; // input is the decoder output
+    bool mbToI2s;       // output is the i2s input
+} PcmElement_t;
+
+///////////////////////////////////////////////////////////////////////////////
+// Common
+///////////////////////////////////////////////////////////////////////////////
+static int pcm_input(audio_element_handle_t self, PcmElement_t* pEl, char* buffer, int len)
+{
+    PipelineStats* pStats = pEl->mpStats;
+    if (pStats == NULL) {
+        return audio_element_input(self, buffer, len);
+    }
+
+    ringbuf_handle_t rb = audio_element_get_input_ringbuf(self);
+    if (rb && rb_bytes_filled(rb) == 0) {
+        pStats->AddUnderrun(pEl->mStage);
+    }
+    int64_t start = esp_timer_get_time();
+    int read = audio_element_input(self, buffer, len);
+    uint32_t wait = (uint32_t)(esp_timer_get_time() - start);
+
+    if (read > 0) {
+        pStats->AddRead(pEl->mStage, read, wait);
+        if (pEl->mbFromDecoder) {
+            // the time until a chunk is decoded, decoder input stalls are counted by the jitter buffer
+            pStats->AddWrite(PipelineStats::Decoder, read, 0);
+            pStats->AddProcess(PipelineStats::Decoder, wait);
+        }
+    }
+    return read;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int pcm_output(audio_element_handle_t self, PcmElement_t* pEl, char* buffer, int len)
+{
+    PipelineStats* pStats = pEl->mpStats;
+    if (pStats == NULL) {
+        return audio_element_output(self, buffer, len);
+    }
+
+    ringbuf_handle_t rb = audio_element_get_output_ringbuf(self);
+    if (pEl->mbToI2s && rb && rb_bytes_filled(rb) == 0) {
+        pStats->AddUnderrun(PipelineStats::I2s); // i2s writer drained, the dma plays its last buffers
+    }
+    int64_t start = esp_timer_get_time();
+    int written = audio_element_output(self, buffer, len);
+    uint32_t wait = (uint32_t)(esp_timer_get_time() - start);
+
+    if (written > 0) {
+        pStats->AddWrite(pEl->mStage, written, wait);
+        if (pEl->mbToI2s) {
+            pStats->AddRead(PipelineStats::I2s, written, 0);
+        }
+    }
+    return written;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static esp_err_t pcm_destroy(audio_element_handle_t self)
+{
+    delete (PcmElement_t*)audio_element_getdata(self);
+    audio_element_setdata(self, NULL);
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static audio_element_handle_t pcm_element_init(audio_element_cfg_t& cfg, PcmElement_t* pEl)
+{
+    cfg.destroy = pcm_destroy;
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    mem_assert(el);
+    audio_element_setdata(el, pEl);
+    return el;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gain element
+///////////////////////////////////////////////////////////////////////////////
+static audio_element_err_t gain_process(audio_element_handle_t self, char* in_buffer, int in_len)
+{
+    PcmElement_t* pEl = (PcmElement_t*)audio_element_getdata(self);
+    int len = pcm_input(self, pEl, in_buffer, in_len);
+    if (len <= 0) {
+        return (audio_element_err_t)len;
+    }
+
+    GainStage* pGain = (GainStage*)pEl->mpProcessor;
+    int64_t start = esp_timer_get_time();
+    pGain->Process((int16_t*)in_buffer, len / pGain->GetFrameSize());
+    if (pEl->mpStats) {
+        pEl->mpStats->AddProcess(pEl->mStage, (uint32_t)(esp_timer_get_time() - start));
+    }
+    return (audio_element_err_t)pcm_output(self, pEl, in_buffer, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+audio_element_handle_t create_gain_element(GainStage* pGain, PipelineStats* pStats, bool bFromDecoder)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.process = gain_process;
+    cfg.task_stack = GAIN_ELEMENT_TASK_STACK;
+    cfg.out_rb_size = GAIN_ELEMENT_RB_SIZE;
+    cfg.tag = "gain";
+
+    PcmElement_t* pEl = new PcmElement_t { pGain, pStats, PipelineStats::Gain, bFromDecoder, true };
+    return pcm_element_init(cfg, pEl);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Resample element
+///////////////////////////////////////////////////////////////////////////////
+static audio_element_err_t resample_process(audio_element_handle_t self, char* in_buffer, int in_len)
+{
+    PcmElement_t* pEl = (PcmElement_t*)audio_element_getdata(self);
+    Resampler* pResampler = (Resampler*)pEl->mpProcessor;
+    int len = pcm_input(self, pEl, in_buffer, pResampler->MaxInputBytes(in_len));
+    if (len <= 0) {
+        return (audio_element_err_t)len;
+    }
+
+    if (pResampler->IsBypass()) {
+        return (audio_element_err_t)pcm_output(self, pEl, in_buffer, len);
+    }
+    int64_t start = esp_timer_get_time();
+    size_t frames = pResampler->Process((int16_t*)in_buffer, len / (pResampler->GetInChannels() * sizeof(int16_t)));
+    if (pEl->mpStats) {
+        pEl->mpStats->AddProcess(pEl->mStage, (uint32_t)(esp_timer_get_time() - start));
+    }
+    if (frames == 0) {
+        return (audio_element_err_t)len; // input kept as history, 0 would finish the element
+    }
+    return (audio_element_err_t)pcm_output(self, pEl, (char*)pResampler->GetOutput(), frames * 2 * sizeof(int16_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+audio_element_handle_t create_resample_element(Resampler* pResampler, PipelineStats* pStats)
+{
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.process = resample_process;
+    cfg.task_stack = RESAMPLE_ELEMENT_TASK_STACK;
+    cfg.out_rb_size = RESAMPLE_ELEMENT_RB_SIZE;
+    cfg.buffer_len = LYRAT_RESAMPLE_IN_FRAMES * 2 * sizeof(int16_t);
+    cfg.tag = "resample";
+
+    PcmElement_t* pEl = new PcmElement_t { pResampler, pStats, PipelineStats::Resample, true, false };
+    return pcm_element_init(cfg, pEl);
+}
@@ -0,0 +1,41 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _AUDIOELEMENTS_H_
+#define _AUDIOELEMENTS_H_
+
+// ADF elements around the platform independent pcm processors
+
+#include "audio_element.h"
+
+#include "GainStage.h"
+#include "Resampler.h"
+#include "PipelineStats.h"
+
+#define GAIN_ELEMENT_RB_SIZE (4 * 1024) // output ring buffer, about 23 ms at 44.1 kHz stereo
+#define GAIN_ELEMENT_TASK_STACK (2 * 1024)
+
+// pcm in place through pGain, the element does not own pGain or pStats (may be NULL);
+// bFromDecoder: the element is linked behind the decoder and measures it
+audio_element_handle_t create_gain_element(GainStage* pGain, PipelineStats* pStats, bool bFromDecoder);
+
+#define RESAMPLE_ELEMENT_RB_SIZE (8 * 1024) // output ring buffer, about 46 ms at 44.1 kHz stereo
+#define RESAMPLE_ELEMENT_TASK_STACK (3 * 1024)
+
+// pcm to the fixed output rate of pResampler, always linked behind the decoder;
+// the element does not own pResampler or pStats (may be NULL)
+audio_element_handle_t create_resample_element(Resampler* pResampler, PipelineStats* pStats);
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
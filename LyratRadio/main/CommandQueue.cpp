@@ -0,0 +1,121 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include "CommandQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+CommandQueue::CommandQueue()
+    : mEnqueuePos(0)
+    , mDequeuePos(0)
+    , mbNotified(false)
+{
+    for (uint32_t i = 0; i < LYRAT_COMMAND_QUEUE_SIZE; i++) {
+        mCells[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// each cell carries a sequence number: == pos means free for the producer
+// of pos, == pos + 1 means filled for the consumer of pos
+bool CommandQueue::Push(const Command_t& cmd, bool& bNotify)
+{
+    bNotify = false;
+
+    uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell_t& cell = mCells[pos & (LYRAT_COMMAND_QUEUE_SIZE - 1)];
+        int32_t diff = (int32_t)(cell.mSequence.load(std::memory_order_acquire) - pos);
+
+        if (diff == 0) {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.mCmd = cmd;
+                cell.mSequence.store(pos + 1, std::memory_order_release);
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false; // full
+        }
+        else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // only the first command after a drain wakes up the consumer
+    bNotify = !mbNotified.exchange(true);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool CommandQueue::Pop(Command_t& cmd)
+{
+    Cell_t& cell = mCells[mDequeuePos & (LYRAT_COMMAND_QUEUE_SIZE - 1)];
+    if (cell.mSequence.load(std::memory_order_acquire) != mDequeuePos + 1) {
+        return false; // empty or not yet completely written
+    }
+
+    cmd = cell.mCmd;
+    cell.mSequence.store(mDequeuePos + LYRAT_COMMAND_QUEUE_SIZE, std::memory_order_release);
+    mDequeuePos++;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool CommandQueue::Drain(PendingCommands_t& pending)
+{
+    pending = PendingCommands_t();
+
+    // clear before popping, a command pushed meanwhile sends a new notification
+    mbNotified.store(false);
+
+    bool bAny = false;
+    Command_t cmd;
+    while (Pop(cmd)) {
+        bAny = true;
+
+        bool bStation = cmd.mCmd == CmdSetStation || cmd.mCmd == CmdNextStation || cmd.mCmd == CmdPreviousStation;
+        if (bStation && pending.mStationTime == 0) {
+            pending.mStationTime = cmd.mTime;
+        }
+
+        switch (cmd.mCmd) {
+        case CmdSetStation:
+            pending.mbStation = true;
+            pending.mStation = cmd.mValue;
+            pending.mStationDelta = 0;
+            break;
+        case CmdNextStation:
+            pending.mStationDelta++;
+            break;
+        case CmdPreviousStation:
+            pending.mStationDelta--;
+            break;
+        case CmdSetOnOff:
+            pending.mbOnOff = true;
+            pending.mOn = cmd.mValue != 0;
+            break;
+        case CmdSetVolume:
+            pending.mbVolume = true;
+            pending.mVolume = cmd.mValue;
+            pending.mVolumeDelta = 0;
+            break;
+        case CmdChangeVolume:
+            pending.mVolumeDelta += cmd.mValue;
+            break;
+        case CmdResolved:
+            pending.mbResolved = true;
+            break;
+        }
+    }
+    return bAny;
+}
@@ -0,0 +1,86 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _COMMANDQUEUE_H_
+#define _COMMANDQUEUE_H_
+
+// Bounded lock-free command ring between the control/key tasks (producers)
+// and the audio event loop (single consumer). No ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <atomic>
+
+#define LYRAT_COMMAND_QUEUE_SIZE 16 // power of 2
+
+//////////////////////////////////////////////////////////////////////
+enum Command_e {
+    CmdSetStation,
+    CmdNextStation,
+    CmdPreviousStation,
+    CmdSetOnOff,
+    CmdSetVolume,
+    CmdChangeVolume,
+    CmdResolved, // a stream url was resolved in the background
+};
+
+typedef struct {
+    int mCmd;
+    int mValue;
+    int64_t mTime; // us, time the command was posted
+} Command_t;
+
+//////////////////////////////////////////////////////////////////////
+// result of a drain, repeated commands are coalesced, the last one wins
+typedef struct {
+    bool mbStation;    // mStation is valid
+    int mStation;      // absolute station
+    int mStationDelta; // next/previous relative to mStation or the active station
+    int64_t mStationTime; // time of the first station command, for latency measurement
+    bool mbVolume;     // mVolume is valid
+    int mVolume;       // absolute volume
+    int mVolumeDelta;  // change relative to mVolume or the active volume
+    bool mbOnOff;
+    bool mOn;
+    bool mbResolved;
+} PendingCommands_t;
+
+//////////////////////////////////////////////////////////////////////
+class CommandQueue {
+public:
+    CommandQueue();
+
+    // any task, returns false if the ring is full;
+    // bNotify is set if the consumer has to be woken up
+    bool Push(const Command_t& cmd, bool& bNotify);
+
+    // consumer only, returns false if there was nothing to do
+    bool Drain(PendingCommands_t& pending);
+
+private:
+    bool Pop(Command_t& cmd);
+
+private:
+    typedef struct {
+        std::atomic<uint32_t> mSequence;
+        Command_t mCmd;
+    } Cell_t;
+
+    Cell_t mCells[LYRAT_COMMAND_QUEUE_SIZE];
+    std::atomic<uint32_t> mEnqueuePos;
+    uint32_t mDequeuePos;
+    std::atomic<bool> mbNotified;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -11,11 +11,13 @@
 ****************************************************************************************/
 
 #include <string.h>
+#include <algorithm>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -24,13 +26,22 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
-#include "cJSON.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
 #include "WebRadio.h"
 #include "DataWebRadio.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 DataWebRadio::DataWebRadio()
+    : mbSubscribe(false)
+    , mTraceFrom(0)
+    , mIdIndex(-2)
+    , mpConfigError(NULL)
+    , mNowPlayingMux(portMUX_INITIALIZER_UNLOCKED)
+    , mNowPlayingSequence(0)
 {
+    mNowPlayingId[0] = 0;
+    mNowPlayingTitle[0] = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,198 +51,500 @@ esp_err_t DataWebRadio::Initialize(WebRadio* webRadio)
 
     esp_err_t err = NVSWebRadio::Initialize();
     if (err == ESP_OK) {
-        Settings_t set;
-        GetSettings(set);
-        Debug(set);
+        SettingsView set(*this);
+        ESP_LOGI(TAG, "[ DATA ] %s: %d stations, act %d, volume %d", set->mRadioName.c_str(), set->mStations.size(), set->mActStation, set->mVolume);
     }
     return err;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void DataWebRadio::Debug(Settings_t& set)
+void DataWebRadio::SetNowPlayingStation(const char* pId)
 {
-    ESP_LOGI(TAG, "[ DATA ] mCredentials %s, %s", set.mCredentials.mSSID.c_str(), /*set.mCredentials.mPassword.c_str()*/ "*****");
-    ESP_LOGI(TAG, "[ DATA ] mBluetooth %d, %s", set.mBluetooth.mbEnabled, set.mBluetooth.mPair.c_str());
-    ESP_LOGI(TAG, "[ DATA ] mActTune %s, %s, %s", set.mActTune.mUrl.c_str(), set.mActTune.mDecoder.c_str(), set.mActTune.mId.c_str());
+    portENTER_CRITICAL(&mNowPlayingMux);
+    strlcpy(mNowPlayingId, pId, sizeof(mNowPlayingId));
+    mNowPlayingTitle[0] = 0;
+    mNowPlayingSequence++;
+    portEXIT_CRITICAL(&mNowPlayingMux);
+}
 
-    // Station_t presets
-    for (int i = 0; i < set.mStations.size(); i++) {
-        ESP_LOGI(TAG, "[ DATA ] mStations[%d] %s, %s, %s", i, set.mStations[i].mId.c_str(), set.mStations[i].mUrl.c_str(), set.mStations[i].mDecoder.c_str());
-    }
-    ESP_LOGI(TAG, "[ DATA ] mRadioName %s", set.mRadioName.c_str());
-    ESP_LOGI(TAG, "[ DATA ] mVolume %d", set.mVolume);
-    ESP_LOGI(TAG, "[ DATA ] mActStation %d", set.mActStation);
-    ESP_LOGI(TAG, "[ DATA ] mRestartCount %d", GetRestartCount());
+///////////////////////////////////////////////////////////////////////////////
+void DataWebRadio::SetNowPlaying(const char* pTitle)
+{
+    portENTER_CRITICAL(&mNowPlayingMux);
+    strlcpy(mNowPlayingTitle, pTitle, sizeof(mNowPlayingTitle));
+    mNowPlayingSequence++;
+    portEXIT_CRITICAL(&mNowPlayingMux);
+
+    ESP_LOGI(TAG, "[ DATA ] now playing '%s'", pTitle);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t DataWebRadio::GetNowPlayingSequence()
+{
+    portENTER_CRITICAL(&mNowPlayingMux);
+    uint32_t sequence = mNowPlayingSequence;
+    portEXIT_CRITICAL(&mNowPlayingMux);
+    return sequence;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void DataWebRadio::HandleMessage(MessageType_e msg, char* buffer, size_t size)
 {
-    Settings_t set;
+    JsonReader& json = mRequest;
 
-    cJSON* root = cJSON_Parse(buffer); // message is valid json message string (alredy checked in IsWebRadioRequest
-    cJSON* webradio = cJSON_GetObjectItem(root, LYRAT_NET_WEBRADIO);
+    // message is already tokenized in IsWebRadioRequest
+    if (!json.IsParsed(buffer) && !json.Parse(buffer, strnlen(buffer, size))) {
+        return;
+    }
+    int webradio = json.Find(0, LYRAT_NET_WEBRADIO);
 
     IWebRadioCommands& command = mWebRadio->GetCommandInterface();
 
     switch (msg) {
     case DataWebRadio::Configuration: {
-        cJSON* configuration = cJSON_GetObjectItem(webradio, LYRAT_NET_CONFIGURATION);
+        int configuration = json.Find(webradio, LYRAT_NET_CONFIGURATION);
 
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_BLUETOOTH)) {
-            cJSON* bluetooth = cJSON_GetObjectItem(configuration, LYRAT_NET_BLUETOOTH);
-            cJSON* jsonEnabled = cJSON_GetObjectItem(bluetooth, LYRAT_NET_BT_ENABLED);
-            if (jsonEnabled != NULL) {
-                set.mBluetooth.mbEnabled = jsonEnabled->valueint;
-            }
-            set.mBluetooth.mPair = cJSON_GetStringValue(cJSON_GetObjectItem(bluetooth, LYRAT_NET_BT_PAIR));
-            SetBluetooth(set.mBluetooth);
-        }
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_STATIONLIST)) {
-            cJSON* stationList = cJSON_GetObjectItem(configuration, LYRAT_NET_STATIONLIST);
-            int sizeArr = cJSON_GetArraySize(stationList);
-            for (int i = 0; i < sizeArr; i++) {
-                Station_t station;
-                cJSON* jsonStation = cJSON_GetArrayItem(stationList, i);
+        int sections = 0;
+        int stations = 0;
 
-                station.mId = cJSON_GetStringValue(cJSON_GetObjectItem(jsonStation, LYRAT_NET_ST_ID));
-                station.mUrl = cJSON_GetStringValue(cJSON_GetObjectItem(jsonStation, LYRAT_NET_ST_URL));
-                station.mDecoder = cJSON_GetStringValue(cJSON_GetObjectItem(jsonStation, LYRAT_NET_ST_DECODER));
-                set.mStations.push_back(station);
+        // stations are taken only as a whole: nothing is cut or dropped when the list is written to flash
+        int stationList = json.Find(configuration, LYRAT_NET_STATIONLIST);
+        int actTune = json.Find(configuration, LYRAT_NET_ACTTUNE);
+        mpConfigError = (stationList >= 0 || actTune >= 0) ? CheckStations(actTune, stationList) : NULL;
+        if (mpConfigError != NULL) {
+            ESP_LOGE(TAG, "[ DATA ] stations rejected: %s", mpConfigError);
+        }
 
-                SetStation(i, set.mStations[i], set.mStations.size());
+        if (json.Has(configuration, LYRAT_NET_BLUETOOTH)) {
+            sections |= 1;
+            int bluetooth = json.Find(configuration, LYRAT_NET_BLUETOOTH);
+            Bluetooth_t bt;
+            bt.mbEnabled = json.GetInt(json.Find(bluetooth, LYRAT_NET_BT_ENABLED), bt.mbEnabled);
+            bt.mPair = json.GetString(json.Find(bluetooth, LYRAT_NET_BT_PAIR));
+            SetBluetooth(bt);
+        }
+        if (stationList >= 0 && mpConfigError == NULL) {
+            sections |= 2;
+            stations = json.ArraySize(stationList);
+            for (int i = 0; i < stations; i++) {
+                Station_t station;
+                ReadStation(json.ArrayItem(stationList, i), station);
+                SetStation(i, station, stations);
             }
             command.SetStation(0); // reset counter to 0
         }
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_ACTTUNE)) {
-            cJSON* station = cJSON_GetObjectItem(configuration, LYRAT_NET_ACTTUNE);
-
-            set.mActTune.mId = cJSON_GetStringValue(cJSON_GetObjectItem(station, LYRAT_NET_ST_ID));
-            set.mActTune.mUrl = cJSON_GetStringValue(cJSON_GetObjectItem(station, LYRAT_NET_ST_URL));
-            set.mActTune.mDecoder = cJSON_GetStringValue(cJSON_GetObjectItem(station, LYRAT_NET_ST_DECODER));
-            SetStation(-1, set.mActTune);
+        if (actTune >= 0 && mpConfigError == NULL) {
+            sections |= 4;
+            Station_t station;
+            ReadStation(actTune, station);
+            SetStation(-1, station);
             SetActStation(-1);
-            command.SetStation(set.mActStation);
+            command.SetStation(-1);
         }
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_RADIO)) {
-            std::string newName = cJSON_GetStringValue(cJSON_GetObjectItem(configuration, LYRAT_NET_RADIO));
-            if (!newName.empty()) {
-                set.mRadioName = newName;
-                //printf("###### set.mRadioName %s", set.mRadioName.c_str());
-                SetName(set.mRadioName);
+        if (json.Has(configuration, LYRAT_NET_RADIO)) {
+            sections |= 8;
+            const char* pName = json.GetString(json.Find(configuration, LYRAT_NET_RADIO));
+            if (pName[0] != 0) {
+                SetName(pName);
             }
         }
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_VOLUME)) {
-            cJSON* volume = cJSON_GetObjectItem(configuration, LYRAT_NET_VOLUME);
-            if (volume != NULL) {
-                set.mVolume = volume->valueint;
-            }
-            SetVolume(set.mVolume);
+        if (json.Has(configuration, LYRAT_NET_VOLUME)) {
+            sections |= 16;
+            int volume = json.GetInt(json.Find(configuration, LYRAT_NET_VOLUME), GetVolume());
+            SetVolume(volume);
 
-            command.SetVolume(set.mVolume);
+            command.SetVolume(volume);
         }
-        if (cJSON_HasObjectItem(configuration, LYRAT_NET_CREDENTIALS)) {
-            GetCredentials(set.mCredentials); // default init
-
-            cJSON* credentials = cJSON_GetObjectItem(configuration, LYRAT_NET_CREDENTIALS);
-            set.mCredentials.mSSID = cJSON_GetStringValue(cJSON_GetObjectItem(credentials, LYRAT_NET_RADIOSSID));
-            if (cJSON_GetObjectItem(credentials, LYRAT_NET_RADIOPASSWD) != NULL) {
-                set.mCredentials.mPassword = cJSON_GetStringValue(cJSON_GetObjectItem(credentials, LYRAT_NET_RADIOPASSWD));
+        if (json.Has(configuration, LYRAT_NET_CREDENTIALS)) {
+            mWebRadio->Trace(TraceLog::Configuration, stations, sections | 32);
+            Credentials_t cr;
+            GetCredentials(cr); // default init
+
+            int credentials = json.Find(configuration, LYRAT_NET_CREDENTIALS);
+            cr.mSSID = json.GetString(json.Find(credentials, LYRAT_NET_RADIOSSID));
+            if (json.Has(credentials, LYRAT_NET_RADIOPASSWD)) {
+                cr.mPassword = json.GetString(json.Find(credentials, LYRAT_NET_RADIOPASSWD));
             }
-            SetCredentials(set.mCredentials);
+            SetCredentials(cr);
+            Flush();
 
             vTaskDelay(1000 / portTICK_PERIOD_MS);
             esp_restart();
         }
-        Settings_t set;
-        GetSettings(set);
-        Debug(set);
+        mWebRadio->Trace(TraceLog::Configuration, stations, sections);
+    } break;
+
+    case DataWebRadio::NowPlaying: {
+        // {"now_playing":{"subscribe":1}} pushes every new title on a tcp connection
+        int nowPlaying = json.Find(webradio, LYRAT_NET_NOWPLAYING);
+        mbSubscribe = json.GetInt(json.Find(nowPlaying, LYRAT_NET_SUBSCRIBE), 0) != 0;
+    } break;
+
+    case DataWebRadio::Trace: {
+        // {"trace":{"from":n}} with "next" of the last response, without from the oldest entries
+        int trace = json.Find(webradio, LYRAT_NET_TRACE);
+        mTraceFrom = json.GetInt(json.Find(trace, LYRAT_NET_FROM), 0);
+    } break;
+
+    case DataWebRadio::PlayId: {
+        // {"play_id":{"st_id":"..."}} plays a preset or the act tune
+        int playId = json.Find(webradio, LYRAT_NET_PLAYID);
+        mIdRequest = json.GetString(json.Find(playId, LYRAT_NET_ST_ID));
+        mIdIndex = FindStation(mIdRequest.c_str());
+        if (mIdIndex < 0) {
+            Station_t actTune;
+            GetStation(-1, actTune);
+            mIdIndex = (!mIdRequest.empty() && actTune.mId == mIdRequest) ? -1 : -2;
+        }
+        if (mIdIndex >= -1) {
+            command.SetStation(mIdIndex);
+        }
+    } break;
+
+    case DataWebRadio::RemoveId: {
+        // {"remove_id":{"st_id":"..."}} removes a preset, the presets behind move up
+        int removeId = json.Find(webradio, LYRAT_NET_REMOVEID);
+        mIdRequest = json.GetString(json.Find(removeId, LYRAT_NET_ST_ID));
+        mIdIndex = RemoveStation(mIdRequest.c_str()); // one lookup, under the settings lock
+        if (mIdIndex < 0) {
+            mIdIndex = -2;
+        }
     } break;
 
     default:
         break;
     };
 
-    cJSON_Delete(root);
+    json.Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// station object of a configuration request, false if a value is too long (and cut)
+bool DataWebRadio::ReadStation(int token, Station_t& station)
+{
+    JsonReader& json = mRequest;
+
+    bool bFit = station.mId.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_ID)));
+    bFit &= station.mUrl.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_URL)));
+    bFit &= station.mDecoder.Assign(json.GetString(json.Find(token, LYRAT_NET_ST_DECODER)));
+    if (!bFit) {
+        ESP_LOGW(TAG, "[ DATA ] station '%s' exceeds %d/%d/%d characters", station.mId.c_str(), (int)station.mId.capacity(),
+            (int)station.mUrl.capacity(), (int)station.mDecoder.capacity());
+    }
+    return bFit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// NULL if act tune and presets fit into the settings and the station list blob, else the error
+// of the response; a token of -1 keeps the stored value
+const char* DataWebRadio::CheckStations(int actTune, int stationList)
+{
+    JsonReader& json = mRequest;
+    Station_t station;
+    size_t size = LYRAT_NVS_STATIONS_HEADER;
+    bool bFit = true;
+    int count = 0;
+
+    if (actTune >= 0) {
+        bFit &= ReadStation(actTune, station);
+        size += StationBlobSize(station);
+    }
+    if (stationList >= 0) {
+        count = json.ArraySize(stationList);
+        for (int i = 0; i < count && i <= LYRAT_MAX_STATIONS && bFit; i++) {
+            bFit &= ReadStation(json.ArrayItem(stationList, i), station);
+            size += StationBlobSize(station);
+        }
+    }
+    if (actTune < 0 || stationList < 0) {
+        SettingsView set(*this);
+        if (actTune < 0) {
+            size += StationBlobSize(set->mActTune);
+        }
+        if (stationList < 0) {
+            count = set->mStations.size();
+            for (const Station_t& st : set->mStations) {
+                size += StationBlobSize(st);
+            }
+        }
+    }
+
+    if (!bFit) {
+        return LYRAT_NET_ERR_STATION_SIZE;
+    }
+    if (count > LYRAT_MAX_STATIONS || size > LYRAT_NVS_STATIONS_MAX_SIZE) {
+        ESP_LOGW(TAG, "[ DATA ] %d stations with %d bytes, limits are %d stations and %d bytes", count, (int)size,
+            LYRAT_MAX_STATIONS, LYRAT_NVS_STATIONS_MAX_SIZE);
+        return LYRAT_NET_ERR_LIST_SIZE;
+    }
+    return NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
+// the response is written directly into buffer, false if it does not fit
 bool DataWebRadio::CreateMessageResponse(MessageType_e msg, char* buffer, size_t size)
 {
     bool bSendResponse = false;
 
-    cJSON* root = cJSON_CreateObject();
-    cJSON* json;
+    JsonWriter json(buffer, size);
+    json.BeginObject();
 
     switch (msg) {
     case DataWebRadio::FindBoard: {
-        cJSON* alive;
-        Settings_t settings;
-        GetSettings(settings);
-
-        cJSON_AddItemToObject(root, LYRAT_NET_WEBRADIO, alive = cJSON_CreateObject());
-        cJSON_AddItemToObject(alive, LYRAT_NET_BOARDALIVE, json = cJSON_CreateObject());
-        cJSON_AddStringToObject(json, LYRAT_NET_NAME, settings.mRadioName.c_str());
-        cJSON_AddStringToObject(json, "id", mWebRadio->GetWifiWebRadio().getId().c_str());
-        cJSON_AddStringToObject(json, LYRAT_NET_IP, mWebRadio->GetWifiWebRadio().getIp().c_str());
+        RadioName_t name;
+        GetName(name);
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject(LYRAT_NET_BOARDALIVE);
+        json.AddString(LYRAT_NET_NAME, name.c_str());
+        json.AddString("id", mWebRadio->GetWifiWebRadio().getId().c_str());
+        json.AddString(LYRAT_NET_IP, mWebRadio->GetWifiWebRadio().getIp().c_str());
+        json.EndObject();
+        json.EndObject();
         bSendResponse = true;
     } break;
 
     case DataWebRadio::Configuration: {
-        cJSON* stations;
-        cJSON* station;
-        cJSON* credentials;
-        cJSON* bluetooth;
-        Settings_t set;
-        GetSettings(set);
-
-        cJSON_AddItemToObject(root, LYRAT_NET_WEBRADIO, json = cJSON_CreateObject());
-
-        cJSON_AddItemToObject(json, LYRAT_NET_CREDENTIALS, credentials = cJSON_CreateObject());
-        cJSON_AddStringToObject(credentials, LYRAT_NET_RADIOSSID, set.mCredentials.mSSID.c_str());
-        cJSON_AddStringToObject(credentials, LYRAT_NET_RADIOPASSWD, "****");
-
-        cJSON_AddItemToObject(json, LYRAT_NET_BLUETOOTH, bluetooth = cJSON_CreateObject());
-        cJSON_AddNumberToObject(bluetooth, LYRAT_NET_BT_ENABLED, set.mBluetooth.mbEnabled);
-        cJSON_AddStringToObject(bluetooth, LYRAT_NET_BT_PAIR, set.mBluetooth.mPair.c_str());
-
-        cJSON_AddItemToObject(json, LYRAT_NET_STATIONLIST, stations = cJSON_CreateArray());
-        for (auto st : set.mStations) {
-            cJSON_AddItemToArray(stations, station = cJSON_CreateObject());
-            cJSON_AddStringToObject(station, LYRAT_NET_ST_ID, st.mId.c_str());
-            cJSON_AddStringToObject(station, LYRAT_NET_ST_URL, st.mUrl.c_str());
-            cJSON_AddStringToObject(station, LYRAT_NET_ST_DECODER, st.mDecoder.c_str());
+        SettingsView set(*this);
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+
+        json.BeginObject(LYRAT_NET_CREDENTIALS);
+        json.AddString(LYRAT_NET_RADIOSSID, set->mCredentials.mSSID.c_str());
+        json.AddString(LYRAT_NET_RADIOPASSWD, "****");
+        json.EndObject();
+
+        json.BeginObject(LYRAT_NET_BLUETOOTH);
+        json.AddNumber(LYRAT_NET_BT_ENABLED, set->mBluetooth.mbEnabled);
+        json.AddString(LYRAT_NET_BT_PAIR, set->mBluetooth.mPair.c_str());
+        json.EndObject();
+
+        json.BeginArray(LYRAT_NET_STATIONLIST);
+        for (const Station_t& st : set->mStations) {
+            json.BeginObject();
+            json.AddString(LYRAT_NET_ST_ID, st.mId.c_str());
+            json.AddString(LYRAT_NET_ST_URL, st.mUrl.c_str());
+            json.AddString(LYRAT_NET_ST_DECODER, st.mDecoder.c_str());
+            json.EndObject();
         }
-        cJSON_AddItemToObject(json, LYRAT_NET_ACTTUNE, station = cJSON_CreateObject());
-        cJSON_AddStringToObject(station, LYRAT_NET_ST_ID, set.mActTune.mId.c_str());
-        cJSON_AddStringToObject(station, LYRAT_NET_ST_URL, set.mActTune.mUrl.c_str());
-        cJSON_AddStringToObject(station, LYRAT_NET_ST_DECODER, set.mActTune.mDecoder.c_str());
-
-        cJSON_AddStringToObject(json, LYRAT_NET_RADIO, set.mRadioName.c_str());
-        cJSON_AddNumberToObject(json, LYRAT_NET_VOLUME, set.mVolume);
-        cJSON_AddNumberToObject(json, LYRAT_NET_ACTSTATION, set.mActStation);
+        json.EndArray();
+
+        json.BeginObject(LYRAT_NET_ACTTUNE);
+        json.AddString(LYRAT_NET_ST_ID, set->mActTune.mId.c_str());
+        json.AddString(LYRAT_NET_ST_URL, set->mActTune.mUrl.c_str());
+        json.AddString(LYRAT_NET_ST_DECODER, set->mActTune.mDecoder.c_str());
+        json.EndObject();
+
+        json.AddString(LYRAT_NET_RADIO, set->mRadioName.c_str());
+        json.AddNumber(LYRAT_NET_VOLUME, set->mVolume);
+        json.AddNumber(LYRAT_NET_ACTSTATION, set->mActStation);
+        if (mpConfigError != NULL) {
+            json.AddString(LYRAT_NET_ERROR, mpConfigError);
+        }
+        json.EndObject();
 
         bSendResponse = true;
     } break;
 
     case DataWebRadio::PlayIds: {
-        cJSON* playids;
-        cJSON* stations;
-        cJSON* station;
-        Settings_t set;
-        GetSettings(set);
-
-        cJSON_AddItemToObject(root, LYRAT_NET_WEBRADIO, playids = cJSON_CreateObject());
-        cJSON_AddItemToObject(playids, LYRAT_NET_PLAYIDS, stations = cJSON_CreateArray());
-
-        std::vector<CheckListEntry_t> entryList;
-
-        GetCheckedStations(entryList);
-        for (std::size_t i = 0; i < entryList.size(); ++i) {
-            cJSON_AddItemToArray(stations, station = cJSON_CreateObject());
-            cJSON_AddStringToObject(station, LYRAT_NET_ST_ID, entryList[i].mId.c_str());
-            cJSON_AddStringToObject(station, LYRAT_NET_CHECK, entryList[i].ResultString());
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginArray(LYRAT_NET_PLAYIDS);
+
+        // newest first, as many entries as fit into the buffer
+        char id[40];
+        CheckListResult result;
+        int count = GetCheckedStationCount();
+        for (int i = 0; i < count && GetCheckedStation(i, id, result); i++) {
+            JsonWriter::Mark_t mark = json.GetMark();
+            json.BeginObject();
+            json.AddString(LYRAT_NET_ST_ID, id);
+            json.AddString(LYRAT_NET_CHECK, CheckListResultString(result));
+            json.EndObject();
+
+            if (json.Overflow()) {
+                ESP_LOGW(TAG, "[ DATA ] playids truncated to %d of %d entries", i, count);
+                json.Rollback(mark);
+                break;
+            }
+        }
+
+        json.EndArray();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::StationStats: {
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginArray(LYRAT_NET_STATIONSTATS);
+
+        // most recently played first, as many entries as fit into the buffer
+        char id[40];
+        StationStats_t stats;
+        int count = GetStationStatsCount();
+        for (int i = 0; i < count && GetStationStats(i, id, stats); i++) {
+            JsonWriter::Mark_t mark = json.GetMark();
+            json.BeginObject();
+            json.AddString(LYRAT_NET_ST_ID, id);
+            json.AddNumber(LYRAT_NET_PLAYS, stats.mPlays);
+            json.AddNumber(LYRAT_NET_TTFA, stats.mTtfaMs);
+            json.AddNumber(LYRAT_NET_UNDERRUNS, stats.mUnderruns);
+            json.AddNumber(LYRAT_NET_BITRATE, stats.mBitrate);
+            json.AddNumber(LYRAT_NET_RECONNECTS, stats.mReconnects);
+            json.AddNumber(LYRAT_NET_LASTERROR, stats.mLastError);
+            json.AddNumber(LYRAT_NET_SCORE, stats.Score());
+            json.EndObject();
+
+            if (json.Overflow()) {
+                ESP_LOGW(TAG, "[ DATA ] station_stats truncated to %d of %d entries", i, count);
+                json.Rollback(mark);
+                break;
+            }
+        }
+
+        json.EndArray();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::NowPlaying: {
+        char id[sizeof(mNowPlayingId)];
+        char title[sizeof(mNowPlayingTitle)];
+        portENTER_CRITICAL(&mNowPlayingMux);
+        strcpy(id, mNowPlayingId);
+        strcpy(title, mNowPlayingTitle);
+        portEXIT_CRITICAL(&mNowPlayingMux);
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject(LYRAT_NET_NOWPLAYING);
+        json.AddString(LYRAT_NET_ST_ID, id);
+        json.AddString(LYRAT_NET_TITLE, title);
+        json.EndObject();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::Trace: {
+        TraceLog::Entry_t entries[LYRAT_TRACE_PAGE_ENTRIES];
+        char data[(sizeof(entries) + 2) / 3 * 4 + 1];
+        uint32_t from = (uint32_t)std::max(mTraceFrom, 0);
+        uint32_t lost;
+        size_t count = mWebRadio->GetTraceLog().Read(from, entries, LYRAT_TRACE_PAGE_ENTRIES, lost);
+        TraceLog::Encode(entries, count, data, sizeof(data));
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject(LYRAT_NET_TRACE);
+        json.AddNumber(LYRAT_NET_NEXT, (int)from);
+        json.AddNumber(LYRAT_NET_HEAD, (int)mWebRadio->GetTraceLog().GetHead());
+        json.AddNumber(LYRAT_NET_LOST, (int)lost);
+        json.AddNumber(LYRAT_NET_NOW, (int)(uint32_t)esp_timer_get_time());
+        json.AddString(LYRAT_NET_DATA, data);
+        json.EndObject();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::PlayId:
+    case DataWebRadio::RemoveId: {
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject((msg == DataWebRadio::PlayId) ? LYRAT_NET_PLAYID : LYRAT_NET_REMOVEID);
+        json.AddString(LYRAT_NET_ST_ID, mIdRequest.c_str());
+        json.AddNumber(LYRAT_NET_FOUND, mIdIndex >= -1);
+        json.AddNumber(LYRAT_NET_INDEX, mIdIndex);
+        json.EndObject();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::Telemetry: {
+        ::Telemetry& telemetry = mWebRadio->GetTelemetry();
+        ::Telemetry::Heap_t heap;
+        telemetry.GetHeap(heap);
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject(LYRAT_NET_TELEMETRY);
+        json.AddNumber(LYRAT_NET_UPTIME, (int)(esp_timer_get_time() / 1000));
+
+        json.BeginObject(LYRAT_NET_HEAP);
+        json.AddNumber(LYRAT_NET_FREE, heap.mFree);
+        json.AddNumber(LYRAT_NET_MIN_FREE, heap.mMinFree);
+        json.AddNumber(LYRAT_NET_LARGEST, heap.mLargest);
+        json.AddNumber(LYRAT_NET_MIN_LARGEST, heap.mMinLargest);
+        json.EndObject();
+
+        json.BeginArray(LYRAT_NET_ALLOCS);
+        for (int i = 0; i < ::Telemetry::SubsystemCount; i++) {
+            ::Telemetry::Subsystem_e subsystem = (::Telemetry::Subsystem_e)i;
+            ::Telemetry::Alloc_t alloc;
+            ::Telemetry::GetAlloc(subsystem, alloc);
+            json.BeginObject();
+            json.AddString(LYRAT_NET_NAME, ::Telemetry::GetName(subsystem));
+            json.AddNumber(LYRAT_NET_COUNT, alloc.mAllocs);
+            json.AddNumber(LYRAT_NET_FREES, alloc.mFrees);
+            json.AddNumber(LYRAT_NET_BYTES, alloc.mBytes);
+            json.EndObject();
+        }
+        json.EndArray();
+
+        // stack_free is the lowest high-water mark, -1 if the task did not run yet
+        json.BeginArray(LYRAT_NET_TASKS);
+        ::Telemetry::Task_t task;
+        int count = telemetry.GetTaskCount();
+        for (int i = 0; telemetry.GetTask(i, task); i++) {
+            JsonWriter::Mark_t mark = json.GetMark();
+            json.BeginObject();
+            json.AddString(LYRAT_NET_NAME, task.mpName);
+            json.AddNumber(LYRAT_NET_STACK, task.mStackSize);
+            json.AddNumber(LYRAT_NET_STACK_FREE, task.mMinFree);
+            json.EndObject();
+
+            if (json.Overflow()) {
+                ESP_LOGW(TAG, "[ DATA ] telemetry tasks truncated to %d of %d entries", i, count);
+                json.Rollback(mark);
+                break;
+            }
+        }
+        json.EndArray();
+
+        json.EndObject();
+        json.EndObject();
+        bSendResponse = true;
+    } break;
+
+    case DataWebRadio::Stats: {
+        // totals since boot, rates come from the difference of two requests
+        PipelineStats& stats = mWebRadio->GetPipelineStats();
+
+        json.BeginObject(LYRAT_NET_WEBRADIO);
+        json.BeginObject(LYRAT_NET_STATS);
+        json.AddNumber(LYRAT_NET_UPTIME, (int)(esp_timer_get_time() / 1000));
+        json.BeginArray(LYRAT_NET_STAGES);
+        for (int i = 0; i < PipelineStats::StageCount; i++) {
+            PipelineStats::Stage_e stage = (PipelineStats::Stage_e)i;
+            PipelineStats::Counters_t counters;
+            stats.Get(stage, counters);
+
+            JsonWriter::Mark_t mark = json.GetMark();
+            json.BeginObject();
+            json.AddString(LYRAT_NET_STAGE, PipelineStats::GetName(stage));
+            json.AddNumber(LYRAT_NET_KB_IN, counters.mKbIn);
+            json.AddNumber(LYRAT_NET_KB_OUT, counters.mKbOut);
+            json.AddNumber(LYRAT_NET_READ_WAIT, counters.mReadWaitMs);
+            json.AddNumber(LYRAT_NET_WRITE_WAIT, counters.mWriteWaitMs);
+            json.AddNumber(LYRAT_NET_PROCESS, counters.mProcessMs);
+            json.AddNumber(LYRAT_NET_CHUNKS, counters.mChunks);
+            json.AddNumber(LYRAT_NET_UNDERRUNS, counters.mUnderruns);
+            json.AddNumber(LYRAT_NET_FILL, mWebRadio->GetPipelineFill(stage));
+            json.EndObject();
+
+            if (json.Overflow()) {
+                ESP_LOGW(TAG, "[ DATA ] stats stages truncated to %d of %d entries", i, (int)PipelineStats::StageCount);
+                json.Rollback(mark);
+                break;
+            }
         }
+        json.EndArray();
+        json.EndObject();
+        json.EndObject();
         bSendResponse = true;
     } break;
 
@@ -239,34 +552,56 @@ bool DataWebRadio::CreateMessageResponse(MessageType_e msg, char* buffer, size_t
         break;
     };
 
-    if (bSendResponse) {
-        bSendResponse = cJSON_PrintPreallocated(root, buffer, size, 0);
+    json.EndObject();
+
+    if (bSendResponse && json.Overflow()) {
+        ESP_LOGE(TAG, "[ DATA ] response does not fit into %d bytes", (int)size);
+        bSendResponse = false;
     }
-    cJSON_Delete(root);
 
     return bSendResponse;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
+// tokenize the request once, HandleMessage works on the same tokens
 DataWebRadio::MessageType_e DataWebRadio::IsWebRadioRequest(char* pRequest)
 {
     MessageType_e reqType = NoWebRadioRequest;
 
-    cJSON* root = cJSON_Parse(pRequest);
-    if (root != NULL) {
-        cJSON* webradio = cJSON_GetObjectItem(root, LYRAT_NET_WEBRADIO);
-        if (webradio != NULL) {
-            if (cJSON_HasObjectItem(webradio, LYRAT_NET_FINDBOARD)) {
+    if (mRequest.Parse(pRequest, strlen(pRequest))) {
+        int webradio = mRequest.Find(0, LYRAT_NET_WEBRADIO);
+        if (webradio >= 0) {
+            if (mRequest.Has(webradio, LYRAT_NET_FINDBOARD)) {
                 reqType = FindBoard;
             }
-            else if (cJSON_HasObjectItem(webradio, LYRAT_NET_CONFIGURATION)) {
+            else if (mRequest.Has(webradio, LYRAT_NET_CONFIGURATION)) {
                 reqType = Configuration;
             }
-            else if (cJSON_HasObjectItem(webradio, LYRAT_NET_PLAYIDS)) {
+            else if (mRequest.Has(webradio, LYRAT_NET_PLAYIDS)) {
                 reqType = PlayIds;
             }
+            else if (mRequest.Has(webradio, LYRAT_NET_STATIONSTATS)) {
+                reqType = StationStats;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_NOWPLAYING)) {
+                reqType = NowPlaying;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_STATS)) {
+                reqType = Stats;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_TRACE)) {
+                reqType = Trace;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_TELEMETRY)) {
+                reqType = Telemetry;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_PLAYID)) {
+                reqType = PlayId;
+            }
+            else if (mRequest.Has(webradio, LYRAT_NET_REMOVEID)) {
+                reqType = RemoveId;
+            }
         }
-        cJSON_Delete(root);
     }
 
     return reqType;
@@ -15,6 +15,8 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 #include "NVSWebRadio.h"
+#include "JsonReader.h"
+#include "IcyReader.h"
 #include "string"
 
 class WebRadio;
@@ -27,6 +29,13 @@ public:
         FindBoard,
         Configuration,
         PlayIds,
+        StationStats,
+        NowPlaying,
+        Stats,
+        Trace,
+        Telemetry,
+        PlayId,
+        RemoveId,
     };
 
 public:
@@ -37,13 +46,32 @@ public:
     MessageType_e IsWebRadioRequest(char* pRequest);
     void HandleMessage(MessageType_e msg, char* buffer, size_t size);
     bool CreateMessageResponse(MessageType_e msg, char* buffer, size_t size);
-    void Debug(Settings_t& set);
+    bool GetSubscribe() { return mbSubscribe; } // of the last now_playing request
+
+    // stream title of the playing station, set from the http reader task
+    void SetNowPlayingStation(const char* pId); // clears the title
+    void SetNowPlaying(const char* pTitle);
+    uint32_t GetNowPlayingSequence(); // changes with every title
 
     // functions
 private:
+    bool ReadStation(int token, Station_t& station);
+    const char* CheckStations(int actTune, int stationList);
+
     // variable
 private:
     WebRadio* mWebRadio;
+    JsonReader mRequest; // tokens of the last request
+    bool mbSubscribe;
+    int mTraceFrom; // of the last trace request
+    StationId_t mIdRequest; // of the last play_id/remove_id request
+    int mIdIndex;           // preset index of mIdRequest, -1 act tune, -2 not found
+    const char* mpConfigError; // of the last configuration request, NULL if all was taken
+
+    portMUX_TYPE mNowPlayingMux;
+    uint32_t mNowPlayingSequence;
+    char mNowPlayingId[40];
+    char mNowPlayingTitle[LYRAT_ICY_TITLE_SIZE];
 };
 
 ////////////////////////////////////////////////////////////////////////////////
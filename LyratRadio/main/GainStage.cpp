@@ -0,0 +1,137 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "GainStage.h"
+
+#define GAIN_SHIFT 12 // Q15 -> Q27
+
+///////////////////////////////////////////////////////////////////////////////
+GainStage::GainStage()
+    : mVolume(0)
+    , mbMuted(false)
+    , mRequest(0)
+    , mSampleRate(44100)
+    , mChannels(2)
+    , mbBypass(false)
+    , mbSilent(true)
+    , mApplied(0)
+    , mGain(0)
+    , mStep(0)
+    , mTarget(0)
+    , mRampFrames(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void GainStage::SetFormat(int sampleRate, int channels, int bits)
+{
+    mSampleRate.store(sampleRate > 0 ? sampleRate : 44100, std::memory_order_relaxed);
+    mChannels.store(std::max(channels, 1), std::memory_order_relaxed);
+    mbBypass.store(bits != 16, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void GainStage::SetVolume(int volume, int rampMs)
+{
+    mVolume = std::min(100, std::max(0, volume));
+    Post(rampMs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void GainStage::Mute(bool bMute, int rampMs)
+{
+    mbMuted = bMute;
+    if (bMute) {
+        mbSilent.store(false, std::memory_order_relaxed); // until the ramp reached 0
+    }
+    Post(rampMs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void GainStage::Post(int rampMs)
+{
+    uint32_t target = mbMuted ? 0 : VolumeToGain(mVolume);
+    uint32_t ramp = std::min(std::max(rampMs, 0), 0xffff);
+    mRequest.store(target | (ramp << 16), std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// equal steps in dB, volume 0 is silence
+int32_t GainStage::VolumeToGain(int volume)
+{
+    if (volume <= 0) {
+        return 0;
+    }
+    if (volume >= 100) {
+        return LYRAT_GAIN_UNITY;
+    }
+    float db = -(float)LYRAT_GAIN_RANGE_DB * (100 - volume) / 100.0f;
+    return (int32_t)(LYRAT_GAIN_UNITY * powf(10.0f, db / 20.0f) + 0.5f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// per frame during a ramp, afterwards one multiply and shift per sample
+// (unity and silence are special cased)
+void GainStage::Process(int16_t* pSamples, size_t frames)
+{
+    uint32_t request = mRequest.load(std::memory_order_acquire);
+    if (request != mApplied) {
+        mApplied = request;
+        mTarget = request & 0xffff;
+        int32_t rampFrames = (int32_t)((int64_t)(request >> 16) * mSampleRate.load(std::memory_order_relaxed) / 1000);
+        if (rampFrames <= 0) {
+            mGain = mTarget << GAIN_SHIFT;
+            mRampFrames = 0;
+        }
+        else {
+            mStep = ((mTarget << GAIN_SHIFT) - mGain) / rampFrames;
+            mRampFrames = rampFrames;
+        }
+    }
+
+    if (mbBypass.load(std::memory_order_relaxed)) {
+        mGain = mTarget << GAIN_SHIFT;
+        mRampFrames = 0;
+        mbSilent.store(mTarget == 0, std::memory_order_relaxed);
+        return;
+    }
+
+    int channels = mChannels.load(std::memory_order_relaxed);
+    while (frames > 0 && mRampFrames > 0) {
+        mGain = (--mRampFrames == 0) ? (mTarget << GAIN_SHIFT) : mGain + mStep;
+        int32_t gain = mGain >> GAIN_SHIFT;
+        for (int c = 0; c < channels; c++, pSamples++) {
+            *pSamples = (int16_t)((*pSamples * gain) >> 15);
+        }
+        frames--;
+    }
+
+    int32_t gain = mGain >> GAIN_SHIFT;
+    mbSilent.store(gain == 0 && mRampFrames == 0, std::memory_order_relaxed);
+    if (frames == 0 || gain == LYRAT_GAIN_UNITY) {
+        return;
+    }
+
+    size_t count = frames * channels;
+    if (gain == 0) {
+        memset(pSamples, 0, count * sizeof(int16_t));
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        pSamples[i] = (int16_t)((pSamples[i] * gain) >> 15);
+    }
+}
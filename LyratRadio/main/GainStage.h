@@ -0,0 +1,73 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _GAINSTAGE_H_
+#define _GAINSTAGE_H_
+
+// Software volume of 16 bit pcm in Q15 fixed point. Gain changes are ramped
+// per frame, so volume steps and the fades around a station switch don't
+// click. Control calls come from the audio event loop, Process() runs in the
+// gain element task; the target is handed over in one atomic word.
+// No ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define LYRAT_GAIN_UNITY 32768 // Q15
+#define LYRAT_GAIN_RANGE_DB 50 // volume 1 is -50 dB, 100 is 0 dB
+
+//////////////////////////////////////////////////////////////////////
+class GainStage {
+public:
+    GainStage();
+
+    // control side
+    void SetFormat(int sampleRate, int channels, int bits); // from music info
+    void SetVolume(int volume, int rampMs); // 0..100
+    int GetVolume() const { return mVolume; }
+    void Mute(bool bMute, int rampMs); // fade out/in, the volume is kept
+    bool IsSilent() const { return mbSilent.load(std::memory_order_relaxed); }
+
+    // processing side, interleaved samples, only whole frames
+    void Process(int16_t* pSamples, size_t frames);
+    int GetFrameSize() const { return mChannels.load(std::memory_order_relaxed) * 2; }
+
+    static int32_t VolumeToGain(int volume); // perceptual curve, Q15
+
+private:
+    void Post(int rampMs);
+
+private:
+    // control side
+    int mVolume;
+    bool mbMuted;
+
+    // handover: target gain (bits 0..15, unity 0x8000) and ramp in ms (bits 16..31)
+    std::atomic<uint32_t> mRequest;
+    std::atomic<int> mSampleRate;
+    std::atomic<int> mChannels;
+    std::atomic<bool> mbBypass; // not 16 bit
+    std::atomic<bool> mbSilent;
+
+    // processing side
+    uint32_t mApplied;   // last request taken over
+    int32_t mGain;       // Q27, gain << 12 for fine ramp steps
+    int32_t mStep;       // per frame
+    int32_t mTarget;     // Q15
+    int32_t mRampFrames; // left
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,159 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <string.h>
+#include <algorithm>
+
+#include "IcyReader.h"
+
+///////////////////////////////////////////////////////////////////////////////
+IcyReader::IcyReader()
+    : mMetaInt(0)
+    , mAudioLeft(0)
+    , mMetaLeft(-1)
+    , mMetaLength(0)
+    , mbConfirmed(false)
+    , mPendingLength(0)
+    , mbTitleChanged(false)
+{
+    mTitle[0] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void IcyReader::SetMetaInt(int metaInt)
+{
+    mMetaInt = std::max(metaInt, 0);
+    mTitle[0] = 0;
+    mbTitleChanged = false;
+    Restart();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void IcyReader::Restart()
+{
+    mAudioLeft = mMetaInt;
+    mMetaLeft = -1;
+    mMetaLength = 0;
+    mbConfirmed = false; // the new response may come from another server
+    mPendingLength = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a call returns audio bytes of one interval only; a block is consumed before the
+// next interval, a read error inside a block is continued with the next call
+int IcyReader::Read(char* pBuffer, int length, Read_t read, void* pContext)
+{
+    if (mPendingLength > 0) {
+        int len = std::min(length, mPendingLength);
+        memcpy(pBuffer, mPending, len);
+        mPendingLength -= len;
+        memmove(mPending, mPending + len, mPendingLength);
+        return len;
+    }
+    if (mMetaInt <= 0) {
+        return read(pContext, pBuffer, length);
+    }
+
+    while (mAudioLeft == 0) {
+        if (mMetaLeft < 0) {
+            uint8_t blocks;
+            int len = read(pContext, (char*)&blocks, 1);
+            if (len <= 0) {
+                return len;
+            }
+            mMetaLeft = blocks * 16;
+            mMetaLength = 0;
+            mPending[0] = (char)blocks;
+        }
+
+        while (mMetaLeft > 0) {
+            // the beginning is kept for parsing, the rest is dropped into the audio buffer
+            // which is overwritten afterwards; unconfirmed, only the check is read first
+            char* pDest = pBuffer;
+            int size = std::min(mMetaLeft, length);
+            if (mMetaLength < LYRAT_ICY_META_SIZE) {
+                pDest = mMeta + mMetaLength;
+                size = std::min(mMetaLeft, (mbConfirmed ? LYRAT_ICY_META_SIZE : LYRAT_ICY_CHECK_SIZE) - mMetaLength);
+            }
+            int len = read(pContext, pDest, size);
+            if (len <= 0) {
+                return len;
+            }
+            if (pDest != pBuffer) {
+                mMetaLength += len;
+            }
+            mMetaLeft -= len;
+
+            if (!mbConfirmed && mMetaLength == LYRAT_ICY_CHECK_SIZE) {
+                if (memcmp(mMeta, "Stream", LYRAT_ICY_CHECK_SIZE) != 0) {
+                    // audio data, no metadata: return what was read and pass everything through
+                    memcpy(mPending + 1, mMeta, LYRAT_ICY_CHECK_SIZE);
+                    mPendingLength = 1 + LYRAT_ICY_CHECK_SIZE;
+                    mMetaInt = 0;
+                    mMetaLeft = -1;
+                    mMetaLength = 0;
+                    return Read(pBuffer, length, read, pContext);
+                }
+                mbConfirmed = true;
+            }
+        }
+
+        char title[LYRAT_ICY_TITLE_SIZE];
+        if (mMetaLength > 0 && ParseTitle(mMeta, mMetaLength, title, sizeof(title)) && strcmp(title, mTitle) != 0) {
+            strcpy(mTitle, title);
+            mbTitleChanged = true;
+        }
+        mMetaLeft = -1;
+        mAudioLeft = mMetaInt;
+    }
+
+    int len = read(pContext, pBuffer, std::min(length, mAudioLeft));
+    if (len > 0) {
+        mAudioLeft -= len;
+    }
+    return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* IcyReader::TakeTitle()
+{
+    mbTitleChanged = false;
+    return mTitle;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the title may contain quotes, it ends with "';" or the end of the block
+bool IcyReader::ParseTitle(const char* pMeta, size_t length, char* pTitle, size_t size)
+{
+    static const char key[] = "StreamTitle='";
+    const size_t keyLength = sizeof(key) - 1;
+
+    length = strnlen(pMeta, length); // block is padded with zeros
+    const char* pEnd = pMeta + length;
+    const char* pStart = std::search(pMeta, pEnd, key, key + keyLength);
+    if (pStart == pEnd) {
+        return false;
+    }
+    pStart += keyLength;
+
+    static const char end[] = "';";
+    const char* pStop = std::search(pStart, pEnd, end, end + 2);
+    if (pStop == pEnd && pStop > pStart && pStop[-1] == '\'') {
+        pStop--; // last field without ';'
+    }
+
+    size_t titleLength = std::min((size_t)(pStop - pStart), size - 1);
+    memcpy(pTitle, pStart, titleLength);
+    pTitle[titleLength] = 0;
+    return true;
+}
@@ -0,0 +1,71 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _ICYREADER_H_
+#define _ICYREADER_H_
+
+// Shoutcast/Icecast metadata: with 'Icy-MetaData: 1' the server inserts a
+// metadata block after every icy-metaint audio bytes (one length byte, then
+// length * 16 bytes). Read() never reads across a block boundary, so audio
+// bytes go directly into the caller's buffer and the decoder never sees
+// metadata. The interval comes from another connection (resolver), so the
+// first non-empty block of each request has to start with 'Stream'; if it
+// does not, the server did not insert metadata, the checked bytes are handed
+// out as audio and stripping is off until the next SetMetaInt().
+// No ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LYRAT_ICY_META_SIZE 256  // parsed beginning of a metadata block, StreamTitle comes first
+#define LYRAT_ICY_TITLE_SIZE 128 // longer titles are cut
+#define LYRAT_ICY_CHECK_SIZE 6   // "Stream", beginning of StreamTitle and StreamUrl
+
+//////////////////////////////////////////////////////////////////////
+class IcyReader {
+public:
+    // reads up to length bytes from the stream, returns the count, <= 0 on error or end
+    typedef int (*Read_t)(void* pContext, char* pBuffer, int length);
+
+    IcyReader();
+
+    void SetMetaInt(int metaInt); // 0: no metadata requested
+    int GetMetaInt() const { return mMetaInt; } // 0 after the stream did not confirm it
+    bool IsConfirmed() const { return mbConfirmed; } // a block of this request was metadata
+    void Restart(); // new request, the stream starts with audio data
+
+    // reads audio bytes into pBuffer, metadata blocks in between are consumed
+    int Read(char* pBuffer, int length, Read_t read, void* pContext);
+
+    bool IsTitleChanged() const { return mbTitleChanged; }
+    const char* TakeTitle(); // clears the changed flag
+
+    // "StreamTitle='...';" to pTitle, false if there is none
+    static bool ParseTitle(const char* pMeta, size_t length, char* pTitle, size_t size);
+
+private:
+    int mMetaInt;
+    int mAudioLeft; // until the next metadata block
+    int mMetaLeft;  // bytes of the current block, -1 if the length byte is next
+    int mMetaLength;
+    bool mbConfirmed;
+    int mPendingLength; // audio bytes taken for a check, returned by the next Read()
+    char mPending[1 + LYRAT_ICY_CHECK_SIZE];
+    bool mbTitleChanged;
+    char mMeta[LYRAT_ICY_META_SIZE + 1];
+    char mTitle[LYRAT_ICY_TITLE_SIZE];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,122 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <string.h>
+
+#include "JitterBuffer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+JitterBuffer::JitterBuffer()
+    : mUseCounter(0)
+    , mStation(NULL)
+    , mState(Idle)
+    , mCapacity(0)
+    , mCushion(0)
+    , mStateTime(0)
+    , mStableTime(0)
+    , mDeepenTime(0)
+{
+    memset(mStations, 0, sizeof(mStations));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// returns the entry of uuid, replaces the least recently used one if unknown
+JitterBuffer::Station_t* JitterBuffer::FindStation(const StationUuid_t& uuid)
+{
+    Station_t* oldest = &mStations[0];
+    for (int i = 0; i < LYRAT_JITTER_STATIONS; i++) {
+        if (mStations[i].mLastUse != 0 && mStations[i].mUuid == uuid) {
+            return &mStations[i];
+        }
+        if (mStations[i].mLastUse < oldest->mLastUse) {
+            oldest = &mStations[i];
+        }
+    }
+
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->mUuid = uuid;
+    oldest->mWatermark = LYRAT_JITTER_START_WATERMARK;
+    return oldest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JitterBuffer::Action_e JitterBuffer::Start(const StationUuid_t& uuid, size_t capacity, int64_t now)
+{
+    mStation = FindStation(uuid);
+    mStation->mLastUse = ++mUseCounter;
+    mCapacity = capacity;
+    if (mStation->mWatermark > MaxWatermark()) {
+        mStation->mWatermark = MaxWatermark();
+    }
+
+    mCushion = mStation->mWatermark;
+    mState = Prebuffer;
+    mStateTime = now;
+    return Pause;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JitterBuffer::Action_e JitterBuffer::Sample(size_t filled, int64_t now)
+{
+    switch (mState) {
+    case Prebuffer:
+    case Rebuffer: {
+        bool bTimeout = filled > 0 && now - mStateTime > LYRAT_JITTER_MAX_PREROLL_US;
+        uint32_t level = (mState == Rebuffer) ? mCushion : mStation->mWatermark;
+        if (filled < level && !bTimeout) {
+            return None;
+        }
+        if (mState == Rebuffer) {
+            mStation->mLastStallMs = (uint32_t)((now - mStateTime) / 1000);
+            if (mStation->mLastStallMs > mStation->mMaxStallMs) {
+                mStation->mMaxStallMs = mStation->mLastStallMs;
+            }
+        }
+        mState = Playing;
+        mStableTime = now;
+        mDeepenTime = now;
+        return Resume;
+    }
+
+    case Playing:
+        if (filled == 0) {
+            // underrun, the station needs a deeper cushion
+            uint32_t watermark = mStation->mWatermark + mStation->mWatermark * LYRAT_JITTER_GROW_PERCENT / 100;
+            mStation->mWatermark = (watermark < MaxWatermark()) ? watermark : MaxWatermark();
+            mStation->mUnderruns++;
+            if (mCushion < mStation->mWatermark) {
+                mCushion = mStation->mWatermark;
+            }
+
+            mState = Rebuffer;
+            mStateTime = now;
+            return Pause;
+        }
+        if (now - mStableTime > LYRAT_JITTER_STABLE_US) {
+            // stable, next start of this station can be faster
+            if (mStation->mWatermark >= LYRAT_JITTER_MIN_WATERMARK + LYRAT_JITTER_SHRINK_STEP) {
+                mStation->mWatermark -= LYRAT_JITTER_SHRINK_STEP;
+            }
+            mStableTime = now;
+        }
+        if (now - mDeepenTime > LYRAT_JITTER_DEEPEN_US) {
+            // settled, a stall from now on refills a deeper cushion
+            mCushion = (mCushion + LYRAT_JITTER_DEEPEN_STEP < MaxWatermark()) ? mCushion + LYRAT_JITTER_DEEPEN_STEP : MaxWatermark();
+            mDeepenTime = now;
+        }
+        return None;
+
+    default:
+        return None;
+    }
+}
@@ -0,0 +1,95 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _JITTERBUFFER_H_
+#define _JITTERBUFFER_H_
+
+// Adaptive pre-roll of the http -> decoder ring buffer. The decoder is held
+// until the ring buffer reaches the watermark of the station; the watermark
+// grows on underruns and shrinks while playback is stable.
+// Playback starts at the watermark, the cushion a rebuffer waits for deepens
+// while the station plays without underrun.
+// No ESP-IDF dependencies, times are in us.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "NVSCodec.h"
+
+#define LYRAT_JITTER_STATIONS 16                   // stations with a learned watermark
+#define LYRAT_JITTER_MIN_WATERMARK (4 * 1024)      // fast start for stable stations
+#define LYRAT_JITTER_START_WATERMARK (6 * 1024)    // unknown station
+#define LYRAT_JITTER_GROW_PERCENT 50               // per underrun
+#define LYRAT_JITTER_SHRINK_STEP 1024              // per stable period
+#define LYRAT_JITTER_STABLE_US (60 * 1000000LL)    // period without underrun
+#define LYRAT_JITTER_MAX_PREROLL_US (8 * 1000000LL) // start anyway if data is there
+#define LYRAT_JITTER_DEEPEN_STEP (4 * 1024)        // cushion per settled period
+#define LYRAT_JITTER_DEEPEN_US (10 * 1000000LL)    // playback without underrun
+
+//////////////////////////////////////////////////////////////////////
+class JitterBuffer {
+public:
+    enum Action_e {
+        None,
+        Pause,  // hold the decoder
+        Resume, // release the decoder
+    };
+
+    typedef struct {
+        StationUuid_t mUuid;
+        uint32_t mWatermark;
+        uint32_t mUnderruns;
+        uint32_t mLastStallMs;
+        uint32_t mMaxStallMs;
+        uint32_t mLastUse;
+    } Station_t;
+
+public:
+    JitterBuffer();
+
+    // new station, capacity of the ring buffer; returns Pause
+    Action_e Start(const StationUuid_t& uuid, size_t capacity, int64_t now);
+    // called periodically with the filled bytes of the ring buffer
+    Action_e Sample(size_t filled, int64_t now);
+
+    bool IsPlaying() const { return mState == Playing; }
+    const Station_t* GetStation() const { return mStation; }
+    // fill level a rebuffer waits for
+    uint32_t GetCushion() const { return mCushion; }
+
+private:
+    enum State_e {
+        Idle,
+        Prebuffer,
+        Playing,
+        Rebuffer,
+    };
+
+    Station_t* FindStation(const StationUuid_t& uuid);
+    uint32_t MaxWatermark() const { return (uint32_t)(mCapacity * 3 / 4); }
+
+private:
+    Station_t mStations[LYRAT_JITTER_STATIONS];
+    uint32_t mUseCounter;
+    Station_t* mStation;
+    State_e mState;
+    size_t mCapacity;
+    uint32_t mCushion;
+    int64_t mStateTime;  // start of pre-roll/rebuffer
+    int64_t mStableTime; // start of the current stable period
+    int64_t mDeepenTime; // start of the current settled period
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
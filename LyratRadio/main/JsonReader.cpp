@@ -0,0 +1,309 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "JsonReader.h"
+
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::JsonReader()
+    : mBuffer(NULL)
+    , mCount(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::Parse(char* buffer, size_t length)
+{
+    int stack[LYRAT_JSON_MAX_DEPTH];
+    int depth = 0;
+    int token;
+
+    mBuffer = buffer;
+    mCount = 0;
+
+    if (length > 0xffff) {
+        return false;
+    }
+
+    for (size_t pos = 0; pos < length && buffer[pos] != 0; pos++) {
+        char ch = buffer[pos];
+
+        switch (ch) {
+        case '{':
+        case '[':
+            if (depth == LYRAT_JSON_MAX_DEPTH || (depth == 0 && mCount > 0)) {
+                mCount = 0;
+                return false;
+            }
+            token = AddToken(ch == '{' ? Object : Array, pos);
+            if (token < 0) {
+                return false;
+            }
+            stack[depth++] = token;
+            break;
+
+        case '}':
+        case ']':
+            if (depth == 0 || mTokens[stack[depth - 1]].mType != (ch == '}' ? Object : Array)) {
+                mCount = 0;
+                return false;
+            }
+            token = stack[--depth];
+            mTokens[token].mEnd = pos + 1;
+            mTokens[token].mNext = mCount;
+            break;
+
+        case '"': {
+            size_t start = pos + 1;
+            for (pos = start; pos < length && buffer[pos] != '"' && buffer[pos] != 0; pos++) {
+                if (buffer[pos] == '\\' && pos + 1 < length) {
+                    pos++;
+                }
+            }
+            if (pos >= length || buffer[pos] != '"' || depth == 0) {
+                mCount = 0;
+                return false;
+            }
+            token = AddToken(String, start);
+            if (token < 0) {
+                return false;
+            }
+            mTokens[token].mEnd = pos;
+        } break;
+
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case ':':
+        case ',':
+            break;
+
+        default: {
+            size_t start = pos;
+            while (pos < length && buffer[pos] != 0 && strchr(" \t\r\n,:]}", buffer[pos]) == NULL) {
+                pos++;
+            }
+            if (depth == 0) {
+                mCount = 0;
+                return false;
+            }
+            token = AddToken(Primitive, start);
+            if (token < 0) {
+                return false;
+            }
+            mTokens[token].mEnd = pos;
+            pos--;
+        } break;
+        }
+    }
+
+    if (depth != 0 || mCount == 0) {
+        mCount = 0;
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::AddToken(TokenType_e type, size_t start)
+{
+    if (mCount == LYRAT_JSON_MAX_TOKENS) {
+        mCount = 0;
+        return -1;
+    }
+
+    Token_t& token = mTokens[mCount];
+    token.mStart = start;
+    token.mEnd = start;
+    token.mNext = mCount + 1;
+    token.mType = type;
+    token.mDecoded = 0;
+
+    return mCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::Find(int object, const char* key)
+{
+    if (object < 0 || object >= mCount || mTokens[object].mType != Object) {
+        return -1;
+    }
+
+    int i = object + 1;
+    while (i + 1 < mTokens[object].mNext) {
+        int value = i + 1;
+        if (mTokens[i].mType == String && KeyEquals(i, key)) {
+            return value;
+        }
+        i = mTokens[value].mNext;
+    }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::ArraySize(int array)
+{
+    if (array < 0 || array >= mCount || mTokens[array].mType != Array) {
+        return 0;
+    }
+
+    int size = 0;
+    for (int i = array + 1; i < mTokens[array].mNext; i = mTokens[i].mNext) {
+        size++;
+    }
+    return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::ArrayItem(int array, int item)
+{
+    if (array < 0 || array >= mCount || mTokens[array].mType != Array) {
+        return -1;
+    }
+
+    for (int i = array + 1; i < mTokens[array].mNext; i = mTokens[i].mNext) {
+        if (item-- == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// four hex digits of a \u escape, fewer if the string ends
+static unsigned int ParseHex4(const char*& pSrc, const char* pEnd)
+{
+    unsigned int code = 0;
+    for (int i = 0; i < 4 && pSrc < pEnd; i++) {
+        char hex = *pSrc++;
+        code <<= 4;
+        code |= (hex >= '0' && hex <= '9') ? hex - '0' : ((hex | 0x20) - 'a' + 10) & 0x0f;
+    }
+    return code;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unescape in place, the result is never longer than the escaped string
+const char* JsonReader::GetString(int token)
+{
+    if (token < 0 || token >= mCount || mTokens[token].mType != String) {
+        return "";
+    }
+
+    Token_t& tok = mTokens[token];
+    if (!tok.mDecoded) {
+        const char* pSrc = mBuffer + tok.mStart;
+        const char* pEnd = mBuffer + tok.mEnd;
+        char* pDst = mBuffer + tok.mStart;
+
+        while (pSrc < pEnd) {
+            char ch = *pSrc++;
+            if (ch != '\\' || pSrc == pEnd) {
+                *pDst++ = ch;
+                continue;
+            }
+            ch = *pSrc++;
+            switch (ch) {
+            case 'b':
+                *pDst++ = '\b';
+                break;
+            case 'f':
+                *pDst++ = '\f';
+                break;
+            case 'n':
+                *pDst++ = '\n';
+                break;
+            case 'r':
+                *pDst++ = '\r';
+                break;
+            case 't':
+                *pDst++ = '\t';
+                break;
+            case 'u': {
+                unsigned int code = ParseHex4(pSrc, pEnd);
+                // a high surrogate followed by an escaped low surrogate is one code point
+                if (code >= 0xd800 && code <= 0xdbff && pEnd - pSrc >= 6 && pSrc[0] == '\\' && pSrc[1] == 'u') {
+                    const char* pLow = pSrc + 2;
+                    unsigned int low = ParseHex4(pLow, pEnd);
+                    if (low >= 0xdc00 && low <= 0xdfff) {
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        pSrc = pLow;
+                    }
+                }
+                if (code >= 0xd800 && code <= 0xdfff) {
+                    code = 0xfffd; // lone surrogate, replacement character
+                }
+                // utf-8, never longer than the escape: 6 characters for 3 bytes, 12 for 4
+                if (code < 0x80) {
+                    *pDst++ = code;
+                }
+                else if (code < 0x800) {
+                    *pDst++ = 0xc0 | (code >> 6);
+                    *pDst++ = 0x80 | (code & 0x3f);
+                }
+                else if (code < 0x10000) {
+                    *pDst++ = 0xe0 | (code >> 12);
+                    *pDst++ = 0x80 | ((code >> 6) & 0x3f);
+                    *pDst++ = 0x80 | (code & 0x3f);
+                }
+                else {
+                    *pDst++ = 0xf0 | (code >> 18);
+                    *pDst++ = 0x80 | ((code >> 12) & 0x3f);
+                    *pDst++ = 0x80 | ((code >> 6) & 0x3f);
+                    *pDst++ = 0x80 | (code & 0x3f);
+                }
+            } break;
+            default: // '"', '\\', '/'
+                *pDst++ = ch;
+                break;
+            }
+        }
+        *pDst = 0; // overwrites the closing quote at the latest
+        tok.mDecoded = 1;
+    }
+    return mBuffer + tok.mStart;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::GetInt(int token, int defValue)
+{
+    if (token < 0 || token >= mCount || mTokens[token].mType != Primitive) {
+        return defValue;
+    }
+
+    const char* pValue = mBuffer + mTokens[token].mStart;
+    switch (*pValue) {
+    case 't':
+        return 1;
+    case 'f':
+    case 'n':
+        return 0;
+    default:
+        return strtol(pValue, NULL, 10);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::KeyEquals(int token, const char* key)
+{
+    const Token_t& tok = mTokens[token];
+
+    if (tok.mDecoded) {
+        return strcmp(mBuffer + tok.mStart, key) == 0;
+    }
+
+    size_t length = tok.mEnd - tok.mStart;
+    return strlen(key) == length && memcmp(mBuffer + tok.mStart, key, length) == 0;
+}
@@ -0,0 +1,71 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _JSONREADER_H_
+#define _JSONREADER_H_
+
+// Single pass JSON tokenizer over the receive buffer. No heap is used, tokens
+// reference the buffer, strings are unescaped in place on first access.
+// This file has no ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LYRAT_JSON_MAX_TOKENS 256
+#define LYRAT_JSON_MAX_DEPTH 16
+
+//////////////////////////////////////////////////////////////////////
+class JsonReader {
+public:
+    enum TokenType_e {
+        Object,
+        Array,
+        String,
+        Primitive, // number, true, false, null
+    };
+
+public:
+    JsonReader();
+
+    bool Parse(char* buffer, size_t length); // buffer is modified by String()
+    bool IsParsed(const char* buffer) { return mCount > 0 && buffer == mBuffer; }
+    void Reset() { mCount = 0; }
+
+    // token access, token 0 is the root, -1 is 'not found' and accepted everywhere
+    int Find(int object, const char* key); // returns value token
+    bool Has(int object, const char* key) { return Find(object, key) >= 0; }
+    int ArraySize(int array);
+    int ArrayItem(int array, int i);
+    const char* GetString(int token); // "" if token is no string
+    int GetInt(int token, int defValue);
+
+private:
+    typedef struct {
+        uint16_t mStart;
+        uint16_t mEnd;
+        uint16_t mNext; // index of the next sibling
+        uint8_t mType;
+        uint8_t mDecoded; // string already unescaped and terminated
+    } Token_t;
+
+    int AddToken(TokenType_e type, size_t start);
+    bool KeyEquals(int token, const char* key);
+
+private:
+    char* mBuffer;
+    int mCount;
+    Token_t mTokens[LYRAT_JSON_MAX_TOKENS];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
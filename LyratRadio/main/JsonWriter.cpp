@@ -0,0 +1,194 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "JsonWriter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+JsonWriter::JsonWriter(char* buffer, size_t size)
+    : mBuffer(buffer)
+    , mSize(size)
+    , mPos(0)
+    , mDepth(0)
+    , mFirst(1)
+    , mbOverflow(size == 0)
+{
+    if (size > 0) {
+        mBuffer[0] = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::BeginObject(const char* key)
+{
+    BeginValue(key);
+    Open('{');
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::EndObject()
+{
+    Close('}');
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::BeginArray(const char* key)
+{
+    BeginValue(key);
+    Open('[');
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::EndArray()
+{
+    Close(']');
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::AddString(const char* key, const char* value)
+{
+    BeginValue(key);
+    Put("\"", 1);
+    PutEscaped(value);
+    Put("\"", 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::AddNumber(const char* key, int value)
+{
+    char number[16];
+    BeginValue(key);
+    Put(number, snprintf(number, sizeof(number), "%d", value));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JsonWriter::Mark_t JsonWriter::GetMark()
+{
+    Mark_t mark = { mPos, mDepth, mFirst };
+    return mark;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::Rollback(const Mark_t& mark)
+{
+    mPos = mark.mPos;
+    mDepth = mark.mDepth;
+    mFirst = mark.mFirst;
+    mbOverflow = false;
+    mBuffer[mPos] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::BeginValue(const char* key)
+{
+    if (mFirst & (1 << mDepth)) {
+        mFirst &= ~(1 << mDepth);
+    }
+    else {
+        Put(",", 1);
+    }
+
+    if (key != NULL) {
+        Put("\"", 1);
+        PutEscaped(key);
+        Put("\":", 2);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// keep space for the closing brackets of all open containers and the terminating zero
+void JsonWriter::Put(const char* str, size_t length)
+{
+    if (mbOverflow || mPos + length + mDepth + 1 > mSize) {
+        mbOverflow = true;
+        return;
+    }
+    memcpy(mBuffer + mPos, str, length);
+    mPos += length;
+    mBuffer[mPos] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::PutEscaped(const char* str)
+{
+    const char* pStart = str;
+
+    for (; *str != 0; str++) {
+        unsigned char ch = *str;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+
+        Put(pStart, str - pStart);
+        pStart = str + 1;
+
+        char escaped[8];
+        switch (ch) {
+        case '"':
+            Put("\\\"", 2);
+            break;
+        case '\\':
+            Put("\\\\", 2);
+            break;
+        case '\n':
+            Put("\\n", 2);
+            break;
+        case '\r':
+            Put("\\r", 2);
+            break;
+        case '\t':
+            Put("\\t", 2);
+            break;
+        default:
+            Put(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", ch));
+            break;
+        }
+    }
+    Put(pStart, str - pStart);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the new container is counted before the bracket is put, so its closing bracket
+// is reserved together with the opening one
+void JsonWriter::Open(char ch)
+{
+    if (mDepth + 1 >= LYRAT_JSON_WRITER_MAX_DEPTH) {
+        mbOverflow = true;
+        return;
+    }
+    mDepth++;
+    mFirst |= 1 << mDepth;
+    Put(&ch, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// closing brackets always fit, the space is reserved in Put
+void JsonWriter::Close(char ch)
+{
+    if (mDepth == 0) {
+        mbOverflow = true;
+        return;
+    }
+    mFirst &= ~(1 << mDepth);
+    mDepth--;
+    if (mbOverflow) {
+        return; // the opening bracket may be missing, the output is rolled back anyway
+    }
+    if (mPos + 1 >= mSize) {
+        mbOverflow = true;
+        return;
+    }
+    mBuffer[mPos++] = ch;
+    mBuffer[mPos] = 0;
+}
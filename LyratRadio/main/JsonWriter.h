@@ -0,0 +1,68 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _JSONWRITER_H_
+#define _JSONWRITER_H_
+
+// JSON serializer that writes straight into the caller's buffer. No heap is used.
+// Space for closing all open containers is always reserved, so after an overflow
+// the output can be rolled back to a mark and still be closed to valid JSON.
+// This file has no ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LYRAT_JSON_WRITER_MAX_DEPTH 32
+
+//////////////////////////////////////////////////////////////////////
+class JsonWriter {
+public:
+    typedef struct {
+        size_t mPos;
+        int mDepth;
+        uint32_t mFirst;
+    } Mark_t;
+
+public:
+    JsonWriter(char* buffer, size_t size);
+
+    void BeginObject(const char* key = NULL);
+    void EndObject();
+    void BeginArray(const char* key = NULL);
+    void EndArray();
+    void AddString(const char* key, const char* value);
+    void AddNumber(const char* key, int value);
+
+    Mark_t GetMark();
+    void Rollback(const Mark_t& mark); // also clears the overflow
+    bool Overflow() { return mbOverflow; }
+    size_t Length() { return mPos; }
+
+private:
+    void BeginValue(const char* key);
+    void Put(const char* str, size_t length);
+    void PutEscaped(const char* str);
+    void Open(char ch);
+    void Close(char ch);
+
+private:
+    char* mBuffer;
+    size_t mSize;
+    size_t mPos;
+    int mDepth;
+    uint32_t mFirst; // bit per depth, no element written yet
+    bool mbOverflow;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
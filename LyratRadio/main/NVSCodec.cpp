@@ -0,0 +1,496 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#include <algorithm>
+
+#include "NVSCodec.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Station list blob
+///////////////////////////////////////////////////////////////////////////////
+uint32_t Crc32(const uint8_t* pData, size_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+    };
+
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ pData[i]) & 0x0f] ^ (crc >> 4);
+        crc = table[(crc ^ (pData[i] >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <size_t N>
+static bool SerializeString(uint8_t*& pPos, const uint8_t* pEnd, const FixedString<N>& str)
+{
+    size_t length = str.length();
+    if (length > 0xffff || pPos + 2 + length > pEnd) {
+        return false;
+    }
+    *pPos++ = length & 0xff;
+    *pPos++ = length >> 8;
+    memcpy(pPos, str.data(), length);
+    pPos += length;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template <size_t N>
+static bool ParseString(const uint8_t*& pPos, const uint8_t* pEnd, FixedString<N>& str)
+{
+    if (pPos + 2 > pEnd) {
+        return false;
+    }
+    size_t length = pPos[0] | (pPos[1] << 8);
+    pPos += 2;
+    if (pPos + length > pEnd) {
+        return false;
+    }
+    str.Assign((const char*)pPos, length);
+    pPos += length;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool SerializeStation(uint8_t*& pPos, const uint8_t* pEnd, const Station_t& st)
+{
+    return SerializeString(pPos, pEnd, st.mId) && SerializeString(pPos, pEnd, st.mUrl) && SerializeString(pPos, pEnd, st.mDecoder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool ParseStation(const uint8_t*& pPos, const uint8_t* pEnd, Station_t& st)
+{
+    return ParseString(pPos, pEnd, st.mId) && ParseString(pPos, pEnd, st.mUrl) && ParseString(pPos, pEnd, st.mDecoder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t StationBlobSize(const Station_t& station)
+{
+    return 3 * 2 + station.mId.length() + station.mUrl.length() + station.mDecoder.length();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t SerializeStations(uint8_t* pBuffer, size_t size, const Station_t& actTune, const StationList& stations, int& count)
+{
+    uint8_t* pPos = pBuffer + LYRAT_NVS_STATIONS_HEADER;
+    const uint8_t* pEnd = pBuffer + size;
+
+    count = 0;
+    if (size < LYRAT_NVS_STATIONS_HEADER || !SerializeStation(pPos, pEnd, actTune)) {
+        return 0;
+    }
+
+    while (count < stations.size() && count < 0xff) {
+        uint8_t* pStation = pPos;
+        if (!SerializeStation(pPos, pEnd, stations[count])) {
+            pPos = pStation;
+            break;
+        }
+        count++;
+    }
+
+    size_t payload = pPos - (pBuffer + LYRAT_NVS_STATIONS_HEADER);
+    uint32_t crc = Crc32(pBuffer + LYRAT_NVS_STATIONS_HEADER, payload);
+    pBuffer[0] = LYRAT_NVS_STATIONS_VERSION;
+    pBuffer[1] = count;
+    pBuffer[2] = payload & 0xff;
+    pBuffer[3] = payload >> 8;
+    pBuffer[4] = crc & 0xff;
+    pBuffer[5] = (crc >> 8) & 0xff;
+    pBuffer[6] = (crc >> 16) & 0xff;
+    pBuffer[7] = crc >> 24;
+
+    return LYRAT_NVS_STATIONS_HEADER + payload;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ParseStations(const uint8_t* pBuffer, size_t length, Station_t& actTune, StationList& stations)
+{
+    if (length < LYRAT_NVS_STATIONS_HEADER || pBuffer[0] != LYRAT_NVS_STATIONS_VERSION) {
+        return false;
+    }
+
+    const uint8_t* pPos = pBuffer + LYRAT_NVS_STATIONS_HEADER;
+    const uint8_t* pEnd = pBuffer + length;
+    size_t payload = pBuffer[2] | (pBuffer[3] << 8);
+    uint32_t crc = pBuffer[4] | (pBuffer[5] << 8) | (pBuffer[6] << 16) | ((uint32_t)pBuffer[7] << 24);
+
+    if (pPos + payload != pEnd || Crc32(pPos, payload) != crc) {
+        return false;
+    }
+
+    int count = pBuffer[1];
+    stations.resize(count);
+
+    Station_t dropped;
+    bool bOk = ParseStation(pPos, pEnd, actTune);
+    for (int i = 0; bOk && i < count; i++) {
+        bOk = ParseStation(pPos, pEnd, (i < stations.size()) ? stations[i] : dropped);
+    }
+    return bOk;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StationUuid_t
+///////////////////////////////////////////////////////////////////////////////
+static int HexValue(char ch)
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool StationUuid::Parse(const char* pId)
+{
+    if (strnlen(pId, 37) != 36) {
+        return false;
+    }
+
+    int n = 0;
+    for (int i = 0; i < 36; i++) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (pId[i] != '-') {
+                return false;
+            }
+            continue;
+        }
+        int hi = HexValue(pId[i]);
+        int lo = HexValue(pId[++i]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        mBytes[n++] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StationUuid::Format(char* buffer) const
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *buffer++ = '-';
+        }
+        *buffer++ = hex[mBytes[i] >> 4];
+        *buffer++ = hex[mBytes[i] & 0x0f];
+    }
+    *buffer = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t StationUuid::Hash() const
+{
+    uint32_t words[4];
+    memcpy(words, mBytes, sizeof(words));
+    return (words[0] ^ words[1] ^ words[2] ^ words[3]) * 0x9e3779b1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckListRing
+///////////////////////////////////////////////////////////////////////////////
+CheckListRing::CheckListRing()
+{
+    Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void CheckListRing::Clear()
+{
+    memset(mRecords, 0, sizeof(mRecords));
+    memset(mIndex, 0xff, sizeof(mIndex));
+    mHead = 0;
+    mCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int CheckListRing::Add(const StationUuid_t& uuid, CheckListResult result)
+{
+    int slot = Find(uuid);
+
+    if (slot >= 0) {
+        if (mRecords[slot].mResult >= (uint8_t)result) {
+            return -1;
+        }
+        mRecords[slot].mResult = result;
+        return slot;
+    }
+
+    // overwrite the oldest entry if the ring is full
+    slot = mHead;
+    if (mCount == LYRAT_NVS_CHECK_CAPACITY) {
+        IndexErase(slot);
+    }
+    else {
+        mCount++;
+    }
+    mRecords[slot].mUuid = uuid;
+    mRecords[slot].mResult = result;
+    IndexInsert(slot);
+    mHead = (mHead + 1) % LYRAT_NVS_CHECK_CAPACITY;
+
+    return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int CheckListRing::Find(const StationUuid_t& uuid)
+{
+    const uint32_t mask = LYRAT_NVS_CHECK_INDEX_SIZE - 1;
+
+    for (uint32_t i = uuid.Hash() & mask; mIndex[i] != EmptySlot; i = (i + 1) & mask) {
+        if (mRecords[mIndex[i]].mUuid == uuid) {
+            return mIndex[i];
+        }
+    }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void CheckListRing::SetHeader(uint32_t header)
+{
+    mHead = header & 0xffff;
+    mCount = header >> 16;
+    if (mHead >= LYRAT_NVS_CHECK_CAPACITY || mCount > LYRAT_NVS_CHECK_CAPACITY) {
+        mHead = 0;
+        mCount = 0;
+    }
+
+    memset(mIndex, 0xff, sizeof(mIndex));
+    for (int i = 0; i < mCount; i++) {
+        IndexInsert((mHead + LYRAT_NVS_CHECK_CAPACITY - 1 - i) % LYRAT_NVS_CHECK_CAPACITY);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void CheckListRing::IndexInsert(int slot)
+{
+    const uint32_t mask = LYRAT_NVS_CHECK_INDEX_SIZE - 1;
+
+    uint32_t i = mRecords[slot].mUuid.Hash() & mask;
+    while (mIndex[i] != EmptySlot) {
+        i = (i + 1) & mask;
+    }
+    mIndex[i] = slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// linear probing delete, move following entries back so no tombstones are needed
+void CheckListRing::IndexErase(int slot)
+{
+    const uint32_t mask = LYRAT_NVS_CHECK_INDEX_SIZE - 1;
+
+    uint32_t i = mRecords[slot].mUuid.Hash() & mask;
+    while (mIndex[i] != slot) {
+        if (mIndex[i] == EmptySlot) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    mIndex[i] = EmptySlot;
+
+    for (uint32_t j = (i + 1) & mask; mIndex[j] != EmptySlot; j = (j + 1) & mask) {
+        uint32_t home = mRecords[mIndex[j]].mUuid.Hash() & mask;
+        // entry j may move to the gap at i if its home is not in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            mIndex[i] = mIndex[j];
+            mIndex[j] = EmptySlot;
+            i = j;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StationIndex
+///////////////////////////////////////////////////////////////////////////////
+StationIndex::StationIndex()
+{
+    for (int i = 0; i < LYRAT_STATION_INDEX_SIZE; i++) {
+        mEntries[i].mStation = -1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StationIndex::Build(const StationList& stations)
+{
+    const uint32_t mask = LYRAT_STATION_INDEX_SIZE - 1;
+
+    for (int i = 0; i < LYRAT_STATION_INDEX_SIZE; i++) {
+        mEntries[i].mStation = -1;
+    }
+
+    for (int n = 0; n < stations.size(); n++) {
+        StationUuid_t uuid;
+        if (!uuid.Parse(stations[n].mId.c_str()) || Find(uuid) >= 0) {
+            continue;
+        }
+        uint32_t i = uuid.Hash() & mask;
+        while (mEntries[i].mStation >= 0) {
+            i = (i + 1) & mask;
+        }
+        mEntries[i].mUuid = uuid;
+        mEntries[i].mStation = n;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int StationIndex::Find(const StationUuid_t& uuid) const
+{
+    const uint32_t mask = LYRAT_STATION_INDEX_SIZE - 1;
+
+    for (uint32_t i = uuid.Hash() & mask; mEntries[i].mStation >= 0; i = (i + 1) & mask) {
+        if (mEntries[i].mUuid == uuid) {
+            return mEntries[i].mStation;
+        }
+    }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StationStats_t
+///////////////////////////////////////////////////////////////////////////////
+// penalties: start time (max 40), underruns and reconnects per play (max 30/20), last error (10)
+int StationStats::Score() const
+{
+    int plays = (mPlays > 0) ? mPlays : 1;
+    int score = 100;
+
+    score -= std::min(40, mTtfaMs / 250);
+    score -= std::min(30, mUnderruns * 10 / plays);
+    score -= std::min(20, mReconnects * 10 / plays);
+    score -= (mLastError != 0) ? 10 : 0;
+
+    return std::max(0, score);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static uint16_t MovingAverage(uint16_t average, int value)
+{
+    value = std::min(0xffff, std::max(0, value));
+    return (average == 0) ? value : (average * 3 + value) / 4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StationStatsTable
+///////////////////////////////////////////////////////////////////////////////
+StationStatsTable::StationStatsTable()
+{
+    Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StationStatsTable::Clear()
+{
+    memset(mStats, 0, sizeof(mStats));
+    mCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the updated station moves to the front, the oldest one drops out if the table is full
+void StationStatsTable::Update(const StationUuid_t& uuid, StatsEvent_e event, int value)
+{
+    int i = 0;
+    while (i < mCount && mStats[i].mUuid != uuid) {
+        i++;
+    }
+
+    StationStats_t stats;
+    if (i < mCount) {
+        stats = mStats[i];
+    }
+    else {
+        memset(&stats, 0, sizeof(stats));
+        stats.mUuid = uuid;
+        if (mCount < LYRAT_NVS_STATS_CAPACITY) {
+            mCount++;
+        }
+        i = mCount - 1;
+    }
+    memmove(&mStats[1], &mStats[0], i * sizeof(StationStats_t));
+
+    switch (event) {
+    case StatsPlay:
+        stats.mPlays = std::min(0xffff, stats.mPlays + 1);
+        stats.mLastError = 0;
+        break;
+    case StatsFirstAudio:
+        stats.mTtfaMs = MovingAverage(stats.mTtfaMs, value);
+        break;
+    case StatsUnderrun:
+        stats.mUnderruns = std::min(0xffff, stats.mUnderruns + 1);
+        break;
+    case StatsBitrate:
+        stats.mBitrate = MovingAverage(stats.mBitrate, value);
+        break;
+    case StatsReconnect:
+        stats.mReconnects = std::min(0xffff, stats.mReconnects + 1);
+        break;
+    case StatsError:
+        stats.mLastError = value;
+        break;
+    }
+    mStats[0] = stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t StationStatsTable::Serialize(uint8_t* pBuffer, size_t size)
+{
+    size_t length = mCount * sizeof(StationStats_t);
+    if (size < LYRAT_NVS_STATS_HEADER + length) {
+        return 0;
+    }
+
+    memcpy(pBuffer + LYRAT_NVS_STATS_HEADER, mStats, length);
+    uint32_t crc = Crc32(pBuffer + LYRAT_NVS_STATS_HEADER, length);
+    pBuffer[0] = LYRAT_NVS_STATS_VERSION;
+    pBuffer[1] = mCount;
+    pBuffer[2] = 0;
+    pBuffer[3] = 0;
+    pBuffer[4] = crc & 0xff;
+    pBuffer[5] = (crc >> 8) & 0xff;
+    pBuffer[6] = (crc >> 16) & 0xff;
+    pBuffer[7] = crc >> 24;
+
+    return LYRAT_NVS_STATS_HEADER + length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool StationStatsTable::Parse(const uint8_t* pBuffer, size_t length)
+{
+    Clear();
+    if (length < LYRAT_NVS_STATS_HEADER || pBuffer[0] != LYRAT_NVS_STATS_VERSION || pBuffer[1] > LYRAT_NVS_STATS_CAPACITY) {
+        return false;
+    }
+
+    int count = pBuffer[1];
+    uint32_t crc = pBuffer[4] | (pBuffer[5] << 8) | (pBuffer[6] << 16) | ((uint32_t)pBuffer[7] << 24);
+    if (length != LYRAT_NVS_STATS_HEADER + count * sizeof(StationStats_t)
+        || Crc32(pBuffer + LYRAT_NVS_STATS_HEADER, count * sizeof(StationStats_t)) != crc) {
+        return false;
+    }
+
+    memcpy(mStats, pBuffer + LYRAT_NVS_STATS_HEADER, count * sizeof(StationStats_t));
+    mCount = count;
+    return true;
+}
@@ -0,0 +1,190 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+#ifndef _NVSCODEC_H_
+#define _NVSCODEC_H_
+
+// Binary formats of the NVS storage. This file has no ESP-IDF dependencies,
+// it can be compiled and checked on a host.
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "data_json_interface.h"
+
+// station list blob:
+//   header:  version (1), preset count (1), payload length (2), crc32 of payload (4)
+//   payload: act tune + presets, each as id, url, decoder with a 16 bit length prefix
+// All values are little endian.
+#define LYRAT_NVS_STATIONS_VERSION 1
+#define LYRAT_NVS_STATIONS_HEADER 8
+
+// check result ring, stored in chunks so that an update rewrites only one small blob
+#define LYRAT_NVS_CHECK_CAPACITY 192
+#define LYRAT_NVS_CHECK_CHUNK 64
+#define LYRAT_NVS_CHECK_INDEX_SIZE 256 // power of 2, > capacity
+
+// presets by station uuid, in RAM only
+#define LYRAT_STATION_INDEX_SIZE 64 // power of 2, > LYRAT_MAX_STATIONS
+
+// station statistics blob:
+//   header:  version (1), record count (1), reserved (2), crc32 of records (4)
+//   records: StationStats_t, most recently played first
+#define LYRAT_NVS_STATS_VERSION 1
+#define LYRAT_NVS_STATS_HEADER 8
+#define LYRAT_NVS_STATS_CAPACITY 32
+
+//////////////////////////////////////////////////////////////////////
+enum CheckListResult {
+    Undefined,
+    Invalid,
+    Valid
+};
+
+inline const char* CheckListResultString(CheckListResult result)
+{
+    switch (result) {
+    case CheckListResult::Undefined:
+        return "Undefined";
+    case CheckListResult::Invalid:
+        return "Invalid";
+    case CheckListResult::Valid:
+        return "Valid";
+    default:
+        return "Unknown";
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// station id as packed 128 bit key, e.g. '9605ae29-0601-11e8-ae97-52543be04c81'
+typedef struct StationUuid {
+    uint8_t mBytes[16];
+
+    bool Parse(const char* pId); // false if id is no uuid
+    void Format(char* buffer) const; // buffer with at least 37 bytes
+    uint32_t Hash() const;
+    inline bool operator==(const StationUuid& rhs) const { return memcmp(mBytes, rhs.mBytes, sizeof(mBytes)) == 0; }
+    inline bool operator!=(const StationUuid& rhs) const { return !(*this == rhs); }
+} StationUuid_t;
+
+//////////////////////////////////////////////////////////////////////
+typedef struct __attribute__((packed)) {
+    StationUuid_t mUuid;
+    uint8_t mResult; // CheckListResult
+} CheckRecord_t;
+
+//////////////////////////////////////////////////////////////////////
+// fixed size ring of check results with hash index, newest entry is 0
+class CheckListRing {
+public:
+    CheckListRing();
+
+    void Clear();
+    int Add(const StationUuid_t& uuid, CheckListResult result); // returns changed slot, -1 if nothing changed
+    int Find(const StationUuid_t& uuid); // returns slot or -1
+    int Size() { return mCount; }
+    const CheckRecord_t& Get(int i) { return mRecords[(mHead + LYRAT_NVS_CHECK_CAPACITY - 1 - i) % LYRAT_NVS_CHECK_CAPACITY]; }
+    const CheckRecord_t& GetSlot(int slot) { return mRecords[slot]; } // slot as returned by Find
+
+    // persistence
+    uint8_t* Chunk(int chunk) { return (uint8_t*)&mRecords[chunk * LYRAT_NVS_CHECK_CHUNK]; }
+    uint32_t GetHeader() { return (mCount << 16) | mHead; }
+    void SetHeader(uint32_t header); // rebuilds the index
+
+private:
+    void IndexInsert(int slot);
+    void IndexErase(int slot);
+
+private:
+    static const uint16_t EmptySlot = 0xffff;
+    CheckRecord_t mRecords[LYRAT_NVS_CHECK_CAPACITY];
+    uint16_t mIndex[LYRAT_NVS_CHECK_INDEX_SIZE];
+    int mHead;
+    int mCount;
+};
+
+//////////////////////////////////////////////////////////////////////
+// hash index of the presets on the packed uuid, rebuilt when the list changes;
+// ids that are no uuid are not indexed, for a duplicate uuid the first preset wins
+class StationIndex {
+public:
+    StationIndex();
+
+    void Build(const StationList& stations);
+    int Find(const StationUuid_t& uuid) const; // preset index or -1
+
+private:
+    typedef struct {
+        StationUuid_t mUuid;
+        int8_t mStation; // -1 if empty
+    } Entry_t;
+
+    Entry_t mEntries[LYRAT_STATION_INDEX_SIZE];
+};
+
+//////////////////////////////////////////////////////////////////////
+enum StatsEvent_e {
+    StatsPlay,       // station started
+    StatsFirstAudio, // value: time to first audio in ms
+    StatsUnderrun,
+    StatsBitrate,    // value: measured kbit/s
+    StatsReconnect,
+    StatsError,      // value: error code, e.g. AEL_STATUS_ERROR_xxx of the http reader
+};
+
+//////////////////////////////////////////////////////////////////////
+typedef struct __attribute__((packed)) StationStats {
+    StationUuid_t mUuid;
+    uint16_t mPlays;
+    uint16_t mTtfaMs; // time to first audio, moving average
+    uint16_t mUnderruns;
+    uint16_t mBitrate; // kbit/s, moving average
+    uint16_t mReconnects;
+    int16_t mLastError; // 0 if the last play had no error
+
+    int Score() const; // 0 (unusable) .. 100 (fast and reliable)
+} StationStats_t;
+
+//////////////////////////////////////////////////////////////////////
+// statistics of the most recently played stations, newest entry is 0
+class StationStatsTable {
+public:
+    StationStatsTable();
+
+    void Clear();
+    void Update(const StationUuid_t& uuid, StatsEvent_e event, int value);
+    int Size() { return mCount; }
+    const StationStats_t& Get(int i) { return mStats[i]; }
+
+    // persistence
+    size_t Serialize(uint8_t* pBuffer, size_t size);
+    bool Parse(const uint8_t* pBuffer, size_t length);
+
+private:
+    StationStats_t mStats[LYRAT_NVS_STATS_CAPACITY];
+    int mCount;
+};
+
+//////////////////////////////////////////////////////////////////////
+uint32_t Crc32(const uint8_t* pData, size_t length);
+
+// returns the blob length (0 if not even the act tune fits), count is the number of stored presets
+size_t SerializeStations(uint8_t* pBuffer, size_t size, const Station_t& actTune, const StationList& stations, int& count);
+// bytes of one station in the payload, the blob of act tune and presets is the header plus their sum
+size_t StationBlobSize(const Station_t& station);
+// presets beyond the capacity of the list are dropped
+bool ParseStations(const uint8_t* pBuffer, size_t length, Station_t& actTune, StationList& stations);
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
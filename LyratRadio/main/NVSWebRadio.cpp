@@ -27,15 +27,30 @@
 
 extern const char* TAG;
 char NVSWebRadio::mStaticBuffer[512];
+uint8_t NVSWebRadio::mBlobBuffer[LYRAT_NVS_STATIONS_MAX_SIZE];
 
 ///////////////////////////////////////////////////////////////////////////////
 NVSWebRadio::NVSWebRadio()
+    : mMyHandle(0)
+    , mMutex(NULL)
+    , mWriteMutex(NULL)
+    , mDirty(0)
+    , mCheckDirtyChunks(0)
+    , mRestartCount(-1)
+    , mCheckCount(0)
+    , mCommitTask(NULL)
+    , mCommitRequests(0)
+    , mCommits(0)
+    , mWriteErrors(0)
 {
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 esp_err_t NVSWebRadio::Initialize()
 {
+    mMutex = xSemaphoreCreateRecursiveMutex();
+    mWriteMutex = xSemaphoreCreateMutex();
+
     // Initialize NVS
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -53,6 +68,13 @@ esp_err_t NVSWebRadio::Initialize()
         ESP_LOGE(TAG, "[ NVS ] Error (%s) opening NVS handle!\n", esp_err_to_name(err));
     }
     else {
+        bool bDefaults = !ExistsValue(LYRAT_NET_ACTSTATION);
+
+        // read all values once, afterwards the flash is only written
+        LoadSettings();
+
+        xTaskCreate(nvs_commit_task, "nvs_commit", LYRAT_NVS_COMMIT_TASK_STACK, this, 1, &mCommitTask);
+
         // increase reset counter
         IncRestartNoRooter();
 
@@ -62,33 +84,30 @@ esp_err_t NVSWebRadio::Initialize()
             SetCredentials(cr);
         }
 
-        if (!ExistsValue(LYRAT_NET_ACTSTATION)) {
+        if (bDefaults) {
             ESP_LOGI(TAG, "[ NVS ] Set default values... ");
 
-            Settings_t set;
-
             Station_t station0(DEFAULT_STATION0);
             Station_t station1(DEFAULT_STATION1);
-            set.mStations.push_back(station0);
-            set.mStations.push_back(station1);
-            set.mActTune = station0;
 
-            SetCredentials(set.mCredentials);
-            SetBluetooth(set.mBluetooth);
+            SetCredentials(Credentials_t());
+            SetBluetooth(Bluetooth_t());
 
-            for (int i = 0; i < set.mStations.size(); i++) {
-                SetStation(i, set.mStations[i], set.mStations.size());
-            }
-            SetStation(-1, set.mActTune, 2);
-            std::string strName = "Lyrat Web Radio";
-            SetName(strName);
+            SetStation(0, station0, 2);
+            SetStation(1, station1, 2);
+            SetStation(-1, station0, 2);
+            SetName("Lyrat Web Radio");
             SetVolume(50);
             SetActStation(-1);
 
-            std::string empty = "";
-            SetValue(LYRAT_NVS_CHECKLIST, empty);
+            Lock();
+            mCheckList.Clear();
+            mCheckDirtyChunks = (1 << (LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK)) - 1;
 			AddCheckedStation(station0, CheckListResult::Valid);
 			AddCheckedStation(station1, CheckListResult::Valid);
+            MarkDirty(DirtyVolume | DirtyActStation | DirtyCheckList);
+            Unlock();
+            Flush();
         }
     }
 
@@ -99,129 +118,153 @@ esp_err_t NVSWebRadio::Initialize()
 // increase variable to detect unreachable network
 void NVSWebRadio::IncRestartNoRooter()
 {
-    SetValue(LYRAT_NVS_RESTART_NOROUTER, GetRestartCount() + 1);
+    Lock();
+    mRestartCount++;
+    MarkDirty(DirtyRestartCount);
+    Unlock();
+
+    // must be in flash before anything else can fail
+    Flush();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // return restart count
 int NVSWebRadio::GetRestartCount()
 {
-    return ExistsValue(LYRAT_NVS_RESTART_NOROUTER) ? GetValue(LYRAT_NVS_RESTART_NOROUTER) : -1;
+    return mRestartCount;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // reset no-network counter
 void NVSWebRadio::ResetRestartNoRooter()
 {
-    SetValue(LYRAT_NVS_RESTART_NOROUTER, 0);
+    Lock();
+    if (mRestartCount != 0) {
+        mRestartCount = 0;
+        MarkDirty(DirtyRestartCount);
+        ScheduleCommit();
+    }
+    Unlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetCredentials(Credentials_t& cr)
+void NVSWebRadio::SetCredentials(const Credentials_t& cr)
 {
-    esp_err_t err = nvs_set_str(mMyHandle, LYRAT_NET_RADIOSSID, cr.mSSID.c_str());
-    ESP_ERROR_CHECK(err);
-
-    err = nvs_set_str(mMyHandle, LYRAT_NET_RADIOPASSWD, cr.mPassword.c_str());
-    ESP_ERROR_CHECK(err);
-
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    Lock();
+    mSettings.mCredentials = cr;
+    MarkDirty(DirtyCredentials);
+    ScheduleCommit();
+    Unlock();
 
     ResetRestartNoRooter();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetBluetooth(Bluetooth_t& bt)
+void NVSWebRadio::SetBluetooth(const Bluetooth_t& bt)
 {
-    esp_err_t err = nvs_set_i32(mMyHandle, LYRAT_NET_BT_ENABLED, bt.mbEnabled);
-    ESP_ERROR_CHECK(err);
-
-    err = nvs_set_str(mMyHandle, LYRAT_NET_BT_PAIR, bt.mPair.c_str());
-    ESP_ERROR_CHECK(err);
-
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    Lock();
+    mSettings.mBluetooth = bt;
+    MarkDirty(DirtyBluetooth);
+    ScheduleCommit();
+    Unlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetStation(int index, Station_t& st, int maxStation)
+void NVSWebRadio::SetStation(int index, const Station_t& st, int maxStation)
 {
-    char key[32];
-
-    sprintf(key, "%s%d", LYRAT_NET_ST_ID, index);
-    esp_err_t err = nvs_set_str(mMyHandle, key, st.mId.c_str());
-    ESP_ERROR_CHECK(err);
-
-    sprintf(key, "%s%d", LYRAT_NET_ST_URL, index);
-    err = nvs_set_str(mMyHandle, key, st.mUrl.c_str());
-    ESP_ERROR_CHECK(err);
-
-    sprintf(key, "%s%d", LYRAT_NET_ST_DECODER, index);
-    err = nvs_set_str(mMyHandle, key, st.mDecoder.c_str());
-    ESP_ERROR_CHECK(err);
-
-    //sprintf(key, "%s%d", LYRAT_NVS_STATION_PLAY_OK, index);
-    //err = nvs_set_i32(mMyHandle, key, 0);
-    //ESP_ERROR_CHECK(err);
-
-    if (index >= 0) {
-        err = nvs_set_i32(mMyHandle, LYRAT_NVS_MAXSTATION, maxStation);
-        ESP_ERROR_CHECK(err);
+    Lock();
+    if (index < 0) {
+        mSettings.mActTune = st;
+        MarkDirty(DirtyActTune);
     }
-
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    else {
+        if (maxStation > LYRAT_MAX_STATIONS && index == 0) {
+            ESP_LOGW(TAG, "[ NVS ] %d stations, only %d are kept", maxStation, LYRAT_MAX_STATIONS);
+        }
+        mSettings.mStations.resize(maxStation);
+        if (index < mSettings.mStations.size()) {
+            mSettings.mStations[index] = st;
+        }
+        mStationIndex.Build(mSettings.mStations);
+        MarkDirty(DirtyStations);
+    }
+    ScheduleCommit();
+    Unlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetName(std::string& name)
+void NVSWebRadio::SetName(const char* pName)
 {
-    esp_err_t err = nvs_set_str(mMyHandle, LYRAT_NET_RADIO, name.c_str());
-    ESP_ERROR_CHECK(err);
-
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    Lock();
+    mSettings.mRadioName = pName;
+    MarkDirty(DirtyName);
+    ScheduleCommit();
+    Unlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void NVSWebRadio::SetVolume(int volume)
 {
-    esp_err_t err = nvs_set_i32(mMyHandle, LYRAT_NET_VOLUME, volume);
-    ESP_ERROR_CHECK(err);
-
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    Lock();
+    if (mSettings.mVolume != volume) {
+        mSettings.mVolume = volume;
+        MarkDirty(DirtyVolume);
+        ScheduleCommit();
+    }
+    Unlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void NVSWebRadio::SetActStation(int actStation)
 {
-    esp_err_t err = nvs_set_i32(mMyHandle, LYRAT_NET_ACTSTATION, actStation);
-    ESP_ERROR_CHECK(err);
+    Lock();
+    if (mSettings.mActStation != actStation) {
+        mSettings.mActStation = actStation;
+        MarkDirty(DirtyActStation);
+        ScheduleCommit();
+    }
+    Unlock();
+}
 
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+///////////////////////////////////////////////////////////////////////////////
+// the presets behind move up; a removed act station becomes the act tune, so it keeps playing
+int NVSWebRadio::RemoveStation(const char* pId)
+{
+    Lock();
+    int index = FindStation(pId);
+    if (index >= 0) {
+        if (mSettings.mActStation == index) {
+            mSettings.mActTune = mSettings.mStations[index];
+            mSettings.mActStation = -1;
+            MarkDirty(DirtyActTune | DirtyActStation);
+        }
+        else if (mSettings.mActStation > index) {
+            mSettings.mActStation--;
+            MarkDirty(DirtyActStation);
+        }
+        mSettings.mStations.erase(index);
+        mStationIndex.Build(mSettings.mStations);
+        MarkDirty(DirtyStations);
+        ScheduleCommit();
+    }
+    Unlock();
+
+    return index;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::IncStationCheck(Station_t& station, CheckListResult result)
+void NVSWebRadio::IncStationCheck(const Station_t& station, CheckListResult result)
 {
+    Lock();
     int actCnt = 0;
     AddCheckedStation(station, result);
 
     switch (result) {
     case CheckListResult::Undefined:
     case CheckListResult::Invalid:
-        actCnt = GetValue(LYRAT_NET_CHECK);
+        actCnt = mCheckCount;
         if (actCnt > 2) {
-            printf("Reset actual station... \n");
+            ESP_LOGW(TAG, "[ NVS ] Reset actual station");
             AddCheckedStation(station, CheckListResult::Invalid);
 
             Station_t station0(DEFAULT_STATION0);
@@ -234,122 +277,512 @@ void NVSWebRadio::IncStationCheck(Station_t& station, CheckListResult result)
 
     ESP_LOGI(TAG, "[ NVS ] Reset count = %d\n", actCnt);
 
-    esp_err_t err = nvs_set_i32(mMyHandle, LYRAT_NET_CHECK, actCnt + 1);
-    ESP_ERROR_CHECK(err);
+    mCheckCount = actCnt + 1;
+    MarkDirty(DirtyCheckCount);
+    Unlock();
 
-    // Commit written value.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    if (result == CheckListResult::Valid) {
+        ScheduleCommit();
+    }
+    else {
+        // the counter detects stations that crash the board, so it has to be in flash
+        // before the stream is started. Pending changes (e.g. act station) go with it.
+        Flush();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::AddCheckedStation(Station_t& st, CheckListResult result)
+void NVSWebRadio::AddCheckedStation(const Station_t& st, CheckListResult result)
 {
-    bool bFound = false;
-    std::vector<CheckListEntry_t> stationList;
-    GetCheckedStations(stationList);
+    StationUuid_t uuid;
+    if (!uuid.Parse(st.mId.c_str())) {
+        ESP_LOGW(TAG, "[ NVS ] Station id '%s' is no uuid, not added to check list", st.mId.c_str());
+        return;
+    }
 
-    //printf("## LYRAT_NVS_CHECKLIST, %d\n", stationList.size());
+    Lock();
+    // Undefined (0), Invalid (1), Valid(2) --> the ring writes only bigger values
+    int slot = mCheckList.Add(uuid, result);
+    if (slot >= 0) {
+        mCheckDirtyChunks |= 1 << (slot / LYRAT_NVS_CHECK_CHUNK);
+        MarkDirty(DirtyCheckList);
+    }
+    Unlock();
+}
 
-    // station already in list?
-    for (std::size_t i = 0; i < stationList.size(); ++i) {
-        if (stationList[i].mId == st.mId) {
-            stationList[i].mId = st.mId;
-            // Undefined (0), Invalid (1), Valid(2) --> write only bigger values
-            if ((int)stationList[i].mResult < (int)result) {
-                stationList[i].mResult = result;
-            }
-            bFound = true;
-            break;
-        }
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetCheckedStationCount()
+{
+    Lock();
+    int count = mCheckList.Size();
+    Unlock();
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+CheckListResult NVSWebRadio::GetStationCheck(const char* pId)
+{
+    StationUuid_t uuid;
+    if (!uuid.Parse(pId)) {
+        return CheckListResult::Undefined;
     }
 
-    if (!bFound) {
-        // remove last entry if not fit, // e.g. '78012206-1aa1-11e9-a80b-52543be04c81,2;'
-        if ((stationList.size() + 1) * 40 >= sizeof(mStaticBuffer)) {
-            stationList.pop_back();
-        }
-        stationList.insert(stationList.begin(), CheckListEntry_t());
+    Lock();
+    int slot = mCheckList.Find(uuid);
+    CheckListResult result = (slot >= 0) ? (CheckListResult)mCheckList.GetSlot(slot).mResult : CheckListResult::Undefined;
+    Unlock();
 
-        stationList[0].mId = st.mId;
-        stationList[0].mResult = result;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::AddStationStats(const char* pId, StatsEvent_e event, int value)
+{
+    StationUuid_t uuid;
+    if (!uuid.Parse(pId)) {
+        return;
     }
 
-    std::string write;
-    for (std::size_t i = 0; i < stationList.size(); ++i) {
-        char chResult[2];
-        sprintf(chResult, "%d", stationList[i].mResult);
-        write += stationList[i].mId + "," + chResult + ";";
-        //printf("# i %d %s\n", i, chResult);
+    Lock();
+    mStats.Update(uuid, event, value);
+    MarkDirty(DirtyStats);
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetStationStatsCount()
+{
+    Lock();
+    int count = mStats.Size();
+    Unlock();
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool NVSWebRadio::GetStationStats(int i, char* id, StationStats_t& stats)
+{
+    bool bRc = false;
+
+    Lock();
+    if (i >= 0 && i < mStats.Size()) {
+        stats = mStats.Get(i);
+        stats.mUuid.Format(id);
+        bRc = true;
     }
-    SetValue(LYRAT_NVS_CHECKLIST, write);
+    Unlock();
+
+    return bRc;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::GetCheckedStations(std::vector<CheckListEntry_t>& retList)
+bool NVSWebRadio::GetCheckedStation(int i, char* id, CheckListResult& result)
 {
-    retList.clear();
+    bool bRc = false;
+
+    Lock();
+    if (i >= 0 && i < mCheckList.Size()) {
+        const CheckRecord_t& record = mCheckList.Get(i);
+        record.mUuid.Format(id);
+        result = (CheckListResult)record.mResult;
+        bRc = true;
+    }
+    Unlock();
 
-    std::string stations;
+    return bRc;
+}
 
-    if (GetValue(LYRAT_NVS_CHECKLIST, stations)) {
-        std::string::size_type prev_pos = 0, pos = 0, pos2 = 0;
+///////////////////////////////////////////////////////////////////////////////
+bool NVSWebRadio::GetStation(int i, Station_t& station)
+{
+    bool bRc = false;
 
-        while ((pos = stations.find(';', pos)) != std::string::npos) {
-            std::string entry(stations.substr(prev_pos, pos - prev_pos));
+    Lock();
+    if (i == -1) {
+        station = mSettings.mActTune;
+        bRc = true;
+    }
+    else if (i >= 0 && i < mSettings.mStations.size()) {
+        station = mSettings.mStations[i];
+        bRc = true;
+    }
+    Unlock();
 
-            if ((pos2 = entry.find(',')) != std::string::npos) {
-                std::string id = entry.substr(0, pos2);
-                std::string resString = entry.substr(pos2 + 1);
-                CheckListResult res = CheckListResult::Undefined;
-                if (resString == "1") {
-                    res = CheckListResult::Invalid;
-                }
-                else if (resString == "2") {
-                    res = CheckListResult::Valid;
-                }
+    return bRc;
+}
 
-                retList.push_back(CheckListEntry_t());
-                retList[retList.size() - 1].mId = id;
-                retList[retList.size() - 1].mResult = res;
-            }
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetPlayStation(Station_t& station)
+{
+    Lock();
+    int act = mSettings.mActStation;
+    if (act < 0 || act >= mSettings.mStations.size()) {
+        act = -1;
+    }
+    station = (act == -1) ? mSettings.mActTune : mSettings.mStations[act];
+    Unlock();
 
-            prev_pos = ++pos;
+    return act;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetStationCount()
+{
+    Lock();
+    int count = mSettings.mStations.size();
+    Unlock();
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// uuids through the index, other ids are compared one by one
+int NVSWebRadio::FindStation(const char* pId)
+{
+    StationUuid_t uuid;
+    bool bUuid = uuid.Parse(pId);
+
+    Lock();
+    int index = -1;
+    if (bUuid) {
+        index = mStationIndex.Find(uuid);
+    }
+    else {
+        for (int i = 0; i < mSettings.mStations.size() && index < 0; i++) {
+            if (mSettings.mStations[i].mId == pId) {
+                index = i;
+            }
         }
     }
+    Unlock();
+
+    return index;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetActStation()
+{
+    Lock();
+    int act = mSettings.mActStation;
+    Unlock();
+    return act;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetVolume()
+{
+    Lock();
+    int volume = mSettings.mVolume;
+    Unlock();
+    return volume;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::GetCredentials(Credentials_t& credentials)
+{
+    Lock();
+    credentials = mSettings.mCredentials;
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::GetName(RadioName_t& name)
+{
+    Lock();
+    name = mSettings.mRadioName;
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool NVSWebRadio::EmptyCredentials()
+{
+    Lock();
+    bool bEmpty = mSettings.mCredentials.mSSID.length() == 0;
+    Unlock();
+    return bEmpty;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::GetSettings(Settings_t& set)
+// Settings cache
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::LoadSettings()
 {
+    Lock();
+
     // credentials
-    GetValue(LYRAT_NET_RADIOSSID, set.mCredentials.mSSID);
-    GetValue(LYRAT_NET_RADIOPASSWD, set.mCredentials.mPassword);
+    GetValue(LYRAT_NET_RADIOSSID, mSettings.mCredentials.mSSID);
+    GetValue(LYRAT_NET_RADIOPASSWD, mSettings.mCredentials.mPassword);
 
     // bluetooth
-    set.mBluetooth.mbEnabled = GetValue(LYRAT_NET_BT_ENABLED);
-    GetValue(LYRAT_NET_BT_PAIR, set.mBluetooth.mPair);
+    mSettings.mBluetooth.mbEnabled = GetValue(LYRAT_NET_BT_ENABLED);
+    GetValue(LYRAT_NET_BT_PAIR, mSettings.mBluetooth.mPair);
+
+    // station list, one blob read
+    ReadStations();
+    mStationIndex.Build(mSettings.mStations);
+
+    GetValue(LYRAT_NET_RADIO, mSettings.mRadioName);
+    mSettings.mVolume = GetValue(LYRAT_NET_VOLUME);
+    mSettings.mActStation = GetValue(LYRAT_NET_ACTSTATION);
+
+    mRestartCount = ExistsValue(LYRAT_NVS_RESTART_NOROUTER) ? GetValue(LYRAT_NVS_RESTART_NOROUTER) : -1;
+    mCheckCount = GetValue(LYRAT_NET_CHECK);
+    ReadCheckedStations();
+    ReadStationStats();
+
+    mDirty = 0;
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::MarkDirty(uint32_t dirty)
+{
+    mDirty |= dirty;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Commit scheduler
+///////////////////////////////////////////////////////////////////////////////
+// request a write-back, the commit task coalesces all requests of a busy period into one commit;
+// the setters hold the lock here, so without a commit task the values wait for the next Flush
+void NVSWebRadio::ScheduleCommit()
+{
+    Lock();
+    mCommitRequests++;
+    Unlock();
+
+    if (mCommitTask != NULL) {
+        xTaskNotifyGive(mCommitTask);
+    }
+}
 
+///////////////////////////////////////////////////////////////////////////////
+// write pending changes now (e.g. before restart), the caller must not hold the lock
+void NVSWebRadio::Flush()
+{
+    WriteBack();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int NVSWebRadio::GetCommitsSaved()
+{
+    return mCommitRequests > mCommits ? mCommitRequests - mCommits : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::nvs_commit_task(void* pvParameters)
+{
+    NVSWebRadio* nvs = (NVSWebRadio*)pvParameters;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // wait for a quiet period, but do not delay the commit forever
+        TickType_t start = xTaskGetTickCount();
+        while (ulTaskNotifyTake(pdTRUE, LYRAT_NVS_COMMIT_QUIET_MS / portTICK_PERIOD_MS) != 0) {
+            if ((xTaskGetTickCount() - start) >= LYRAT_NVS_COMMIT_MAX_DELAY_MS / portTICK_PERIOD_MS) {
+                break;
+            }
+        }
+        nvs->Flush();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// write all dirty values to flash, one commit for all of them. The values are copied under
+// the lock and written without it, readers and setters never wait for the flash. A value
+// that changes meanwhile is dirty again and goes with the next commit.
+void NVSWebRadio::WriteBack()
+{
+    xSemaphoreTake(mWriteMutex, portMAX_DELAY);
+    Lock();
+    uint32_t dirty = mDirty;
+    mDirty = 0;
+    mWriteValues.mCredentials = mSettings.mCredentials;
+    mWriteValues.mBluetooth = mSettings.mBluetooth;
+    mWriteValues.mRadioName = mSettings.mRadioName;
+    mWriteValues.mVolume = mSettings.mVolume;
+    mWriteValues.mActStation = mSettings.mActStation;
+    mWriteValues.mCheckCount = mCheckCount;
+    mWriteValues.mRestartCount = mRestartCount;
+    Unlock();
+
+    // each group is written on its own, a failed one (e.g. ESP_ERR_NVS_NOT_ENOUGH_SPACE) stays
+    // dirty and is retried with the next commit; the small counters go first, the crash guard
+    // must not wait for the station list blob
+    const WriteValues_t& values = mWriteValues;
+    uint32_t failed = 0;
+    uint32_t chunks = 0; // check list chunks of this write-back
+    if (dirty & DirtyCheckCount) {
+        CheckWrite(nvs_set_i32(mMyHandle, LYRAT_NET_CHECK, values.mCheckCount), DirtyCheckCount, failed);
+    }
+    if (dirty & DirtyRestartCount) {
+        CheckWrite(nvs_set_i32(mMyHandle, LYRAT_NVS_RESTART_NOROUTER, values.mRestartCount), DirtyRestartCount, failed);
+    }
+    if (dirty & DirtyActStation) {
+        CheckWrite(nvs_set_i32(mMyHandle, LYRAT_NET_ACTSTATION, values.mActStation), DirtyActStation, failed);
+    }
+    if (dirty & DirtyVolume) {
+        CheckWrite(nvs_set_i32(mMyHandle, LYRAT_NET_VOLUME, values.mVolume), DirtyVolume, failed);
+    }
+    if (dirty & DirtyCheckList) {
+        CheckWrite(WriteCheckedStations(chunks), DirtyCheckList, failed);
+    }
+    if (dirty & DirtyCredentials) {
+        esp_err_t err = nvs_set_str(mMyHandle, LYRAT_NET_RADIOSSID, values.mCredentials.mSSID.c_str());
+        if (err == ESP_OK) {
+            err = nvs_set_str(mMyHandle, LYRAT_NET_RADIOPASSWD, values.mCredentials.mPassword.c_str());
+        }
+        CheckWrite(err, DirtyCredentials, failed);
+    }
+    if (dirty & DirtyBluetooth) {
+        esp_err_t err = nvs_set_i32(mMyHandle, LYRAT_NET_BT_ENABLED, values.mBluetooth.mbEnabled);
+        if (err == ESP_OK) {
+            err = nvs_set_str(mMyHandle, LYRAT_NET_BT_PAIR, values.mBluetooth.mPair.c_str());
+        }
+        CheckWrite(err, DirtyBluetooth, failed);
+    }
+    if (dirty & DirtyName) {
+        CheckWrite(nvs_set_str(mMyHandle, LYRAT_NET_RADIO, values.mRadioName.c_str()), DirtyName, failed);
+    }
+    if (dirty & DirtyStats) {
+        CheckWrite(WriteStationStats(), DirtyStats, failed);
+    }
+    if (dirty & (DirtyStations | DirtyActTune)) {
+        CheckWrite(WriteStations(), dirty & (DirtyStations | DirtyActTune), failed);
+    }
+
+    bool bCommit = (dirty & ~failed) != 0;
+    if (bCommit) {
+        // Commit written value.
+        // After setting any values, nvs_commit() must be called to ensure changes are written
+        // to flash storage. Implementations may write to storage at other times,
+        // but this is not guaranteed.
+        esp_err_t err = nvs_commit(mMyHandle);
+        bCommit = err == ESP_OK;
+        CheckWrite(err, dirty, failed);
+    }
+
+    Lock();
+    if (failed) {
+        mDirty |= failed;
+        if (failed & DirtyCheckList) {
+            mCheckDirtyChunks |= chunks;
+        }
+        mWriteErrors++;
+    }
+    if (bCommit) {
+        mCommits++;
+        ESP_LOGD(TAG, "[ NVS ] commit, %d requests, %d commits saved", mCommitRequests, GetCommitsSaved());
+    }
+    Unlock();
+    xSemaphoreGive(mWriteMutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a failed write of a dirty group is logged, its bits are kept for the retry
+void NVSWebRadio::CheckWrite(esp_err_t err, uint32_t group, uint32_t& failed)
+{
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[ NVS ] Write of dirty 0x%x failed (%s), retried with the next commit", group, esp_err_to_name(err));
+        failed |= group;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Station list blob
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::ReadStations()
+{
+    size_t length = sizeof(mBlobBuffer);
+    esp_err_t err = nvs_get_blob(mMyHandle, LYRAT_NVS_STATIONS, mBlobBuffer, &length);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        MigrateStations();
+        return;
+    }
+
+    bool bOk = (err == ESP_OK) && ParseStations(mBlobBuffer, length, mSettings.mActTune, mSettings.mStations);
+
+    if (!bOk) {
+        ESP_LOGE(TAG, "[ NVS ] Station list corrupt (%s), use default stations", esp_err_to_name(err));
+        Station_t station0(DEFAULT_STATION0);
+        Station_t station1(DEFAULT_STATION1);
+        mSettings.mStations.clear();
+        mSettings.mStations.push_back(station0);
+        mSettings.mStations.push_back(station1);
+        mSettings.mActTune = station0;
+        MarkDirty(DirtyStations);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t NVSWebRadio::WriteStations()
+{
+    int count = 0;
+    Lock();
+    size_t length = SerializeStations(mBlobBuffer, sizeof(mBlobBuffer), mSettings.mActTune, mSettings.mStations, count);
+    int size = mSettings.mStations.size();
+    Unlock();
+
+    if (length == 0) {
+        ESP_LOGE(TAG, "[ NVS ] Act tune does not fit into station list");
+        return ESP_OK; // can not be written, no retry
+    }
+    if (count < size) {
+        ESP_LOGE(TAG, "[ NVS ] Station list full, only %d of %d stations stored", count, size);
+    }
+
+    return nvs_set_blob(mMyHandle, LYRAT_NVS_STATIONS, mBlobBuffer, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// one-time conversion of the old layout (st_id<N>, st_url<N>, st_decoder<N>, max)
+void NVSWebRadio::MigrateStations()
+{
     int i = -1;
     Station_t station;
 
-    while (GetStation(i, station)) {
+    mSettings.mStations.clear();
+    while (ReadLegacyStation(i, station)) {
         if (i == -1) {
-            set.mActTune = station;
+            mSettings.mActTune = station;
         }
         else {
-            set.mStations.push_back(station);
+            mSettings.mStations.push_back(station);
         }
         i++;
     }
 
-    GetValue(LYRAT_NET_RADIO, set.mRadioName);
-    set.mVolume = GetValue(LYRAT_NET_VOLUME);
-    set.mActStation = GetValue(LYRAT_NET_ACTSTATION);
+    if (i == -1) {
+        return; // nothing stored yet (first start)
+    }
+
+    ESP_LOGI(TAG, "[ NVS ] Migrate %d stations to station list blob", mSettings.mStations.size());
+    esp_err_t err = WriteStations();
+    if (err == ESP_OK) {
+        err = nvs_commit(mMyHandle);
+    }
+    if (err != ESP_OK) {
+        // the old keys stay until the blob is in flash
+        ESP_LOGE(TAG, "[ NVS ] Migration of the station list failed (%s)", esp_err_to_name(err));
+        MarkDirty(DirtyStations);
+        return;
+    }
+
+    for (int n = -1; n < i; n++) {
+        char key[32];
+        sprintf(key, "%s%d", LYRAT_NET_ST_ID, n);
+        nvs_erase_key(mMyHandle, key);
+        sprintf(key, "%s%d", LYRAT_NET_ST_URL, n);
+        nvs_erase_key(mMyHandle, key);
+        sprintf(key, "%s%d", LYRAT_NET_ST_DECODER, n);
+        nvs_erase_key(mMyHandle, key);
+    }
+    nvs_erase_key(mMyHandle, LYRAT_NVS_MAXSTATION);
+    nvs_commit(mMyHandle); // left over keys are erased with the next commit
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-bool NVSWebRadio::GetStation(int i, Station_t& station)
+bool NVSWebRadio::ReadLegacyStation(int i, Station_t& station)
 {
     char key[32];
     sprintf(key, "%s%d", LYRAT_NET_ST_ID, i);
@@ -369,19 +802,113 @@ bool NVSWebRadio::GetStation(int i, Station_t& station)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::GetCredentials(Credentials_t& credentials)
+// Check list ring
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::ReadCheckedStations()
 {
-    // credentials
-    GetValue(LYRAT_NET_RADIOSSID, credentials.mSSID);
-    GetValue(LYRAT_NET_RADIOPASSWD, credentials.mPassword);
+    uint32_t header = 0;
+    esp_err_t err = nvs_get_u32(mMyHandle, LYRAT_NVS_CHECKRING, &header);
+
+    mCheckList.Clear();
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        MigrateCheckedStations();
+        return;
+    }
+
+    for (int chunk = 0; err == ESP_OK && chunk < LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK; chunk++) {
+        char key[16];
+        size_t length = LYRAT_NVS_CHECK_CHUNK * sizeof(CheckRecord_t);
+        sprintf(key, LYRAT_NVS_CHECKCHUNK, chunk);
+        err = nvs_get_blob(mMyHandle, key, mCheckList.Chunk(chunk), &length);
+        if (err == ESP_OK && length != LYRAT_NVS_CHECK_CHUNK * sizeof(CheckRecord_t)) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        }
+    }
+
+    if (err == ESP_OK) {
+        mCheckList.SetHeader(header);
+    }
+    else {
+        ESP_LOGE(TAG, "[ NVS ] Check list corrupt (%s), start with empty list", esp_err_to_name(err));
+        mCheckList.Clear();
+        mCheckDirtyChunks = (1 << (LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK)) - 1;
+        MarkDirty(DirtyCheckList);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-bool NVSWebRadio::EmptyCredentials()
+// each dirty chunk is copied to mBlobBuffer under the lock; chunks returns the taken chunks,
+// they are dirty again if the write-back fails
+esp_err_t NVSWebRadio::WriteCheckedStations(uint32_t& chunks)
+{
+    const size_t size = LYRAT_NVS_CHECK_CHUNK * sizeof(CheckRecord_t);
+    static_assert(size <= sizeof(mBlobBuffer), "check list chunk does not fit the blob buffer");
+
+    for (int chunk = 0; chunk < LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK; chunk++) {
+        Lock();
+        bool bDirty = (mCheckDirtyChunks & (1 << chunk)) != 0;
+        mCheckDirtyChunks &= ~(1 << chunk);
+        if (bDirty) {
+            memcpy(mBlobBuffer, mCheckList.Chunk(chunk), size);
+            chunks |= 1 << chunk;
+        }
+        Unlock();
+
+        if (bDirty) {
+            char key[16];
+            sprintf(key, LYRAT_NVS_CHECKCHUNK, chunk);
+            esp_err_t err = nvs_set_blob(mMyHandle, key, mBlobBuffer, size);
+            if (err != ESP_OK) {
+                return err; // the chunks behind were not taken and are still dirty
+            }
+        }
+    }
+
+    Lock();
+    uint32_t header = mCheckList.GetHeader();
+    Unlock();
+    return nvs_set_u32(mMyHandle, LYRAT_NVS_CHECKRING, header);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// one-time conversion of the old 'uuid,result;' string, e.g. '78012206-1aa1-11e9-a80b-52543be04c81,2;'
+void NVSWebRadio::MigrateCheckedStations()
 {
-    Credentials_t credentials;
-    GetCredentials(credentials);
-    return credentials.mSSID.length() == 0;
+    const char* pStations = GetString(LYRAT_NVS_CHECKLIST);
+
+    if (pStations != NULL) {
+        std::string stations(pStations);
+        // newest entry is first in the string, add oldest first
+        std::string::size_type end = stations.size();
+
+        while (end > 0) {
+            std::string::size_type pos = (end >= 2) ? stations.rfind(';', end - 2) : std::string::npos;
+            pos = (pos == std::string::npos) ? 0 : pos + 1;
+            std::string entry(stations.substr(pos, end - pos));
+
+            std::string::size_type pos2 = entry.find(',');
+            if (pos2 != std::string::npos) {
+                Station_t station;
+                station.mId = entry.substr(0, pos2);
+                std::string resString = entry.substr(pos2 + 1, 1);
+                CheckListResult res = CheckListResult::Undefined;
+                if (resString == "1") {
+                    res = CheckListResult::Invalid;
+                }
+                else if (resString == "2") {
+                    res = CheckListResult::Valid;
+                }
+                AddCheckedStation(station, res);
+            }
+            end = pos;
+        }
+
+        ESP_LOGI(TAG, "[ NVS ] Migrate %d entries to check list ring", mCheckList.Size());
+        nvs_erase_key(mMyHandle, LYRAT_NVS_CHECKLIST);
+    }
+
+    mCheckDirtyChunks = (1 << (LYRAT_NVS_CHECK_CAPACITY / LYRAT_NVS_CHECK_CHUNK)) - 1;
+    MarkDirty(DirtyCheckList);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -424,51 +951,46 @@ int NVSWebRadio::GetValue(const char* pKey)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetValue(const char* pKey, int i32Value)
-{
-    esp_err_t err = nvs_set_i32(mMyHandle, pKey, i32Value);
-    ESP_ERROR_CHECK(err);
-
-    // Commit written value.
-    // After setting any values, nvs_commit() must be called to ensure changes are written
-    // to flash storage. Implementations may write to storage at other times,
-    // but this is not guaranteed.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
-}
-
-///////////////////////////////////////////////////////////////////////////////
-bool NVSWebRadio::GetValue(const char* pKey, std::string& retValue)
+const char* NVSWebRadio::GetString(const char* pKey)
 {
     size_t length = sizeof(mStaticBuffer);
     esp_err_t err = nvs_get_str(mMyHandle, pKey, mStaticBuffer, &length);
 
     switch (err) {
     case ESP_OK:
-        retValue = mStaticBuffer;
-        return true;
+        return mStaticBuffer;
         break;
     case ESP_ERR_NVS_NOT_FOUND:
         printf("The value is not initialized yet! %s\n", pKey);
-        retValue = "";
         break;
     default:
         ESP_ERROR_CHECK(err);
     }
 
-    return false;
+    return NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void NVSWebRadio::SetValue(const char* pKey, std::string& Value)
+// Station statistics
+///////////////////////////////////////////////////////////////////////////////
+void NVSWebRadio::ReadStationStats()
 {
-    esp_err_t err = nvs_set_str(mMyHandle, pKey, Value.c_str());
-    ESP_ERROR_CHECK(err);
+    size_t length = sizeof(mBlobBuffer);
+    esp_err_t err = nvs_get_blob(mMyHandle, LYRAT_NVS_STATS, mBlobBuffer, &length);
 
-    // Commit written value.
-    // After setting any values, nvs_commit() must be called to ensure changes are written
-    // to flash storage. Implementations may write to storage at other times,
-    // but this is not guaranteed.
-    err = nvs_commit(mMyHandle);
-    ESP_ERROR_CHECK(err);
+    if (err == ESP_OK && !mStats.Parse(mBlobBuffer, length)) {
+        ESP_LOGE(TAG, "[ NVS ] Station statistics corrupt, start with empty table");
+    }
+    else if (err != ESP_OK) {
+        mStats.Clear();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+esp_err_t NVSWebRadio::WriteStationStats()
+{
+    Lock();
+    size_t length = mStats.Serialize(mBlobBuffer, sizeof(mBlobBuffer));
+    Unlock();
+    return nvs_set_blob(mMyHandle, LYRAT_NVS_STATS, mBlobBuffer, length);
 }
@@ -13,44 +13,48 @@
 #ifndef _NVSWEBRADIO_H_
 #define _NVSWEBRADIO_H_
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
 #include "data_json_interface.h"
+#include "NVSCodec.h"
 
 // max 15 characters for id's        123456789012345
 #define LYRAT_NVS_RESTART_NOROUTER "norouter"
 #define LYRAT_NVS_MAXSTATION "max"
 #define LYRAT_NVS_CHECKLIST "checklist"
+#define LYRAT_NVS_STATIONS "stations"
+#define LYRAT_NVS_CHECKRING "chk_ring"
+#define LYRAT_NVS_CHECKCHUNK "chk_%d"
+#define LYRAT_NVS_STATS "st_stats"
+
+#define LYRAT_NVS_STATIONS_MAX_SIZE 4000
+
+// NVS space budget of the nvs partition (0x4000, partitions.csv): 4 pages of 126 entries with
+// 32 bytes, one page stays free for the garbage collection, 3 * 4032 = 12096 bytes hold data.
+// Each value takes one entry, strings and blobs add their data in 32 byte spans:
+//   station list blob, LYRAT_NVS_STATIONS_MAX_SIZE            <= 4032
+//   check list, 3 chunks of 1088 bytes and the ring header       3392
+//   station statistics, 8 + 32 * 28 bytes                         960
+//   credentials, name, bluetooth pair, counters                   640
+//   wifi driver data (namespace nvs.net80211)                 ~  1500
+//   sum                                                       ~ 10500
+// A rewrite stores the new value before the old one is erased, the remaining ~1500 bytes
+// are the room for it. That covers every value except a station list near its maximum,
+// whose rewrite can fail with ESP_ERR_NVS_NOT_ENOUGH_SPACE. A failed value is logged and
+// stays dirty, the next commit retries it; the old value stays valid in flash and all other
+// values are committed. The blob is written last, after the small counters.
+
+// commit scheduler, changes are written after a quiet period
+#define LYRAT_NVS_COMMIT_QUIET_MS 2000
+#define LYRAT_NVS_COMMIT_MAX_DELAY_MS 10000
+#define LYRAT_NVS_COMMIT_TASK_STACK 3072
 
 #define DEFAULT_STATION0 	"9605ae29-0601-11e8-ae97-52543be04c81", "http://stream.lohro.de:8000/lohro", "MP3"
 #define DEFAULT_STATION1 	"960c5b08-0601-11e8-ae97-52543be04c81", "http://swr-swr1-bw.cast.addradio.de/swr/swr1/bw/mp3/128/stream.mp3", "MP3"
 
-//////////////////////////////////////////////////////////////////////
-enum CheckListResult {
-    Undefined,
-    Invalid,
-    Valid
-};
-
-//////////////////////////////////////////////////////////////////////
-typedef struct
-    {
-    std::string mId;
-    CheckListResult mResult;
-
-    const char* ResultString()
-    {
-        switch (mResult) {
-        case CheckListResult::Undefined:
-            return "Undefined";
-        case CheckListResult::Invalid:
-            return "Invalid";
-        case CheckListResult::Valid:
-            return "Valid";
-        default:
-            return "Unknown";
-        }
-    }
-} CheckListEntry_t;
-
 //////////////////////////////////////////////////////////////////////
 class NVSWebRadio {
 public:
@@ -60,37 +64,142 @@ public:
     void ResetRestartNoRooter(); // reset no-network counter
     int GetRestartCount(); //
 
-    void SetCredentials(Credentials_t& cr);
-    void SetBluetooth(Bluetooth_t& bt);
-    void SetStation(int index, Station_t& st, int maxStation = 0);
-    void SetName(std::string& name);
+    void SetCredentials(const Credentials_t& cr);
+    void SetBluetooth(const Bluetooth_t& bt);
+    void SetStation(int index, const Station_t& st, int maxStation = 0); // maxStation is limited to LYRAT_MAX_STATIONS
+    void SetName(const char* pName);
     void SetVolume(int volume);
     void SetActStation(int actStation);
+    int RemoveStation(const char* pId); // index of the removed preset, -1 if no preset has this id
 
-    void IncStationCheck(Station_t& station, CheckListResult result); // increment reset counter, set station status
-    void GetCheckedStations(std::vector<CheckListEntry_t>& retList);
+    void IncStationCheck(const Station_t& station, CheckListResult result); // increment reset counter, set station status
+    int GetCheckedStationCount();
+    bool GetCheckedStation(int i, char* id, CheckListResult& result); // newest is 0, id with 37 bytes
+    CheckListResult GetStationCheck(const char* pId); // Undefined if not in the list
 
+    // statistics are written with the next commit, they don't schedule one on their own
+    void AddStationStats(const char* pId, StatsEvent_e event, int value = 0);
+    int GetStationStatsCount();
+    bool GetStationStats(int i, char* id, StationStats_t& stats); // most recently played is 0, id with 37 bytes
+
+    void Flush(); // write pending changes now (e.g. before restart)
+    int GetCommitsSaved(); // number of commits saved by the scheduler
+    int GetWriteErrors() { return mWriteErrors; } // write-backs with a failed value, it is retried
+    TaskHandle_t GetCommitTask() { return mCommitTask; }
+
+    // reads copy single values, the complete settings are only accessed through a SettingsView
     bool GetStation(int i, Station_t& station);
-    void GetSettings(Settings_t& settings);
+    int GetPlayStation(Station_t& station); // act station or act tune, returns its index (-1 act tune)
+    int GetStationCount();
+    int FindStation(const char* pId); // preset index, -1 if no preset has this id
+    int GetActStation();
+    int GetVolume();
     void GetCredentials(Credentials_t& credentials);
+    void GetName(RadioName_t& name);
     bool EmptyCredentials();
 
+    // read access to the settings cache without a copy, locked while the view exists
+    class SettingsView {
+    public:
+        SettingsView(NVSWebRadio& nvs)
+            : mNvs(nvs)
+        {
+            mNvs.Lock();
+        }
+        ~SettingsView() { mNvs.Unlock(); }
+        SettingsView(const SettingsView&) = delete;
+        const Settings_t* operator->() const { return &mNvs.mSettings; }
+        const Settings_t& operator*() const { return mNvs.mSettings; }
+
+    private:
+        NVSWebRadio& mNvs;
+    };
+
     // functions
 private:
     void IncRestartNoRooter(); // increase variable to detect unreachable network
-    void AddCheckedStation(Station_t& st, CheckListResult result);
+    void AddCheckedStation(const Station_t& st, CheckListResult result);
+
+    // settings cache, all reads are served from RAM, writes are tracked dirty and written back
+private:
+    enum Dirty_e {
+        DirtyCredentials = 1 << 0,
+        DirtyBluetooth = 1 << 1,
+        DirtyStations = 1 << 2,
+        DirtyActTune = 1 << 3,
+        DirtyName = 1 << 4,
+        DirtyVolume = 1 << 5,
+        DirtyActStation = 1 << 6,
+        DirtyCheckCount = 1 << 7,
+        DirtyCheckList = 1 << 8,
+        DirtyRestartCount = 1 << 9,
+        DirtyStats = 1 << 10,
+    };
+
+    void LoadSettings(); // fill cache from flash (once in Initialize)
+    void MarkDirty(uint32_t dirty);
+    void ScheduleCommit(); // write back after a quiet period
+    void WriteBack(); // write all dirty values to flash and commit, without holding the lock
+    void CheckWrite(esp_err_t err, uint32_t group, uint32_t& failed);
+    static void nvs_commit_task(void* pvParameters);
+    void ReadStations(); // act tune and presets from one blob
+    esp_err_t WriteStations();
+    void MigrateStations(); // one-time conversion of the per-key layout
+    bool ReadLegacyStation(int i, Station_t& station);
+    void ReadCheckedStations();
+    esp_err_t WriteCheckedStations(uint32_t& chunks);
+    void MigrateCheckedStations(); // one-time conversion of the 'uuid,result;' string
+    void ReadStationStats();
+    esp_err_t WriteStationStats();
+
+    void Lock() { xSemaphoreTakeRecursive(mMutex, portMAX_DELAY); }
+    void Unlock() { xSemaphoreGiveRecursive(mMutex); }
+
+    // values of one write-back, copied under the lock and written without it
+    typedef struct {
+        Credentials_t mCredentials;
+        Bluetooth_t mBluetooth;
+        RadioName_t mRadioName;
+        int mVolume;
+        int mActStation;
+        int mCheckCount;
+        int mRestartCount;
+    } WriteValues_t;
 
 private:
     bool ExistsValue(const char* pKey);
     int GetValue(const char* pKey);
-    void SetValue(const char* pKey, int i32Value);
-    bool GetValue(const char* pKey, std::string& retValue);
-    void SetValue(const char* pKey, std::string& Value);
+    const char* GetString(const char* pKey); // in mStaticBuffer, NULL if not found
+    template <size_t N>
+    bool GetValue(const char* pKey, FixedString<N>& retValue)
+    {
+        const char* pValue = GetString(pKey);
+        retValue = pValue ? pValue : "";
+        return pValue != NULL;
+    }
 
     // variables
 private:
     static char mStaticBuffer[512];
+    static uint8_t mBlobBuffer[LYRAT_NVS_STATIONS_MAX_SIZE]; // used under mWriteMutex after Initialize
     nvs_handle mMyHandle;
+
+    SemaphoreHandle_t mMutex;      // settings cache
+    SemaphoreHandle_t mWriteMutex; // one writer at a time, taken before mMutex
+    WriteValues_t mWriteValues;
+    uint32_t mDirty;
+    Settings_t mSettings;
+    StationIndex mStationIndex; // of mSettings.mStations
+    CheckListRing mCheckList;
+    uint32_t mCheckDirtyChunks;
+    StationStatsTable mStats;
+    int mRestartCount;
+    int mCheckCount;
+
+    TaskHandle_t mCommitTask;
+    int mCommitRequests;
+    int mCommits;
+    int mWriteErrors;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
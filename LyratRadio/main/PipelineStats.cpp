@@ -0,0 +1,75 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include "PipelineStats.h"
+
+#define KB 1024
+#define MS 1000 // us
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::Total_t::Add(uint32_t value, uint32_t unit)
+{
+    value += mRest;
+    mRest = value % unit;
+    if (value >= unit) {
+        mTotal.fetch_add(value / unit, std::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::AddRead(Stage_e stage, size_t bytes, uint32_t waitUs)
+{
+    mStages[stage].mBytesIn.Add(bytes, KB);
+    mStages[stage].mReadWait.Add(waitUs, MS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::AddWrite(Stage_e stage, size_t bytes, uint32_t waitUs)
+{
+    mStages[stage].mBytesOut.Add(bytes, KB);
+    mStages[stage].mWriteWait.Add(waitUs, MS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::AddProcess(Stage_e stage, uint32_t us)
+{
+    mStages[stage].mProcess.Add(us, MS);
+    mStages[stage].mChunks.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PipelineStats::AddUnderrun(Stage_e stage)
+{
+    mStages[stage].mUnderruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the counters are read one by one, they may be a chunk apart
+void PipelineStats::Get(Stage_e stage, Counters_t& counters) const
+{
+    const Stage_t& s = mStages[stage];
+    counters.mKbIn = s.mBytesIn.Get();
+    counters.mKbOut = s.mBytesOut.Get();
+    counters.mReadWaitMs = s.mReadWait.Get();
+    counters.mWriteWaitMs = s.mWriteWait.Get();
+    counters.mProcessMs = s.mProcess.Get();
+    counters.mChunks = s.mChunks.load(std::memory_order_relaxed);
+    counters.mUnderruns = s.mUnderruns.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* PipelineStats::GetName(Stage_e stage)
+{
+    static const char* names[StageCount] = { "http", "decoder", "resample", "gain", "i2s" };
+    return (stage < StageCount) ? names[stage] : "unknown";
+}
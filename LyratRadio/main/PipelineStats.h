@@ -0,0 +1,99 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _PIPELINESTATS_H_
+#define _PIPELINESTATS_H_
+
+// Counters per pipeline stage, written from the element tasks without locks
+// and read at any time from the control side. Each counter has one writing
+// task; totals are kept in KiB and ms so they don't wrap for weeks, a client
+// computes rates from the difference of two samples.
+// No ESP-IDF dependencies, times are in us.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+//////////////////////////////////////////////////////////////////////
+class PipelineStats {
+public:
+    enum Stage_e {
+        Http,     // socket read, write into the decoder ring buffer
+        Decoder,  // measured by the pcm element behind it (no hook in the adf decoders)
+        Resample,
+        Gain,
+        I2s,      // measured by the element in front of it
+        StageCount,
+    };
+
+    typedef struct {
+        uint32_t mKbIn;
+        uint32_t mKbOut;
+        uint32_t mReadWaitMs;  // blocked on input (socket, ring buffer)
+        uint32_t mWriteWaitMs; // blocked on a full output ring buffer
+        uint32_t mProcessMs;   // Decoder: wait for decoded data
+        uint32_t mChunks;
+        uint32_t mUnderruns;   // input ran empty, I2s: dma starvation
+    } Counters_t;
+
+public:
+    PipelineStats() {}
+
+    // processing side
+    void AddRead(Stage_e stage, size_t bytes, uint32_t waitUs);
+    void AddWrite(Stage_e stage, size_t bytes, uint32_t waitUs);
+    void AddProcess(Stage_e stage, uint32_t us); // counts a chunk
+    void AddUnderrun(Stage_e stage);
+
+    // control side
+    void Get(Stage_e stage, Counters_t& counters) const;
+    static const char* GetName(Stage_e stage);
+
+private:
+    // total in units, the remainder stays with the writing task
+    class Total_t {
+    public:
+        Total_t()
+            : mTotal(0)
+            , mRest(0)
+        {
+        }
+        void Add(uint32_t value, uint32_t unit);
+        uint32_t Get() const { return mTotal.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint32_t> mTotal;
+        uint32_t mRest;
+    };
+
+    typedef struct Stage {
+        Stage()
+            : mChunks(0)
+            , mUnderruns(0)
+        {
+        }
+        Total_t mBytesIn;
+        Total_t mBytesOut;
+        Total_t mReadWait;
+        Total_t mWriteWait;
+        Total_t mProcess;
+        std::atomic<uint32_t> mChunks;
+        std::atomic<uint32_t> mUnderruns;
+    } Stage_t;
+
+    Stage_t mStages[StageCount];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,214 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "Resampler.h"
+
+#define COEF_SHIFT 14
+#define FORMAT_BYPASS (1u << 24)
+
+///////////////////////////////////////////////////////////////////////////////
+Resampler::Resampler()
+    : mOutRate(44100)
+    , mTaps(0)
+    , mPhases(0)
+    , mpTable(NULL)
+    , mFormat(0)
+    , mApplied(0)
+    , mInRate(44100)
+    , mChannels(2)
+    , mbBypass(true)
+    , mAcc(0)
+    , mFill(0)
+    , mPos(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Resampler::~Resampler()
+{
+    delete[] mpTable;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Resampler::Initialize(int outRate, Quality_e quality)
+{
+    static const int taps[] = { 4, 8, 16 };
+    static const int phases[] = { 32, 64, 128 };
+
+    mOutRate = outRate;
+    mTaps = taps[quality];
+    mPhases = phases[quality];
+    delete[] mpTable;
+    mpTable = new int16_t[mTaps * mPhases];
+    mApplied = 0; // table is built with the first format
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Resampler::SetInputFormat(int sampleRate, int channels, int bits)
+{
+    uint32_t format = (uint32_t)(sampleRate & 0xfffff) | ((uint32_t)(channels & 0xf) << 20);
+    if (!IsSupported(bits) || sampleRate <= 0 || channels < 1 || channels > 2) {
+        format |= FORMAT_BYPASS;
+    }
+    mFormat.store(format, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t Resampler::MaxInputBytes(size_t bufferSize)
+{
+    uint32_t format = mFormat.load(std::memory_order_acquire);
+    if (format != mApplied) {
+        Configure(format);
+    }
+    if (mbBypass) {
+        return bufferSize;
+    }
+
+    // at most LYRAT_RESAMPLE_OUT_FRAMES - 1 output frames, one is left for the rounding
+    size_t frames = (size_t)((int64_t)(LYRAT_RESAMPLE_OUT_FRAMES - 2) * mInRate / mOutRate);
+    frames = std::min(std::max(frames, (size_t)1), (size_t)LYRAT_RESAMPLE_IN_FRAMES);
+    size_t frameSize = mChannels * sizeof(int16_t);
+    return std::min(frames * frameSize, bufferSize / frameSize * frameSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// new stream: the history starts with silence
+void Resampler::Configure(uint32_t format)
+{
+    mApplied = format;
+    mInRate = format & 0xfffff;
+    mChannels = (format >> 20) & 0xf;
+    mbBypass = (format & FORMAT_BYPASS) != 0 || mpTable == NULL;
+    mAcc = 0;
+    mPos = 0;
+    mFill = mTaps - 1;
+    memset(mWork, 0, sizeof(mWork));
+
+    if (!mbBypass && mInRate != mOutRate) {
+        BuildTable();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// blackman windowed sinc; phase p is the output position (p + 0.5) / mPhases after
+// input frame mTaps / 2 - 1, so taking the phase by truncation rounds to the nearest
+void Resampler::BuildTable()
+{
+    const double pi = 3.14159265358979323846;
+    double cutoff = std::min(1.0, (double)mOutRate / mInRate) * 0.95; // below the lower nyquist
+    double half = mTaps / 2;
+
+    for (int p = 0; p < mPhases; p++) {
+        double frac = (p + 0.5) / mPhases;
+        double h[LYRAT_RESAMPLE_MAX_TAPS];
+        double sum = 0;
+        for (int k = 0; k < mTaps; k++) {
+            double t = k - (half - 1) - frac;
+            double x = pi * cutoff * t;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+            double w = 0.42 + 0.5 * cos(pi * t / half) + 0.08 * cos(2 * pi * t / half);
+            h[k] = sinc * w;
+            sum += h[k];
+        }
+
+        // unity dc gain per phase, the rounding error goes to the largest tap
+        int16_t* pH = mpTable + p * mTaps;
+        int total = 0;
+        int largest = 0;
+        for (int k = 0; k < mTaps; k++) {
+            pH[k] = (int16_t)lround(h[k] / sum * (1 << COEF_SHIFT));
+            total += pH[k];
+            if (pH[k] > pH[largest]) {
+                largest = k;
+            }
+        }
+        pH[largest] += (1 << COEF_SHIFT) - total;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline int16_t Saturate(int32_t acc)
+{
+    acc = (acc + (1 << (COEF_SHIFT - 1))) >> COEF_SHIFT;
+    return (int16_t)std::min(32767, std::max(-32768, acc));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t Resampler::Process(const int16_t* pIn, size_t frames)
+{
+    int channels = mChannels;
+    frames = std::min(frames, (size_t)LYRAT_RESAMPLE_IN_FRAMES);
+
+    if (mInRate == mOutRate) {
+        // same rate, mono is doubled
+        frames = std::min(frames, (size_t)LYRAT_RESAMPLE_OUT_FRAMES);
+        if (channels == 2) {
+            memcpy(mOut, pIn, frames * 2 * sizeof(int16_t));
+        }
+        else {
+            for (size_t i = 0; i < frames; i++) {
+                mOut[2 * i] = mOut[2 * i + 1] = pIn[i];
+            }
+        }
+        return frames;
+    }
+
+    memcpy(mWork + mFill * channels, pIn, frames * channels * sizeof(int16_t));
+    mFill += frames;
+
+    size_t out = 0;
+    int16_t* pOut = mOut;
+    while (mPos + mTaps <= mFill && out < LYRAT_RESAMPLE_OUT_FRAMES) {
+        int phase = (int)((uint64_t)mAcc * mPhases / mOutRate);
+        const int16_t* pH = mpTable + phase * mTaps;
+        const int16_t* pX = mWork + mPos * channels;
+
+        if (channels == 2) {
+            int32_t left = 0;
+            int32_t right = 0;
+            for (int k = 0; k < mTaps; k++) {
+                left += pH[k] * pX[2 * k];
+                right += pH[k] * pX[2 * k + 1];
+            }
+            pOut[0] = Saturate(left);
+            pOut[1] = Saturate(right);
+        }
+        else {
+            int32_t acc = 0;
+            for (int k = 0; k < mTaps; k++) {
+                acc += pH[k] * pX[k];
+            }
+            pOut[0] = pOut[1] = Saturate(acc);
+        }
+        pOut += 2;
+        out++;
+
+        // exact rational step, in / out input frames per output frame
+        mAcc += mInRate;
+        while (mAcc >= (uint32_t)mOutRate) {
+            mAcc -= mOutRate;
+            mPos++;
+        }
+    }
+
+    // keep the frames the next outputs still need
+    size_t keep = (mPos < mFill) ? mFill - mPos : 0;
+    memmove(mWork, mWork + (mFill - keep) * channels, keep * channels * sizeof(int16_t));
+    mFill = keep;
+    mPos = 0;
+    return out;
+}
@@ -0,0 +1,88 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _RESAMPLER_H_
+#define _RESAMPLER_H_
+
+// Converts 16 bit pcm of any rate to one fixed output rate, always stereo, so
+// the i2s clock is set once per session. Polyphase fir: windowed sinc with
+// Q14 coefficients, the phase is taken from an exact rational position, so
+// there is no drift. The input format is handed over from the control side
+// in one atomic word; the element task rebuilds the table on a change.
+// No ESP-IDF dependencies.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define LYRAT_RESAMPLE_MAX_TAPS 16
+#define LYRAT_RESAMPLE_IN_FRAMES 256  // max input per Process() call
+#define LYRAT_RESAMPLE_OUT_FRAMES 512 // output buffer, stereo
+
+//////////////////////////////////////////////////////////////////////
+class Resampler {
+public:
+    enum Quality_e {
+        Low,    //  4 taps,  32 phases
+        Medium, //  8 taps,  64 phases
+        High,   // 16 taps, 128 phases
+    };
+
+    Resampler();
+    ~Resampler();
+
+    // control side, before the element runs
+    void Initialize(int outRate, Quality_e quality);
+    int GetOutRate() const { return mOutRate; }
+    // from music info; input that is not 16 bit passes unchanged
+    void SetInputFormat(int sampleRate, int channels, int bits);
+    static bool IsSupported(int bits) { return bits == 16; }
+
+    // processing side
+    // takes over a new input format; bytes of whole frames to read so that the output
+    // fits into the output buffer, bufferSize if the input passes unchanged
+    size_t MaxInputBytes(size_t bufferSize);
+    bool IsBypass() const { return mbBypass; }
+    int GetInChannels() const { return mChannels; }
+    // consumes all input frames, returns the number of stereo frames in GetOutput()
+    size_t Process(const int16_t* pIn, size_t frames);
+    const int16_t* GetOutput() const { return mOut; }
+
+private:
+    void Configure(uint32_t format);
+    void BuildTable();
+
+private:
+    int mOutRate;
+    int mTaps;
+    int mPhases;
+    int16_t* mpTable; // mPhases * mTaps, Q14
+
+    // handover: rate (bits 0..19), channels (bits 20..23), bypass (bit 24)
+    std::atomic<uint32_t> mFormat;
+
+    // processing side
+    uint32_t mApplied;
+    int mInRate;
+    int mChannels;
+    bool mbBypass;
+    uint32_t mAcc;   // position between two input frames, in 1/mOutRate
+    size_t mFill;    // frames in mWork
+    size_t mPos;     // next input frame in mWork
+    int16_t mWork[(LYRAT_RESAMPLE_MAX_TAPS + LYRAT_RESAMPLE_IN_FRAMES) * 2];
+    int16_t mOut[LYRAT_RESAMPLE_OUT_FRAMES * 2];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
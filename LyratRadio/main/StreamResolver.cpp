@@ -0,0 +1,431 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+
+#include "StreamResolver.h"
+
+extern const char* TAG;
+
+char StreamResolver::mBuffer[LYRAT_RESOLVER_PLAYLIST_SIZE + 1];
+
+///////////////////////////////////////////////////////////////////////////////
+StreamResolver::StreamResolver()
+    : mMutex(NULL)
+    , mHttpMutex(NULL)
+    , mNext(0)
+    , mTask(NULL)
+    , mDone(NULL)
+    , mpDoneContext(NULL)
+    , mbRequest(false)
+    , mbRequestProbe(false)
+    , mbActive(false)
+    , mbActiveProbe(false)
+{
+    for (int i = 0; i < LYRAT_RESOLVER_CACHE; i++) {
+        mCache[i].mExpires = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StreamResolver::Start(Done_t done, void* pContext)
+{
+    mMutex = xSemaphoreCreateMutex();
+    mHttpMutex = xSemaphoreCreateMutex();
+    mDone = done;
+    mpDoneContext = pContext;
+    xTaskCreate(resolver_task, "resolver", LYRAT_RESOLVER_TASK_STACK, this, 1, &mTask);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StreamResolver::Resolve(const Station_t& station, bool bProbe, Stream_t& stream)
+{
+    if (Lookup(station, bProbe, stream)) {
+        return;
+    }
+
+    xSemaphoreTake(mHttpMutex, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    stream.mUrl = station.mUrl.c_str();
+    stream.mDecoder.clear();
+    stream.mMetaInt = 0;
+    bool bResolved = ResolveUrl(stream, bProbe);
+    int64_t end = esp_timer_get_time();
+    xSemaphoreGive(mHttpMutex);
+
+    if (!bResolved) {
+        // not again with every switch and reconnect, the reader may still get through
+        ESP_LOGW(TAG, "[ resolve ] '%s' failed after %d ms, played as is", station.mUrl.c_str(), (int)((end - start) / 1000));
+        stream.mUrl = station.mUrl.c_str();
+        stream.mDecoder.clear();
+        stream.mMetaInt = 0;
+        Store(station, bProbe, stream, end + LYRAT_RESOLVER_FAILED_TTL_US);
+        return;
+    }
+    ESP_LOGI(TAG, "[ resolve ] '%s' -> '%s' (%s, metaint %d) in %d ms", station.mUrl.c_str(), stream.mUrl.c_str(),
+        stream.mDecoder.empty() ? "-" : stream.mDecoder.c_str(), stream.mMetaInt, (int)((end - start) / 1000));
+    Store(station, bProbe, stream, end + LYRAT_RESOLVER_TTL_US);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool StreamResolver::Lookup(const Station_t& station, bool bProbe, Stream_t& stream)
+{
+    int64_t now = esp_timer_get_time();
+    bool bFound = false;
+
+    Lock();
+    for (int i = 0; i < LYRAT_RESOLVER_CACHE && !bFound; i++) {
+        const CacheEntry_t& entry = mCache[i];
+        if (entry.mExpires > now && entry.mId == station.mId && entry.mSourceUrl == station.mUrl && (!bProbe || entry.mbProbed)) {
+            stream = entry.mStream;
+            bFound = true;
+        }
+    }
+    Unlock();
+    return bFound;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the entry of the station is replaced, otherwise the oldest one
+void StreamResolver::Store(const Station_t& station, bool bProbe, const Stream_t& stream, int64_t expires)
+{
+    Lock();
+    int slot = mNext;
+    for (int i = 0; i < LYRAT_RESOLVER_CACHE; i++) {
+        if (mCache[i].mExpires != 0 && mCache[i].mId == station.mId) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == mNext) {
+        mNext = (mNext + 1) % LYRAT_RESOLVER_CACHE;
+    }
+
+    CacheEntry_t& entry = mCache[slot];
+    entry.mId = station.mId;
+    entry.mSourceUrl = station.mUrl;
+    entry.mStream = stream;
+    entry.mbProbed = bProbe;
+    entry.mExpires = expires;
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StreamResolver::Invalidate(const char* pId)
+{
+    Lock();
+    for (int i = 0; i < LYRAT_RESOLVER_CACHE; i++) {
+        if (mCache[i].mExpires != 0 && mCache[i].mId == pId) {
+            ESP_LOGI(TAG, "[ resolve ] cached url of %s invalidated", pId);
+            mCache[i].mExpires = 0;
+        }
+    }
+    Unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Resolver task
+///////////////////////////////////////////////////////////////////////////////
+void StreamResolver::Request(const Station_t& station, bool bProbe)
+{
+    Lock();
+    // the same station is already on its way, a request behind it is no longer wanted
+    bool bActive = mbActive && mActive.mId == station.mId && mActive.mUrl == station.mUrl && (mbActiveProbe || !bProbe);
+    mRequest = station;
+    mbRequestProbe = bProbe;
+    mbRequest = !bActive;
+    Unlock();
+
+    if (!bActive) {
+        xTaskNotifyGive(mTask);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool StreamResolver::TakeRequest(Station_t& station, bool& bProbe)
+{
+    Lock();
+    bool bRequest = mbRequest;
+    mbRequest = false;
+    mbActive = bRequest;
+    if (bRequest) {
+        mActive = mRequest;
+        mbActiveProbe = mbRequestProbe;
+        station = mActive;
+        bProbe = mbActiveProbe;
+    }
+    Unlock();
+    return bRequest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the result is in the cache before done is called
+void StreamResolver::resolver_task(void* pvParameters)
+{
+    StreamResolver* pResolver = (StreamResolver*)pvParameters;
+    Station_t station;
+    Stream_t stream;
+    bool bProbe;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (pResolver->TakeRequest(station, bProbe)) {
+            pResolver->Resolve(station, bProbe, stream);
+            pResolver->Lock();
+            pResolver->mbActive = false;
+            pResolver->Unlock();
+            pResolver->mDone(pResolver->mpDoneContext);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool ContainsNoCase(const char* pText, const char* pPattern)
+{
+    size_t length = strlen(pPattern);
+    for (; *pText; pText++) {
+        if (strncasecmp(pText, pPattern, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+    std::string mContentType;
+    int mMetaInt;
+} ResponseHeaders_t;
+
+///////////////////////////////////////////////////////////////////////////////
+// captures the content type and metadata interval of the response
+static esp_err_t resolver_http_event(esp_http_client_event_t* evt)
+{
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+
+    ResponseHeaders_t* pHeaders = (ResponseHeaders_t*)evt->user_data;
+    if (strcasecmp(evt->header_key, "Content-Type") == 0) {
+        pHeaders->mContentType = evt->header_value;
+    }
+    else if (strcasecmp(evt->header_key, "icy-metaint") == 0) {
+        pHeaders->mMetaInt = atoi(evt->header_value);
+    }
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// returns false if the url could not be resolved (e.g. no connection)
+bool StreamResolver::ResolveUrl(Stream_t& stream, bool bProbe)
+{
+    std::string& url = stream.mUrl;
+    ResponseHeaders_t headers;
+    const std::string& contentType = headers.mContentType;
+
+    for (int hop = 0; hop < LYRAT_RESOLVER_MAX_HOPS; hop++) {
+        esp_http_client_config_t config = {};
+        config.url = url.c_str();
+        config.timeout_ms = LYRAT_RESOLVER_TIMEOUT_MS;
+        config.event_handler = resolver_http_event;
+        config.user_data = &headers;
+
+        headers.mContentType.clear();
+        headers.mMetaInt = 0;
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+        if (client == NULL) {
+            return false;
+        }
+        // same request as the http reader, the server announces the metadata interval
+        esp_http_client_set_header(client, "Icy-MetaData", "1");
+
+        bool bRc = false;
+        bool bNext = false;
+        if (esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+            int status = esp_http_client_get_status_code(client);
+
+            if (status >= 300 && status < 400 && esp_http_client_set_redirection(client) == ESP_OK) {
+                // url of the Location header
+                if (esp_http_client_get_url(client, mBuffer, sizeof(mBuffer)) == ESP_OK) {
+                    url = mBuffer;
+                    bNext = true;
+                }
+            }
+            else if (status == 200 && IsPlaylist(url, contentType)) {
+                int length = 0;
+                int len;
+                while (length < LYRAT_RESOLVER_PLAYLIST_SIZE
+                    && (len = esp_http_client_read(client, mBuffer + length, LYRAT_RESOLVER_PLAYLIST_SIZE - length)) > 0) {
+                    length += len;
+                }
+                mBuffer[length] = 0;
+                bNext = ParsePlaylist(mBuffer, url);
+            }
+            else if (status == 200) {
+                bRc = true; // audio stream
+                stream.mMetaInt = headers.mMetaInt;
+
+                if (bProbe) {
+                    int length = 0;
+                    int len;
+                    while (length < LYRAT_RESOLVER_PROBE_SIZE
+                        && (len = esp_http_client_read(client, mBuffer + length, LYRAT_RESOLVER_PROBE_SIZE - length)) > 0) {
+                        length += len;
+                    }
+                    const char* pDecoder = SniffDecoder(contentType, (const uint8_t*)mBuffer, length);
+                    stream.mDecoder = pDecoder ? pDecoder : "";
+                }
+            }
+            else {
+                ESP_LOGW(TAG, "[ resolve ] '%s' => http status %d", url.c_str(), status);
+            }
+        }
+        esp_http_client_cleanup(client);
+
+        if (!bNext) {
+            return bRc;
+        }
+    }
+
+    ESP_LOGW(TAG, "[ resolve ] more than %d redirects", LYRAT_RESOLVER_MAX_HOPS);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool StreamResolver::IsPlaylist(const std::string& url, const std::string& contentType)
+{
+    if (ContainsNoCase(contentType.c_str(), "scpls") || ContainsNoCase(contentType.c_str(), "mpegurl")) {
+        return true;
+    }
+
+    // extension of the path, without query
+    std::string path = url.substr(0, url.find('?'));
+    std::string::size_type dot = path.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot);
+    return strcasecmp(ext.c_str(), ".pls") == 0 || strcasecmp(ext.c_str(), ".m3u") == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pls: 'File1=http://...', m3u: one url per line, comments start with '#'
+bool StreamResolver::ParsePlaylist(const char* pContent, std::string& url)
+{
+    if (strstr(pContent, "#EXT-X-") != NULL) {
+        return false; // HLS segments, not a stream url
+    }
+
+    const char* pLine = pContent;
+    while (*pLine) {
+        const char* pEnd = pLine + strcspn(pLine, "\r\n");
+
+        const char* pUrl = pLine;
+        if (strncasecmp(pLine, "File", 4) == 0) {
+            const char* pEqual = (const char*)memchr(pLine, '=', pEnd - pLine);
+            pUrl = pEqual ? pEqual + 1 : pEnd;
+        }
+        while (pUrl < pEnd && (*pUrl == ' ' || *pUrl == '\t')) {
+            pUrl++;
+        }
+        const char* pUrlEnd = pEnd;
+        while (pUrlEnd > pUrl && (pUrlEnd[-1] == ' ' || pUrlEnd[-1] == '\t')) {
+            pUrlEnd--;
+        }
+
+        if (strncasecmp(pUrl, "http://", 7) == 0 || strncasecmp(pUrl, "https://", 8) == 0) {
+            url.assign(pUrl, pUrlEnd - pUrl);
+            return true;
+        }
+
+        pLine = pEnd + strspn(pEnd, "\r\n");
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoder detection
+///////////////////////////////////////////////////////////////////////////////
+// mpeg audio layer III header, returns the frame length or 0 if it is no valid header
+int StreamResolver::Mp3FrameLength(const uint8_t* pHeader)
+{
+    static const uint16_t bitrates[2][16] = {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 }, // mpeg 1
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }, // mpeg 2, 2.5
+    };
+    static const uint16_t samplerates[3] = { 44100, 48000, 32000 };
+
+    if (pHeader[0] != 0xff || (pHeader[1] & 0xe0) != 0xe0) {
+        return 0;
+    }
+    int version = (pHeader[1] >> 3) & 3; // 0: 2.5, 2: 2, 3: 1
+    int layer = (pHeader[1] >> 1) & 3; // 1: layer III
+    int bitrate = pHeader[2] >> 4;
+    int samplerate = (pHeader[2] >> 2) & 3;
+    if (version == 1 || layer != 1 || bitrate == 0 || bitrate == 15 || samplerate == 3) {
+        return 0;
+    }
+
+    int rate = samplerates[samplerate] >> ((version == 3) ? 0 : (version == 2) ? 1 : 2);
+    int padding = (pHeader[2] >> 1) & 1;
+    if (version == 3) {
+        return 144000 * bitrates[0][bitrate] / rate + padding;
+    }
+    return 72000 * bitrates[1][bitrate] / rate + padding;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// adts header, returns the frame length or 0 if it is no valid header
+int StreamResolver::AdtsFrameLength(const uint8_t* pHeader)
+{
+    if (pHeader[0] != 0xff || (pHeader[1] & 0xf6) != 0xf0 || ((pHeader[2] >> 2) & 0xf) > 12) {
+        return 0;
+    }
+    int length = ((pHeader[3] & 3) << 11) | (pHeader[4] << 3) | (pHeader[5] >> 5);
+    return (length >= 7) ? length : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// two consecutive frame headers are required, a single 0xfff pattern is too likely in data
+const char* StreamResolver::SniffDecoder(const std::string& contentType, const uint8_t* pData, size_t length)
+{
+    for (size_t i = 0; i + 6 <= length; i++) {
+        if (pData[i] != 0xff) {
+            continue;
+        }
+
+        int frame = Mp3FrameLength(pData + i);
+        if (frame > 0 && i + frame + 4 <= length && Mp3FrameLength(pData + i + frame) > 0) {
+            return "MP3";
+        }
+        frame = AdtsFrameLength(pData + i);
+        if (frame > 0 && i + frame + 6 <= length && AdtsFrameLength(pData + i + frame) > 0) {
+            return "AAC";
+        }
+    }
+
+    const char* pType = contentType.c_str();
+    if (ContainsNoCase(pType, "audio/mpeg") || ContainsNoCase(pType, "audio/mp3")) {
+        return "MP3";
+    }
+    if (ContainsNoCase(pType, "aac")) {
+        return "AAC";
+    }
+    return NULL;
+}
@@ -0,0 +1,113 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _STREAMRESOLVER_H_
+#define _STREAMRESOLVER_H_
+
+// Resolves a station url to the url of the audio stream: follows http redirects
+// and expands .pls/.m3u playlists. On request the stream is probed for its
+// decoder type. The icy-metaint of the stream is recorded, see IcyReader.
+// Results are cached per station id, also failed ones. The connections are made
+// in the resolver task, the audio event loop only looks up finished results.
+
+#include <stdint.h>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "data_json_interface.h"
+
+#define LYRAT_RESOLVER_CACHE 8
+#define LYRAT_RESOLVER_TTL_US (60 * 60 * 1000000LL) // 1 hour
+#define LYRAT_RESOLVER_FAILED_TTL_US (60 * 1000000LL) // the station url is played as is meanwhile
+#define LYRAT_RESOLVER_MAX_HOPS 5                   // redirects and nested playlists
+#define LYRAT_RESOLVER_TIMEOUT_MS 3000
+#define LYRAT_RESOLVER_PLAYLIST_SIZE 2048           // only the beginning of a playlist is read
+#define LYRAT_RESOLVER_PROBE_SIZE 2048              // stream bytes sniffed for frame headers
+#define LYRAT_RESOLVER_TASK_STACK 6144              // esp_http_client, also with tls
+
+//////////////////////////////////////////////////////////////////////
+class StreamResolver {
+public:
+    typedef struct {
+        std::string mUrl;     // the station url if it can't be resolved
+        std::string mDecoder; // "MP3", "AAC" or empty if unknown or not probed
+        int mMetaInt;         // metadata interval of the stream or 0
+    } Stream_t;
+
+    // called in the resolver task after each request
+    typedef void (*Done_t)(void* pContext);
+
+public:
+    StreamResolver();
+
+    void Start(Done_t done, void* pContext); // creates the resolver task
+    TaskHandle_t GetTask() { return mTask; }
+
+    // blocking, for the start of the pipeline; bProbe: sniff the decoder type
+    void Resolve(const Station_t& station, bool bProbe, Stream_t& stream);
+    // cached result of the station, false if it has to be requested
+    bool Lookup(const Station_t& station, bool bProbe, Stream_t& stream);
+    // resolves the station in the resolver task, a request that did not start yet is replaced
+    void Request(const Station_t& station, bool bProbe);
+    // connecting to the resolved url failed, resolve again next time
+    void Invalidate(const char* pId);
+
+    // playlist content to first stream url, false if there is none
+    static bool ParsePlaylist(const char* pContent, std::string& url);
+    // decoder from content type and mp3/adts frame headers, NULL if unknown
+    static const char* SniffDecoder(const std::string& contentType, const uint8_t* pData, size_t length);
+
+private:
+    typedef struct {
+        StationId_t mId;
+        StationUrl_t mSourceUrl; // station url at resolve time
+        Stream_t mStream;
+        bool mbProbed;    // the decoder type was sniffed (maybe without result)
+        int64_t mExpires; // us, 0 if the entry is unused
+    } CacheEntry_t;
+
+    void Store(const Station_t& station, bool bProbe, const Stream_t& stream, int64_t expires);
+    bool TakeRequest(Station_t& station, bool& bProbe); // false if there is none
+    static void resolver_task(void* pvParameters);
+    bool ResolveUrl(Stream_t& stream, bool bProbe);
+    static int Mp3FrameLength(const uint8_t* pHeader);
+    static int AdtsFrameLength(const uint8_t* pHeader);
+    static bool IsPlaylist(const std::string& url, const std::string& contentType);
+
+    void Lock() { xSemaphoreTake(mMutex, portMAX_DELAY); }
+    void Unlock() { xSemaphoreGive(mMutex); }
+
+private:
+    SemaphoreHandle_t mMutex;     // cache and request, not held while connected
+    SemaphoreHandle_t mHttpMutex; // one connection at a time, mBuffer
+    CacheEntry_t mCache[LYRAT_RESOLVER_CACHE];
+    int mNext; // next entry to replace
+
+    TaskHandle_t mTask;
+    Done_t mDone;
+    void* mpDoneContext;
+    Station_t mRequest;
+    bool mbRequest; // mRequest waits for the task
+    bool mbRequestProbe;
+    Station_t mActive; // being resolved
+    bool mbActive;
+    bool mbActiveProbe;
+
+    static char mBuffer[LYRAT_RESOLVER_PLAYLIST_SIZE + 1];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,239 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <algorithm>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "Telemetry.h"
+
+extern const char* TAG;
+
+// constant initialized, operator new is used before any constructor runs
+static std::atomic<uint32_t> sAllocs[Telemetry::SubsystemCount];
+static std::atomic<uint32_t> sFrees[Telemetry::SubsystemCount];
+static std::atomic<int32_t> sBytes[Telemetry::SubsystemCount];
+
+///////////////////////////////////////////////////////////////////////////////
+Telemetry::Telemetry()
+    : mMux(portMUX_INITIALIZER_UNLOCKED)
+    , mSampleTime(0)
+    , mTaskCount(0)
+{
+    mHeap.mFree = 0;
+    mHeap.mMinFree = 0;
+    mHeap.mLargest = 0;
+    mHeap.mMinLargest = UINT32_MAX;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Telemetry::AddTask(const char* pName, uint32_t stackSize, TaskHandle_t handle)
+{
+    portENTER_CRITICAL(&mMux);
+    for (int i = 0; i < mTaskCount; i++) {
+        if (strcmp(mTasks[i].mpName, pName) == 0) {
+            mTasks[i].mStackSize = stackSize; // restarted, the high-water mark is kept
+            mTasks[i].mHandle = handle;
+            portEXIT_CRITICAL(&mMux);
+            return;
+        }
+    }
+    if (mTaskCount < LYRAT_TELEMETRY_TASKS) {
+        Task_t& task = mTasks[mTaskCount++];
+        task.mpName = pName;
+        task.mStackSize = stackSize;
+        task.mHandle = handle;
+        task.mMinFree = -1;
+    }
+    portEXIT_CRITICAL(&mMux);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// element tasks are only deleted from the audio event loop, which also samples,
+// so a handle found by name stays valid for the high-water mark
+void Telemetry::Sample(int64_t now)
+{
+    if (mSampleTime != 0 && now - mSampleTime < LYRAT_TELEMETRY_PERIOD_MS * 1000LL) {
+        return;
+    }
+    mSampleTime = now;
+
+    Heap_t heap;
+    heap.mFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    heap.mMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    heap.mLargest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    heap.mMinLargest = std::min(mHeap.mMinLargest, heap.mLargest);
+    if (heap.mLargest < LYRAT_TELEMETRY_LOW_BLOCK && heap.mLargest < mHeap.mMinLargest) {
+        ESP_LOGW(TAG, "[ telemetry ] largest free block %d of %d free", heap.mLargest, heap.mFree);
+    }
+
+    // the high-water mark is taken outside the lock, it scans the stack
+    for (int i = 0; i < GetTaskCount(); i++) {
+        Task_t& task = mTasks[i];
+        TaskHandle_t handle = task.mHandle;
+#if INCLUDE_xTaskGetHandle
+        if (handle == NULL) {
+            handle = xTaskGetHandle(task.mpName);
+        }
+#endif
+        if (handle == NULL) {
+            continue;
+        }
+        int free = (int)uxTaskGetStackHighWaterMark(handle); // bytes on esp32
+        if (task.mMinFree < 0 || free < task.mMinFree) {
+            if (free < LYRAT_TELEMETRY_LOW_STACK) {
+                ESP_LOGW(TAG, "[ telemetry ] task %s: %d of %d stack bytes free", task.mpName, free, task.mStackSize);
+            }
+            portENTER_CRITICAL(&mMux);
+            task.mMinFree = free;
+            portEXIT_CRITICAL(&mMux);
+        }
+    }
+
+    portENTER_CRITICAL(&mMux);
+    mHeap = heap;
+    portEXIT_CRITICAL(&mMux);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Telemetry::CountAlloc(Subsystem_e subsystem, int bytes)
+{
+    if (bytes >= 0) {
+        sAllocs[subsystem].fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        sFrees[subsystem].fetch_add(1, std::memory_order_relaxed);
+    }
+    sBytes[subsystem].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Telemetry::GetHeap(Heap_t& heap)
+{
+    portENTER_CRITICAL(&mMux);
+    heap = mHeap;
+    portEXIT_CRITICAL(&mMux);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int Telemetry::GetTaskCount()
+{
+    portENTER_CRITICAL(&mMux);
+    int count = mTaskCount;
+    portEXIT_CRITICAL(&mMux);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Telemetry::GetTask(int i, Task_t& task)
+{
+    portENTER_CRITICAL(&mMux);
+    bool bValid = i >= 0 && i < mTaskCount;
+    if (bValid) {
+        task = mTasks[i];
+    }
+    portEXIT_CRITICAL(&mMux);
+    return bValid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Telemetry::GetAlloc(Subsystem_e subsystem, Alloc_t& alloc)
+{
+    alloc.mAllocs = sAllocs[subsystem].load(std::memory_order_relaxed);
+    alloc.mFrees = sFrees[subsystem].load(std::memory_order_relaxed);
+    alloc.mBytes = sBytes[subsystem].load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* Telemetry::GetName(Subsystem_e subsystem)
+{
+    static const char* names[SubsystemCount] = { "cpp_heap", "pipeline" };
+    return (subsystem < SubsystemCount) ? names[subsystem] : "unknown";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// C++ heap: counts every allocation, one atomic increment and the block size
+// from the heap header; the firmware is built without exceptions
+///////////////////////////////////////////////////////////////////////////////
+static inline void* cpp_alloc(size_t size)
+{
+    void* p = malloc(size);
+    if (p != NULL) {
+        Telemetry::CountAlloc(Telemetry::CppHeap, heap_caps_get_allocated_size(p));
+    }
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline void cpp_free(void* p)
+{
+    if (p != NULL) {
+        Telemetry::CountAlloc(Telemetry::CppHeap, -(int)heap_caps_get_allocated_size(p));
+        free(p);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+    void* p = cpp_alloc(size);
+    if (p == NULL) {
+        abort();
+    }
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return cpp_alloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return cpp_alloc(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete(void* p) noexcept
+{
+    cpp_free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete[](void* p) noexcept
+{
+    cpp_free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete(void* p, size_t) noexcept
+{
+    cpp_free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void operator delete[](void* p, size_t) noexcept
+{
+    cpp_free(p);
+}
@@ -0,0 +1,86 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+// Periodic heap and task stack sampler. Records the stack high-water mark of
+// the registered tasks, free internal RAM and its largest block (lowest values
+// since boot show fragmentation and slow leaks) and allocation counters per
+// subsystem. Sampled in the audio event loop, read by the control task.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define LYRAT_TELEMETRY_PERIOD_MS 10000
+#define LYRAT_TELEMETRY_TASKS 12
+#define LYRAT_TELEMETRY_LOW_BLOCK (8 * 1024) // warning below this largest free block
+#define LYRAT_TELEMETRY_LOW_STACK 512        // warning below this free stack
+
+//////////////////////////////////////////////////////////////////////
+class Telemetry {
+public:
+    enum Subsystem_e {
+        CppHeap,  // operator new: std::string, std::vector, ...
+        Pipeline, // heap taken by adf elements, ring buffers and their tasks
+        SubsystemCount,
+    };
+
+    typedef struct {
+        const char* mpName;
+        uint32_t mStackSize; // bytes
+        TaskHandle_t mHandle; // NULL: looked up by name, adf element tasks come and go
+        int mMinFree;         // bytes, lowest high-water mark seen, -1 if not running yet
+    } Task_t;
+
+    typedef struct {
+        uint32_t mFree;       // internal RAM
+        uint32_t mMinFree;    // since boot
+        uint32_t mLargest;    // largest free block
+        uint32_t mMinLargest; // lowest largest block of all samples
+    } Heap_t;
+
+    typedef struct {
+        uint32_t mAllocs;
+        uint32_t mFrees;
+        int32_t mBytes; // in use
+    } Alloc_t;
+
+public:
+    Telemetry();
+
+    void AddTask(const char* pName, uint32_t stackSize, TaskHandle_t handle = NULL); // pName is not copied
+    void Sample(int64_t now); // us, samples every LYRAT_TELEMETRY_PERIOD_MS
+    static void CountAlloc(Subsystem_e subsystem, int bytes); // negative bytes count as free
+
+    // control side
+    void GetHeap(Heap_t& heap);
+    int GetTaskCount();
+    bool GetTask(int i, Task_t& task);
+    static void GetAlloc(Subsystem_e subsystem, Alloc_t& alloc);
+    static const char* GetName(Subsystem_e subsystem);
+
+private:
+    portMUX_TYPE mMux;
+    int64_t mSampleTime;
+    Heap_t mHeap;
+    int mTaskCount;
+    Task_t mTasks[LYRAT_TELEMETRY_TASKS];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
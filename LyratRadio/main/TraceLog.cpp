@@ -0,0 +1,72 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#include <string.h>
+
+#include "TraceLog.h"
+
+///////////////////////////////////////////////////////////////////////////////
+size_t TraceLog::Read(uint32_t& from, Entry_t* pEntries, size_t max, uint32_t& lost) const
+{
+    uint32_t head = GetHead();
+    uint32_t oldest = (head > LYRAT_TRACE_ENTRIES) ? head - LYRAT_TRACE_ENTRIES : 0;
+    lost = 0;
+    if (from < oldest || from > head) {
+        lost = (from < oldest) ? oldest - from : 0;
+        from = oldest;
+    }
+
+    size_t count = 0;
+    for (; from != head && count < max; from++) {
+        const Entry_t& entry = mEntries[from & (LYRAT_TRACE_ENTRIES - 1)];
+        Entry_t copy = entry;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (copy.mSeq != (uint16_t)from || entry.mSeq != (uint16_t)from) {
+            lost++; // overwritten or still written
+            continue;
+        }
+        pEntries[count++] = copy;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t TraceLog::Encode(const Entry_t* pEntries, size_t count, char* pText, size_t size)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // the targets are little endian like the dump format
+    const uint8_t* pData = (const uint8_t*)pEntries;
+    size_t length = count * sizeof(Entry_t);
+    size_t textLength = (length + 2) / 3 * 4;
+    if (textLength + 1 > size) {
+        return 0;
+    }
+
+    char* pOut = pText;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t value = pData[i] << 16;
+        if (i + 1 < length) {
+            value |= pData[i + 1] << 8;
+        }
+        if (i + 2 < length) {
+            value |= pData[i + 2];
+        }
+        *pOut++ = table[(value >> 18) & 0x3f];
+        *pOut++ = table[(value >> 12) & 0x3f];
+        *pOut++ = (i + 1 < length) ? table[(value >> 6) & 0x3f] : '=';
+        *pOut++ = (i + 2 < length) ? table[value & 0x3f] : '=';
+    }
+    *pOut = 0;
+    return textLength;
+}
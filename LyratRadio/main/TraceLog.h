@@ -0,0 +1,96 @@
+/****************************************************************************************
+  WebRadio - Internet radio using Espressif's Lyrat board
+  Written by Sebastian Hinz, http://radio-online.eu/
+  Based on: Espressif ESP-ADF build environment and examples
+
+  This code is in the Public Domain (or CC0 licensed, at your option.)
+
+  Unless required by applicable law or agreed to in writing, this
+  software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+  CONDITIONS OF ANY KIND, either express or implied.
+****************************************************************************************/
+
+
+#ifndef _TRACELOG_H_
+#define _TRACELOG_H_
+
+// Binary trace of pipeline events: timestamp, event id and two arguments in a
+// ring of fixed entries. Add() is a few stores and one atomic increment, any
+// task may write. The ring is read page by page over the control protocol and
+// decoded on the host (tools/trace_decode.py). An entry that is overwritten
+// while it is read is dropped and counted as lost.
+// No ESP-IDF dependencies, times are in us.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define LYRAT_TRACE_ENTRIES 256     // power of 2, 16 bytes each
+#define LYRAT_TRACE_PAGE_ENTRIES 32 // per dump response, fits a udp response as base64
+
+//////////////////////////////////////////////////////////////////////
+class TraceLog {
+public:
+    // ids are part of the dump format, only append
+    enum Event_e {
+        AudioEvent = 1, // arg0: source type, arg1: cmd << 16 | data (low 16 bits)
+        Command,        // arg0: command, arg1: value
+        SwitchBegin,    // arg0: station
+        SwitchEnd,      // arg0: station, arg1: 0 relink, 1 fast, 2 neighbour
+        MusicInfo,      // arg0: sample rate, arg1: bits << 8 | channels
+        JitterPause,    // arg0: filled bytes, arg1: watermark
+        JitterResume,   // arg0: filled bytes, arg1: stall ms
+        HttpError,      // arg0: status
+        Reconnect,      // arg0: attempt, arg1: delay ms
+        Configuration,  // arg0: stations, arg1: act station
+        DecoderCreate,  // arg0: 0 mp3, 1 aac, arg1: free heap
+        DecoderRelease, // arg0: 0 mp3, 1 aac, arg1: free heap
+        ResolveBegin,   // arg0: station
+        ResolveEnd,     // in the resolver task
+    };
+
+    // little endian in the dump
+    typedef struct {
+        uint32_t mTime; // us, wraps after 71 minutes
+        uint16_t mEvent;
+        uint16_t mSeq; // low bits of the sequence, to detect overwritten entries
+        int32_t mArg0;
+        int32_t mArg1;
+    } Entry_t;
+
+public:
+    TraceLog()
+        : mHead(0)
+    {
+    }
+
+    void Add(uint32_t time, Event_e event, int32_t arg0 = 0, int32_t arg1 = 0)
+    {
+        uint32_t seq = mHead.fetch_add(1, std::memory_order_relaxed);
+        Entry_t& entry = mEntries[seq & (LYRAT_TRACE_ENTRIES - 1)];
+        entry.mSeq = (uint16_t)~seq; // invalid while written
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.mTime = time;
+        entry.mEvent = (uint16_t)event;
+        entry.mArg0 = arg0;
+        entry.mArg1 = arg1;
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.mSeq = (uint16_t)seq;
+    }
+
+    // copies entries from sequence number from on; from is moved to the oldest entry still
+    // in the ring and then behind the last copied one, lost counts the dropped entries
+    size_t Read(uint32_t& from, Entry_t* pEntries, size_t max, uint32_t& lost) const;
+    uint32_t GetHead() const { return mHead.load(std::memory_order_acquire); }
+
+    // base64, returns the length without the terminating 0, 0 if it does not fit
+    static size_t Encode(const Entry_t* pEntries, size_t count, char* pText, size_t size);
+
+private:
+    std::atomic<uint32_t> mHead; // next sequence number
+    Entry_t mEntries[LYRAT_TRACE_ENTRIES];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
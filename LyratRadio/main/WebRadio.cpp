@@ -11,18 +11,25 @@
 ****************************************************************************************/
 
 #include <string.h>
+#include <strings.h>
+#include <algorithm>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 #include "audio_element.h"
 
 #include "audio_event_iface.h"
 #include "audio_common.h"
+#include "ringbuf.h"
 #include "i2s_stream.h"
 #include "http_stream.h"
+#include "esp_http_client.h"
 #include "mp3_decoder.h"
 #include "aac_decoder.h"
 
@@ -38,6 +45,7 @@
 
 #include "DataWebRadio.h"
 #include "WifiWebRadio.h"
+#include "AudioElements.h"
 #include "WebRadio.h"
 
 const char* TAG = "WebRadio";
@@ -47,7 +55,37 @@ WebRadio webRadio;
 
 ///////////////////////////////////////////////////////////////////////////////
 WebRadio::WebRadio()
+    : mHttpTag("http")
+    , mHttp_neighbour(NULL)
+    , mNeighbourTag("http2")
+    , mNeighbourRb(NULL)
+    , mNeighbourStation(-2)
+    , mMp3_decoder(NULL)
+    , mAac_decoder(NULL)
+    , mGain_element(NULL)
+    , mResample_element(NULL)
+    , mActDecoder(NULL)
+    , mSwitchTime(0)
+    , mSwitchBeginTime(0)
+    , mbSwitchPending(false)
+    , mJitterSampleTime(0)
+    , mStationStartTime(0)
+    , mBitrateTime(0)
+    , mBitrateBytes(0)
+    , mReconnectAttempts(0)
+    , mReconnectTime(0)
+    , mbReconnectPending(false)
+    , mDecoderIdleTime(0)
+    , mEvt(NULL)
+    , mCommandEvt(NULL)
+    , mCommandMutex(NULL)
+    , mbCommandListener(false)
 {
+    for (int i = 0; i < 2; i++) {
+        mHttpReaders[i].mpWebRadio = this;
+        mHttpReaders[i].mReader = NULL;
+        mHttpReaders[i].mReturnTime = 0;
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -55,11 +93,21 @@ void WebRadio::Start()
 {
     tcpip_adapter_init();
 
+    // the doorbell lives as long as the radio, each pipeline only attaches its listener
+    audio_event_iface_cfg_t cmd_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    mCommandEvt = audio_event_iface_init(&cmd_cfg);
+    mCommandMutex = xSemaphoreCreateMutex();
+
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
     mSet = esp_periph_set_init(&periph_cfg);
 
+    mTelemetry.AddTask("main", CONFIG_ESP_MAIN_TASK_STACK_SIZE, xTaskGetCurrentTaskHandle());
+
     esp_err_t err = mData.Initialize(this);
     ESP_ERROR_CHECK(err);
+    mTelemetry.AddTask("nvs_commit", LYRAT_NVS_COMMIT_TASK_STACK, mData.GetCommitTask());
+    mResolver.Start(resolver_done, this);
+    mTelemetry.AddTask("resolver", LYRAT_RESOLVER_TASK_STACK, mResolver.GetTask());
 
     if (err == ESP_OK) {
         // start client mode
@@ -68,6 +116,7 @@ void WebRadio::Start()
 
             while (1) {
                 AudioPipeline();
+                mData.Flush();
 
                 printf("loop AudioPipeline -> error\n");
                 vTaskDelay(4000 / portTICK_PERIOD_MS);
@@ -89,7 +138,8 @@ void WebRadio::Start()
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::AudioPipeline()
 {
-    audio_element_handle_t i2s_stream_writer;
+    ReportHeap("start");
+    int heapStart = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
 
     ESP_LOGI(TAG, "[ 1 ] Start audio codec chip");
     audio_board_key_init(mSet);
@@ -103,39 +153,87 @@ void WebRadio::AudioPipeline()
 
     ESP_LOGI(TAG, "[2.1] Create http stream to read data");
     http_stream_cfg_t http_cfg = HTTP_STREAM_CFG_DEFAULT();
+    http_cfg.event_handle = http_stream_event;
+    http_cfg.user_data = &mHttpReaders[0];
     mHttp_stream_reader = http_stream_init(&http_cfg);
+    mHttpReaders[0].mReader = mHttp_stream_reader;
+
+    if (WEBRADIO_WARM_NEIGHBOUR) {
+        ESP_LOGI(TAG, "[2.1] Create second http stream to pre-buffer the next station");
+        http_stream_cfg_t neighbour_cfg = HTTP_STREAM_CFG_DEFAULT();
+        neighbour_cfg.event_handle = http_stream_event;
+        neighbour_cfg.user_data = &mHttpReaders[1];
+        mHttp_neighbour = http_stream_init(&neighbour_cfg);
+        mHttpReaders[1].mReader = mHttp_neighbour;
+        mNeighbourRb = rb_create(WEBRADIO_NEIGHBOUR_RB_SIZE, 1);
+        audio_element_set_output_ringbuf(mHttp_neighbour, mNeighbourRb);
+        mNeighbourStation = -2;
+    }
 
     ESP_LOGI(TAG, "[2.2] Create i2s stream to write data to codec chip");
-    i2s_stream_writer = create_i2s_stream(AUDIO_STREAM_WRITER);
+    mI2s_stream_writer = create_i2s_stream(AUDIO_STREAM_WRITER);
 
-    ESP_LOGI(TAG, "[2.3] Create mp3 decoder to decode mp3 file");
-    mMp3_decoder = create_mp3_decoder();
+    if (WEBRADIO_RESAMPLE_RATE) {
+        ESP_LOGI(TAG, "[2.2] Create resample element, output %d Hz", WEBRADIO_RESAMPLE_RATE);
+        mResampler.Initialize(WEBRADIO_RESAMPLE_RATE, WEBRADIO_RESAMPLE_QUALITY);
+        mResample_element = create_resample_element(&mResampler, &mStats);
+        i2s_stream_set_clk(mI2s_stream_writer, WEBRADIO_RESAMPLE_RATE, 16, 2);
+    }
 
-    ESP_LOGI(TAG, "[2.3] Create aac decoder to decode aac file");
-    mAac_decoder = create_aac_decoder();
+    ESP_LOGI(TAG, "[2.2] Create gain element for volume and fades");
+    mGain_element = create_gain_element(&mGain, &mStats, mResample_element == NULL);
 
     ESP_LOGI(TAG, "[2.4] Register all elements to audio pipeline");
-    audio_pipeline_register(mPipeline, mHttp_stream_reader, "http");
-    audio_pipeline_register(mPipeline, mMp3_decoder, "mp3");
-    audio_pipeline_register(mPipeline, mAac_decoder, "aac");
-    audio_pipeline_register(mPipeline, i2s_stream_writer, "i2s");
+    mHttpTag = "http";
+    mNeighbourTag = "http2";
+    audio_pipeline_register(mPipeline, mHttp_stream_reader, mHttpTag);
+    if (mHttp_neighbour) {
+        // registered for relinking, but not linked while it is the neighbour
+        audio_pipeline_register(mPipeline, mHttp_neighbour, mNeighbourTag);
+    }
+    if (mResample_element) {
+        audio_pipeline_register(mPipeline, mResample_element, "resample");
+    }
+    audio_pipeline_register(mPipeline, mGain_element, "gain");
+    audio_pipeline_register(mPipeline, mI2s_stream_writer, "i2s");
+
+    // element tasks are named by their tag, they are looked up when sampled
+    mTelemetry.AddTask("http", HTTP_STREAM_TASK_STACK);
+    if (mHttp_neighbour) {
+        mTelemetry.AddTask("http2", HTTP_STREAM_TASK_STACK);
+    }
+    mTelemetry.AddTask("mp3", MP3_DECODER_TASK_STACK_SIZE);
+    mTelemetry.AddTask("aac", AAC_DECODER_TASK_STACK_SIZE);
+    if (mResample_element) {
+        mTelemetry.AddTask("resample", RESAMPLE_ELEMENT_TASK_STACK);
+    }
+    mTelemetry.AddTask("gain", GAIN_ELEMENT_TASK_STACK);
+    mTelemetry.AddTask("i2s", I2S_STREAM_TASK_STACK);
 
-    Settings_t set;
-    mData.GetSettings(set);
-    //mData.Debug(set);
-    Station_t& station = (set.mActStation == -1) ? set.mActTune : set.mStations[set.mActStation];
+    Station_t station;
+    int act = mData.GetPlayStation(station);
+    PrepareStation(act, station, mStream, true); // nothing plays yet, the event loop does not run
+    mbSwitchPending = false;
 
     // increment check-reset count
     mData.IncStationCheck(station, CheckListResult::Undefined);
 
-    audio_hal_set_volume(mAudioBoardHandle->audio_hal, set.mVolume);
+    // the codec stays at a fixed level, the volume is ramped in the gain element
+    audio_hal_set_volume(mAudioBoardHandle->audio_hal, WEBRADIO_CODEC_VOLUME);
+    mGain.SetVolume(mData.GetVolume(), 0);
 
-    ESP_LOGI(TAG, "[2.5] Link it together http_stream-->audio_decoder(%s)-->i2s_stream-->[codec_chip]", station.mDecoder.c_str());
-    const char* link_tag[3] = { "http", station.mDecoder.c_str(), "i2s" };
-    audio_pipeline_link(mPipeline, &link_tag[0], 3);
+    ESP_LOGI(TAG, "[2.3] Create %s decoder, the other one is created on demand", station.mDecoder.c_str());
+    GetDecoder(station.mDecoder.c_str(), true);
+
+    ESP_LOGI(TAG, "[2.5] Link it together http_stream-->audio_decoder(%s)-->%sgain-->i2s_stream-->[codec_chip]", station.mDecoder.c_str(), mResample_element ? "resample-->" : "");
+    const char* link_tag[5];
+    int link_count = GetLinkTags(link_tag, "http", station.mDecoder.c_str());
+    audio_pipeline_link(mPipeline, &link_tag[0], link_count);
+    mActDecoder = GetDecoder(station.mDecoder.c_str(), false);
 
     ESP_LOGI(TAG, "[2.6] Set up  uri (http as http_stream, mp3 as mp3 decoder, and default output is i2s) '%s'", station.mUrl.c_str());
-    audio_element_set_uri(mHttp_stream_reader, station.mUrl.c_str());
+    SetReaderUri(mHttp_stream_reader, mStream);
+    mData.SetNowPlayingStation(station.mId.c_str());
 
     ESP_LOGI(TAG, "[ 3 ] Start and wait for Wi-Fi network");
 
@@ -149,56 +247,61 @@ void WebRadio::AudioPipeline()
     ESP_LOGI(TAG, "[4.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(mSet), mEvt);
 
+    ESP_LOGI(TAG, "[4.3] Listening commands from control server");
+    xSemaphoreTake(mCommandMutex, portMAX_DELAY);
+    audio_event_iface_set_listener(mCommandEvt, mEvt);
+    mbCommandListener = true;
+    xSemaphoreGive(mCommandMutex);
+
     ESP_LOGI(TAG, "[ 5 ] Start audio_pipeline");
     audio_pipeline_run(mPipeline);
+    Telemetry::CountAlloc(Telemetry::Pipeline, heapStart - (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    StartStationStats(station);
+    StartJitterBuffer(station);
 
     while (1) {
+        // the ring is drained on every pass, a lost doorbell delays the commands by one
+        // listen timeout only; the events received afterwards belong to the new state
+        ExecuteCommands();
+
         audio_event_iface_msg_t msg;
-        esp_err_t ret = audio_event_iface_listen(mEvt, &msg, portMAX_DELAY);
+        esp_err_t ret = audio_event_iface_listen(mEvt, &msg, WEBRADIO_JITTER_SAMPLE_MS / portTICK_RATE_MS);
+        SampleJitterBuffer();
+        ReleaseIdleDecoder();
+        mTelemetry.Sample(esp_timer_get_time());
+        if (!ServiceReconnect()) {
+            break;
+        }
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "[ * ] Event interface error : %d", ret);
-            continue;
+            continue; // timeout, only sampling
         }
-        esp_msg_debug(msg);
+        Trace(TraceLog::AudioEvent, msg.source_type, (msg.cmd << 16) | ((int)msg.data & 0xffff));
 
         if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
-            && msg.source == (void*)mMp3_decoder
+            && (msg.source == (void*)mMp3_decoder || msg.source == (void*)mAac_decoder)
             && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
-            audio_element_info_t music_info;
-            audio_element_getinfo(mMp3_decoder, &music_info);
-
-            ESP_LOGI(TAG, "[ * ] Receive music info from mp3 decoder, sample_rates=%d, bits=%d, ch=%d",
-                music_info.sample_rates, music_info.bits, music_info.channels);
-
-            audio_element_setinfo(i2s_stream_writer, &music_info);
-            i2s_stream_set_clk(i2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
-
-            mData.GetSettings(set);
-            Station_t& station = (set.mActStation == -1) ? set.mActTune : set.mStations[set.mActStation];
-
-            // reset check-reset count,
-            mData.IncStationCheck(station, CheckListResult::Valid);
+            ReportMusicInfo((audio_element_handle_t)msg.source);
             continue;
         }
 
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
-            && msg.source == (void*)mAac_decoder
-            && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
-            audio_element_info_t music_info;
-            audio_element_getinfo(mAac_decoder, &music_info);
-
-            ESP_LOGI(TAG, "[ * ] Receive music info from aac decoder, sample_rates=%d, bits=%d, ch=%d",
-                music_info.sample_rates, music_info.bits, music_info.channels);
-
-            audio_element_setinfo(i2s_stream_writer, &music_info);
-            i2s_stream_set_clk(i2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void*)mHttp_stream_reader
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
+            && (int)msg.data >= AEL_STATUS_ERROR_OPEN && (int)msg.data <= AEL_STATUS_ERROR_UNKNOWN) {
+            ESP_LOGW(TAG, "[ * ] http stream error %d", (int)msg.data);
+            Trace(TraceLog::HttpError, (int)msg.data);
+            mData.AddStationStats(mStatsId.c_str(), StatsError, (int)msg.data);
+            mResolver.Invalidate(mStatsId.c_str());
+            ScheduleReconnect();
+        }
 
-            mData.GetSettings(set);
-            Station_t& station = (set.mActStation == -1) ? set.mActTune : set.mStations[set.mActStation];
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void*)mHttp_stream_reader
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)msg.data == AEL_STATUS_STATE_FINISHED) {
+            ESP_LOGW(TAG, "[ * ] http stream finished");
+            ScheduleReconnect();
+        }
 
-            // reset check-reset count,
-            mData.IncStationCheck(station, CheckListResult::Valid);
-            continue;
+        if (msg.source_type == WEBRADIO_COMMAND_SOURCE) {
+            continue; // executed at the start of the next pass
         }
 
         if ((msg.source_type == PERIPH_ID_TOUCH || msg.source_type == PERIPH_ID_BUTTON || msg.source_type == PERIPH_ID_ADC_BTN)
@@ -207,41 +310,253 @@ void WebRadio::AudioPipeline()
         }
 
         /* Stop when the last pipeline element (i2s_stream_writer in this case) receives stop event */
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void*)i2s_stream_writer
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void*)mI2s_stream_writer
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
             && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED))) {
+            // caused by a station switch, not by a failure of the stream
+            if (mSwitchBeginTime != 0 && esp_timer_get_time() - mSwitchBeginTime < WEBRADIO_SWITCH_GUARD_MS * 1000LL) {
+                ESP_LOGI(TAG, "[ switch ] i2s stop event ignored");
+                continue;
+            }
+            // starved by the failed stream, the reconnect restarts it
+            if (mReconnectTime != 0 || mReconnectAttempts > 0) {
+                continue;
+            }
             ESP_LOGW(TAG, "[ * ] Stop event received");
+            mData.AddStationStats(mStatsId.c_str(), StatsReconnect);
             break;
         }
     }
 
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
+    int heapStop = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    StopNeighbour();
     audio_pipeline_stop(mPipeline);
     audio_pipeline_wait_for_stop(mPipeline);
     audio_pipeline_terminate(mPipeline);
+    if (mHttp_neighbour) {
+        // after a swap the pipeline still counts the neighbour as linked reader
+        audio_element_terminate(mHttp_stream_reader);
+        audio_element_terminate(mHttp_neighbour);
+    }
 
     /* Terminate the pipeline before removing the listener */
-    audio_pipeline_unregister(mPipeline, mHttp_stream_reader);
-    audio_pipeline_unregister(mPipeline, i2s_stream_writer);
-    audio_pipeline_unregister(mPipeline, mMp3_decoder);
-    audio_pipeline_unregister(mPipeline, mAac_decoder);
-
+    /* The pipeline only removes the listener of linked elements, the idle decoder and the neighbour are not */
     audio_pipeline_remove_listener(mPipeline);
+    UnregisterElement(mHttp_stream_reader);
+    UnregisterElement(mGain_element);
+    if (mResample_element) {
+        UnregisterElement(mResample_element);
+    }
+    UnregisterElement(mI2s_stream_writer);
+    if (mMp3_decoder) {
+        UnregisterElement(mMp3_decoder);
+    }
+    if (mAac_decoder) {
+        UnregisterElement(mAac_decoder);
+    }
+    if (mHttp_neighbour) {
+        UnregisterElement(mHttp_neighbour);
+    }
 
     /* Stop all peripherals before removing the listener */
     esp_periph_set_stop_all(mSet);
     audio_event_iface_remove_listener(esp_periph_set_get_event_iface(mSet), mEvt);
 
+    // PostCommand sends under the same mutex, it never sees a listener that is removed
+    xSemaphoreTake(mCommandMutex, portMAX_DELAY);
+    mbCommandListener = false;
+    audio_event_iface_remove_listener(mCommandEvt, mEvt);
+    xSemaphoreGive(mCommandMutex);
+
     /* Make sure audio_pipeline_remove_listener & audio_event_iface_remove_listener are called before destroying event_iface */
     audio_event_iface_destroy(mEvt);
 
     /* Release all resources */
     audio_pipeline_deinit(mPipeline);
     audio_element_deinit(mHttp_stream_reader);
-    audio_element_deinit(i2s_stream_writer);
-    audio_element_deinit(mMp3_decoder);
-    audio_element_deinit(mAac_decoder);
+    audio_element_deinit(mGain_element);
+    if (mResample_element) {
+        audio_element_deinit(mResample_element);
+        mResample_element = NULL;
+    }
+    audio_element_deinit(mI2s_stream_writer);
+    if (mMp3_decoder) {
+        audio_element_deinit(mMp3_decoder);
+        mMp3_decoder = NULL;
+    }
+    if (mAac_decoder) {
+        audio_element_deinit(mAac_decoder);
+        mAac_decoder = NULL;
+    }
+    if (mHttp_neighbour) {
+        audio_element_deinit(mHttp_neighbour);
+        rb_destroy(mNeighbourRb);
+        mHttp_neighbour = NULL;
+        mNeighbourRb = NULL;
+    }
+    Telemetry::CountAlloc(Telemetry::Pipeline, heapStop - (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
     esp_periph_set_destroy(mSet);
+    mActDecoder = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decoder for type "MP3"/"AAC", created and registered on demand; NULL for unknown types
+audio_element_handle_t WebRadio::GetDecoder(const char* pType, bool bCreate)
+{
+    bool bAac = strcasecmp(pType, "aac") == 0;
+    if (!bAac && strcasecmp(pType, "mp3") != 0) {
+        return NULL;
+    }
+
+    audio_element_handle_t& decoder = bAac ? mAac_decoder : mMp3_decoder;
+    if (decoder == NULL && bCreate) {
+        int heapStart = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        decoder = bAac ? create_aac_decoder() : create_mp3_decoder();
+        audio_pipeline_register(mPipeline, decoder, bAac ? "aac" : "mp3");
+        if (mActDecoder != NULL) {
+            // on demand, the first decoder is part of the pipeline setup
+            Telemetry::CountAlloc(Telemetry::Pipeline, heapStart - (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+        }
+        ReportHeap(bAac ? "aac decoder created" : "mp3 decoder created");
+        Trace(TraceLog::DecoderCreate, bAac, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    }
+    return decoder;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// before an element is deleted: the event interface must not keep listening to its queue
+void WebRadio::UnregisterElement(audio_element_handle_t element)
+{
+    audio_pipeline_unregister(mPipeline, element);
+    audio_element_msg_remove_listener(element, mEvt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the decoder that is not linked is deleted after an idle time
+void WebRadio::ReleaseIdleDecoder()
+{
+    audio_element_handle_t& idle = (mActDecoder == mMp3_decoder) ? mAac_decoder : mMp3_decoder;
+    if (idle == NULL || mActDecoder == NULL) {
+        mDecoderIdleTime = 0;
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (mDecoderIdleTime == 0) {
+        mDecoderIdleTime = now;
+    }
+    if (now - mDecoderIdleTime < WEBRADIO_DECODER_IDLE_MS * 1000LL) {
+        return;
+    }
+
+    bool bAac = idle == mAac_decoder;
+    int heapStart = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    audio_element_terminate(idle);
+    UnregisterElement(idle);
+    audio_element_deinit(idle);
+    idle = NULL;
+    Telemetry::CountAlloc(Telemetry::Pipeline, heapStart - (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    mDecoderIdleTime = 0;
+    ReportHeap(bAac ? "aac decoder released" : "mp3 decoder released");
+    Trace(TraceLog::DecoderRelease, bAac, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// internal RAM: free now, lowest free since boot (high-water mark of use), largest block
+void WebRadio::ReportHeap(const char* pWhen)
+{
+    ESP_LOGI(TAG, "[ heap ] %s: free %d, min free %d, largest block %d", pWhen,
+        heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+        heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ramps the output down before the pipeline is touched; the gain element only
+// advances with samples, a stalled stream is silent anyway
+void WebRadio::FadeOut()
+{
+    mGain.Mute(true, WEBRADIO_FADE_MS);
+
+    int waited = 0;
+    while (!mGain.IsSilent() && waited < 2 * WEBRADIO_FADE_MS) {
+        vTaskDelay(1);
+        waited += portTICK_PERIOD_MS;
+    }
+    // the ramp is still in the ring buffer in front of i2s
+    vTaskDelay(WEBRADIO_FADE_MS / portTICK_PERIOD_MS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// http-->decoder-->[resample-->]gain-->i2s, pTags has room for 5
+int WebRadio::GetLinkTags(const char* pTags[], const char* pHttpTag, const char* pDecoder)
+{
+    int count = 0;
+    pTags[count++] = pHttpTag;
+    pTags[count++] = pDecoder;
+    if (mResample_element) {
+        pTags[count++] = "resample";
+    }
+    pTags[count++] = "gain";
+    pTags[count++] = "i2s";
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// first decoded frame of a station
+void WebRadio::ReportMusicInfo(audio_element_handle_t decoder)
+{
+    audio_element_info_t music_info;
+    audio_element_getinfo(decoder, &music_info);
+
+    ESP_LOGI(TAG, "[ * ] Receive music info from %s decoder, sample_rates=%d, bits=%d, ch=%d",
+        (decoder == mMp3_decoder) ? "mp3" : "aac", music_info.sample_rates, music_info.bits, music_info.channels);
+    Trace(TraceLog::MusicInfo, music_info.sample_rates, (music_info.bits << 8) | music_info.channels);
+
+    if (mResample_element && Resampler::IsSupported(music_info.bits)) {
+        // the i2s clock stays at the output rate
+        mResampler.SetInputFormat(music_info.sample_rates, music_info.channels, music_info.bits);
+        music_info.sample_rates = mResampler.GetOutRate();
+        music_info.channels = 2;
+        mGain.SetFormat(music_info.sample_rates, music_info.channels, music_info.bits);
+        audio_element_setinfo(mI2s_stream_writer, &music_info);
+    }
+    else {
+        if (mResample_element) {
+            mResampler.SetInputFormat(music_info.sample_rates, music_info.channels, music_info.bits); // passes unchanged
+        }
+        mGain.SetFormat(music_info.sample_rates, music_info.channels, music_info.bits);
+        audio_element_setinfo(mI2s_stream_writer, &music_info);
+        i2s_stream_set_clk(mI2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
+    }
+
+    if (mSwitchTime != 0) {
+        ESP_LOGI(TAG, "[ switch ] command to first sample: %d ms", (int)((esp_timer_get_time() - mSwitchTime) / 1000));
+        mSwitchTime = 0;
+    }
+
+    mReconnectAttempts = 0;
+
+    if (mStationStartTime != 0) {
+        int64_t now = esp_timer_get_time();
+        mData.AddStationStats(mStatsId.c_str(), StatsFirstAudio, (int)((now - mStationStartTime) / 1000));
+        mStationStartTime = 0;
+
+        audio_element_info_t info;
+        audio_element_getinfo(mHttp_stream_reader, &info);
+        mBitrateBytes = info.byte_pos;
+        mBitrateTime = now;
+    }
+
+    Station_t station;
+    mData.GetPlayStation(station);
+
+    // reset check-reset count,
+    mData.IncStationCheck(station, CheckListResult::Valid);
+
+    // playback is stable, now the neighbour may use bandwidth
+    WarmNeighbour();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -249,8 +564,6 @@ bool WebRadio::key_handler(audio_event_iface_msg_t& msg)
 {
     IWebRadioCommands& command = GetCommandInterface();
 
-    int player_volume;
-
     if ((int)msg.data == get_input_play_id()) {
         ESP_LOGI(TAG, "[ * ] [Play] touch tap event");
         command.SetPreviousStation();
@@ -262,26 +575,13 @@ bool WebRadio::key_handler(audio_event_iface_msg_t& msg)
         return true;
     }
     else if ((int)msg.data == get_input_volup_id()) {
-        audio_hal_get_volume(mAudioBoardHandle->audio_hal, &player_volume);
-
         ESP_LOGI(TAG, "[ * ] [Vol+] touch tap event");
-        player_volume += 10;
-        if (player_volume > 100) {
-            player_volume = 100;
-        }
-        command.SetVolume(player_volume);
-        ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
+        // relative, so that taps queued before the last change was applied add up
+        PostCommand(CmdChangeVolume, 10);
     }
     else if ((int)msg.data == get_input_voldown_id()) {
-        audio_hal_get_volume(mAudioBoardHandle->audio_hal, &player_volume);
-
         ESP_LOGI(TAG, "[ * ] [Vol-] touch tap event");
-        player_volume -= 10;
-        if (player_volume < 0) {
-            player_volume = 0;
-        }
-        command.SetVolume(player_volume);
-        ESP_LOGI(TAG, "[ * ] Volume set to %d %%", player_volume);
+        PostCommand(CmdChangeVolume, -10);
     }
     return false;
 }
@@ -289,33 +589,538 @@ bool WebRadio::key_handler(audio_event_iface_msg_t& msg)
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::AudioPipelineSwitchStation()
 {
-    Settings_t set;
-    mData.GetSettings(set);
-    //mData.Debug(set);
-    Station_t& station = (set.mActStation == -1) ? set.mActTune : set.mStations[set.mActStation];
+    Station_t station;
+    int act = mData.GetPlayStation(station);
+
+    // the playing station continues until the resolver task has the stream url (and decoder type)
+    StreamResolver::Stream_t stream;
+    mbSwitchPending = !PrepareStation(act, station, stream, false);
+    if (mbSwitchPending) {
+        ESP_LOGI(TAG, "[ switch ] resolve '%s' in the background", station.mUrl.c_str());
+        Trace(TraceLog::ResolveBegin, act);
+        return;
+    }
+    mStream = stream;
 
     // increment check-reset count
     mData.IncStationCheck(station, CheckListResult::Undefined);
+    mData.SetNowPlayingStation(station.mId.c_str());
+
+    audio_element_handle_t decoder = GetDecoder(station.mDecoder.c_str(), false);
+    Trace(TraceLog::SwitchBegin, act);
+    mSwitchBeginTime = esp_timer_get_time();
+    FadeOut();
+
+    int how = 0; // relink
+    if (mHttp_neighbour && act == mNeighbourStation && station.mUrl == mNeighbourUrl
+        && decoder != NULL && decoder == mActDecoder && AudioPipelineSwapNeighbour(station, decoder)) {
+        how = 2;
+    }
+    if (how == 0) {
+        StopNeighbour();
+    }
+
+    if (how == 0 && WEBRADIO_FAST_SWITCH && decoder != NULL && decoder == mActDecoder && AudioPipelineFastSwitch(station, decoder)) {
+        how = 1;
+    }
+    if (how == 0) {
+        AudioPipelineRelink(station);
+    }
+    Trace(TraceLog::SwitchEnd, act, how);
+    // ramps up with the first samples of the new station
+    mGain.Mute(false, WEBRADIO_FADE_MS);
+    StartStationStats(station);
+    StartJitterBuffer(station);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebRadio::StartStationStats(const Station_t& station)
+{
+    mReconnectTime = 0;
+    mReconnectAttempts = 0;
+    mbReconnectPending = false;
+
+    mStatsId = station.mId;
+    mStationStartTime = esp_timer_get_time();
+    mBitrateTime = 0;
+    mData.AddStationStats(mStatsId.c_str(), StatsPlay);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// average stream bitrate from the bytes read by the http reader
+void WebRadio::SampleBitrate(int64_t now)
+{
+    if (mBitrateTime == 0 || now - mBitrateTime < WEBRADIO_STATS_BITRATE_MS * 1000LL) {
+        return;
+    }
+
+    audio_element_info_t info;
+    audio_element_getinfo(mHttp_stream_reader, &info);
+    int kbps = (int)((info.byte_pos - mBitrateBytes) * 8 * 1000 / (now - mBitrateTime));
+    mData.AddStationStats(mStatsId.c_str(), StatsBitrate, kbps);
+
+    mBitrateBytes = info.byte_pos;
+    mBitrateTime = now;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// exponential backoff with jitter, so that many radios don't hit the server at the same time
+void WebRadio::ScheduleReconnect()
+{
+    if (mReconnectTime != 0) {
+        return; // already pending
+    }
+
+    int delay = WEBRADIO_RECONNECT_BASE_MS << std::min(mReconnectAttempts, 16);
+    delay = std::min(delay, WEBRADIO_RECONNECT_MAX_MS);
+    delay += (int)(esp_random() % (delay / 2 + 1)) - delay / 4;
+
+    mReconnectTime = esp_timer_get_time() + delay * 1000LL;
+    ESP_LOGW(TAG, "[ reconnect ] attempt %d in %d ms", mReconnectAttempts + 1, delay);
+    Trace(TraceLog::Reconnect, mReconnectAttempts + 1, delay);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool WebRadio::ServiceReconnect()
+{
+    if (mReconnectTime == 0 || esp_timer_get_time() < mReconnectTime) {
+        return true;
+    }
+    mReconnectTime = 0;
+    if (mbSwitchPending) {
+        return true; // the switch restarts the reader when the resolver is done
+    }
+
+    if (++mReconnectAttempts > WEBRADIO_RECONNECT_ATTEMPTS) {
+        ESP_LOGE(TAG, "[ reconnect ] %d attempts failed, restart pipeline", WEBRADIO_RECONNECT_ATTEMPTS);
+        return false;
+    }
+
+    Station_t station;
+    int act = mData.GetPlayStation(station);
+    mData.AddStationStats(mStatsId.c_str(), StatsReconnect);
+
+    // the first attempt goes to the last stream url, after that the url is resolved again;
+    // the http error invalidated the cached one, so the resolver task connects
+    if (mReconnectAttempts > 1) {
+        StreamResolver::Stream_t stream;
+        if (!mResolver.Lookup(station, false, stream)) {
+            ESP_LOGI(TAG, "[ reconnect ] resolve '%s' in the background", station.mUrl.c_str());
+            Trace(TraceLog::ResolveBegin, act);
+            mResolver.Request(station, false);
+            mbReconnectPending = true;
+            return true;
+        }
+        mStream = stream;
+    }
+    Reconnect();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// same station, same decoder: restart reader and decoder only
+void WebRadio::Reconnect()
+{
+    Station_t station;
+    mData.GetPlayStation(station);
+
+    mbReconnectPending = false;
+    if (mActDecoder == NULL || !AudioPipelineFastSwitch(station, mActDecoder)) {
+        ScheduleReconnect();
+        return;
+    }
+    StartJitterBuffer(station);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stream url of the station; stations that never played are probed for their decoder type,
+// a wrong type is corrected in the station list. Without bWait the connection is made in the
+// resolver task, false until its result is cached.
+bool WebRadio::PrepareStation(int index, Station_t& station, StreamResolver::Stream_t& stream, bool bWait)
+{
+    bool bProbe = mData.GetStationCheck(station.mId.c_str()) != CheckListResult::Valid;
+    if (bWait) {
+        mResolver.Resolve(station, bProbe, stream);
+    }
+    else if (!mResolver.Lookup(station, bProbe, stream)) {
+        mResolver.Request(station, bProbe);
+        return false;
+    }
+
+    const std::string& decoder = stream.mDecoder;
+    if (!bProbe || decoder.empty() || strcasecmp(decoder.c_str(), station.mDecoder.c_str()) == 0) {
+        return true;
+    }
 
+    ESP_LOGW(TAG, "[ probe ] station '%s' is %s, not %s", station.mId.c_str(), decoder.c_str(), station.mDecoder.c_str());
+    station.mDecoder = decoder;
+    mData.SetStation(index, station, mData.GetStationCount());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// resolved url, metadata is requested if the stream announced an interval to the resolver;
+// the reader checks the first block of its own response and stops stripping if it is no metadata
+esp_err_t WebRadio::SetReaderUri(audio_element_handle_t reader, const StreamResolver::Stream_t& stream)
+{
+    esp_err_t err = audio_element_set_uri(reader, stream.mUrl.c_str());
+    for (int i = 0; i < 2; i++) {
+        if (mHttpReaders[i].mReader == reader) {
+            mHttpReaders[i].mIcy.SetMetaInt(stream.mMetaInt);
+        }
+    }
+    return err;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// runs in the resolver task, the result is taken from the cache in the event loop
+void WebRadio::resolver_done(void* pContext)
+{
+    WebRadio* pWebRadio = (WebRadio*)pContext;
+    pWebRadio->Trace(TraceLog::ResolveEnd);
+    pWebRadio->PostCommand(CmdResolved);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int icy_http_read(void* pContext, char* pBuffer, int length)
+{
+    return esp_http_client_read((esp_http_client_handle_t)pContext, pBuffer, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// http_stream hook, runs in the reader task: the reader requests icy metadata and
+// ON_RESPONSE reads the socket itself, so metadata blocks never reach the ring buffer
+int WebRadio::http_stream_event(http_stream_event_msg_t* msg)
+{
+    HttpReader_t* pReader = (HttpReader_t*)msg->user_data;
+    IcyReader& icy = pReader->mIcy;
+    esp_http_client_handle_t client = (esp_http_client_handle_t)msg->http_client;
+
+    switch (msg->event_id) {
+    case HTTP_STREAM_PRE_REQUEST:
+        pReader->mReturnTime = 0;
+        icy.Restart();
+        if (icy.GetMetaInt() > 0) {
+            esp_http_client_set_header(client, "Icy-MetaData", "1");
+        }
+        else {
+            esp_http_client_delete_header(client, "Icy-MetaData");
+        }
+        break;
+
+    case HTTP_STREAM_ON_RESPONSE: {
+        // without metadata Read() passes through, the socket is read here for the statistics
+        int64_t start = esp_timer_get_time();
+        bool bStrip = icy.GetMetaInt() > 0;
+        int len = icy.Read((char*)msg->buffer, msg->buffer_len, icy_http_read, client);
+        int64_t end = esp_timer_get_time();
+        if (bStrip && icy.GetMetaInt() == 0) {
+            ESP_LOGW(TAG, "[ icy ] response has no metadata at the announced interval, not stripped");
+        }
+
+        // a pre-buffering neighbour keeps its title and doesn't count until it is swapped in
+        WebRadio* pWebRadio = pReader->mpWebRadio;
+        if (msg->el == pWebRadio->mHttp_stream_reader) {
+            if (icy.IsTitleChanged()) {
+                pWebRadio->mData.SetNowPlaying(icy.TakeTitle());
+            }
+
+            PipelineStats& stats = pWebRadio->mStats;
+            if (pReader->mReturnTime != 0) {
+                stats.AddWrite(PipelineStats::Http, 0, (uint32_t)(start - pReader->mReturnTime));
+            }
+            if (len > 0) {
+                stats.AddRead(PipelineStats::Http, len, (uint32_t)(end - start));
+                stats.AddWrite(PipelineStats::Http, len, 0);
+                stats.AddProcess(PipelineStats::Http, 0);
+            }
+            else {
+                stats.AddUnderrun(PipelineStats::Http); // timeout or error
+            }
+        }
+        pReader->mReturnTime = esp_timer_get_time();
+        return len;
+    }
+
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// for the stats message, called from the control task
+int WebRadio::GetPipelineFill(PipelineStats::Stage_e stage)
+{
+    audio_element_handle_t el = NULL;
+    switch (stage) {
+    case PipelineStats::Http:
+        el = mHttp_stream_reader;
+        break;
+    case PipelineStats::Decoder:
+        el = mActDecoder;
+        break;
+    case PipelineStats::Resample:
+        el = mResample_element;
+        break;
+    case PipelineStats::Gain:
+        el = mGain_element;
+        break;
+    default:
+        break;
+    }
+
+    ringbuf_handle_t rb = el ? audio_element_get_output_ringbuf(el) : NULL;
+    return rb ? rb_bytes_filled(rb) : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// holds the decoder until the pre-roll watermark of the station is reached
+void WebRadio::StartJitterBuffer(const Station_t& station)
+{
+    ringbuf_handle_t rb = mActDecoder ? audio_element_get_input_ringbuf(mActDecoder) : NULL;
+    if (rb == NULL) {
+        return;
+    }
+
+    StationUuid_t uuid;
+    if (!uuid.Parse(station.mId.c_str())) {
+        memset(&uuid, 0, sizeof(uuid));
+    }
+
+    ApplyJitterAction(mJitter.Start(uuid, rb_get_size(rb), esp_timer_get_time()));
+    ESP_LOGI(TAG, "[ jitter ] pre-roll %d bytes", mJitter.GetStation()->mWatermark);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebRadio::SampleJitterBuffer()
+{
+    int64_t now = esp_timer_get_time();
+    if (now - mJitterSampleTime < WEBRADIO_JITTER_SAMPLE_MS * 1000LL || mActDecoder == NULL) {
+        return;
+    }
+    mJitterSampleTime = now;
+
+    ringbuf_handle_t rb = audio_element_get_input_ringbuf(mActDecoder);
+    if (rb == NULL || mJitter.GetStation() == NULL) {
+        return;
+    }
+
+    SampleBitrate(now);
+
+    int filled = rb_bytes_filled(rb);
+    JitterBuffer::Action_e action = mJitter.Sample(filled, now);
+    const JitterBuffer::Station_t* station = mJitter.GetStation();
+    if (action == JitterBuffer::Pause) {
+        ESP_LOGW(TAG, "[ jitter ] underrun %d, pre-roll now %d bytes, rebuffer to %d bytes", station->mUnderruns,
+                 station->mWatermark, mJitter.GetCushion());
+        Trace(TraceLog::JitterPause, filled, mJitter.GetCushion());
+        mStats.AddUnderrun(PipelineStats::Decoder);
+        mData.AddStationStats(mStatsId.c_str(), StatsUnderrun);
+    }
+    else if (action == JitterBuffer::Resume && station->mUnderruns > 0) {
+        ESP_LOGI(TAG, "[ jitter ] stall %d ms (max %d ms)", station->mLastStallMs, station->mMaxStallMs);
+        Trace(TraceLog::JitterResume, filled, station->mLastStallMs);
+    }
+    ApplyJitterAction(action);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebRadio::ApplyJitterAction(JitterBuffer::Action_e action)
+{
+    if (action == JitterBuffer::Pause) {
+        audio_element_pause(mActDecoder);
+    }
+    else if (action == JitterBuffer::Resume) {
+        audio_element_resume(mActDecoder, 0, 2000 / portTICK_RATE_MS);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// same decoder type: i2s writer keeps running, http reader and decoder are restarted
+// and the ring buffers in between are flushed
+bool WebRadio::AudioPipelineFastSwitch(Station_t& station, audio_element_handle_t decoder)
+{
+    esp_err_t err, err1;
+
+    err = audio_element_stop(mHttp_stream_reader);
+    err1 = audio_element_stop(decoder);
+    audio_element_wait_for_stop(mHttp_stream_reader);
+    audio_element_wait_for_stop(decoder);
+    ESP_LOGI(TAG, "[ switch ] stop http, %s => %s, %s", station.mDecoder.c_str(), esp_err_to_name(err), esp_err_to_name(err1));
+
+    audio_element_reset_state(mHttp_stream_reader);
+    audio_element_reset_state(decoder);
+    audio_element_reset_output_ringbuf(mHttp_stream_reader);
+    audio_element_reset_output_ringbuf(decoder);
+
+    err = SetReaderUri(mHttp_stream_reader, mStream);
+    ESP_LOGI(TAG, "[ switch ] Set up  uri '%s' => %s", mStream.mUrl.c_str(), esp_err_to_name(err));
+
+    // resample, gain and i2s writer may have seen the aborted input, restart them if they are not running anymore
+    audio_element_handle_t sinks[3] = { mResample_element, mGain_element, mI2s_stream_writer };
+    for (audio_element_handle_t sink : sinks) {
+        if (sink && audio_element_get_state(sink) != AEL_STATE_RUNNING) {
+            audio_element_reset_state(sink);
+            audio_element_run(sink);
+            audio_element_resume(sink, 0, 2000 / portTICK_RATE_MS);
+        }
+    }
+
+    err = audio_element_run(decoder);
+    err1 = audio_element_run(mHttp_stream_reader);
+    if (err != ESP_OK || err1 != ESP_OK) {
+        ESP_LOGW(TAG, "[ switch ] fast switch failed, relink pipeline");
+        return false;
+    }
+    err = audio_element_resume(decoder, 0, 2000 / portTICK_RATE_MS);
+    err1 = audio_element_resume(mHttp_stream_reader, 0, 2000 / portTICK_RATE_MS);
+    ESP_LOGI(TAG, "[ switch ] fast run => %s, %s", esp_err_to_name(err), esp_err_to_name(err1));
+
+    return err == ESP_OK && err1 == ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the neighbour already buffers the new station: the decoder continues with its
+// ring buffer and the old reader becomes the next neighbour
+bool WebRadio::AudioPipelineSwapNeighbour(Station_t& station, audio_element_handle_t decoder)
+{
+    esp_err_t err, err1;
+
+    audio_element_stop(mHttp_stream_reader);
+    audio_element_stop(decoder);
+    audio_element_wait_for_stop(mHttp_stream_reader);
+    audio_element_wait_for_stop(decoder);
+
+    ESP_LOGI(TAG, "[ switch ] swap to neighbour '%s', %d bytes buffered", station.mUrl.c_str(), rb_bytes_filled(audio_element_get_output_ringbuf(mHttp_neighbour)));
+
+    audio_element_reset_state(decoder);
+    audio_element_reset_output_ringbuf(decoder);
+    audio_element_set_input_ringbuf(decoder, audio_element_get_output_ringbuf(mHttp_neighbour));
+
+    audio_element_reset_state(mHttp_stream_reader);
+    audio_element_reset_output_ringbuf(mHttp_stream_reader);
+
+    std::swap(mHttp_stream_reader, mHttp_neighbour);
+    std::swap(mHttpTag, mNeighbourTag);
+    mNeighbourStation = -2;
+
+    if (audio_element_get_state(mI2s_stream_writer) != AEL_STATE_RUNNING) {
+        audio_element_reset_state(mI2s_stream_writer);
+        audio_element_run(mI2s_stream_writer);
+        audio_element_resume(mI2s_stream_writer, 0, 2000 / portTICK_RATE_MS);
+    }
+
+    err = audio_element_run(decoder);
+    err1 = audio_element_resume(decoder, 0, 2000 / portTICK_RATE_MS);
+    ESP_LOGI(TAG, "[ switch ] neighbour run => %s, %s", esp_err_to_name(err), esp_err_to_name(err1));
+
+    return err == ESP_OK && err1 == ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start pre-buffering the preset after the active station
+void WebRadio::WarmNeighbour()
+{
+    if (mHttp_neighbour == NULL) {
+        return;
+    }
+
+    int count = mData.GetStationCount();
+    if (count < 2) {
+        return;
+    }
+    int next = (mData.GetActStation() + 1) % count;
+    Station_t station;
+    if (!mData.GetStation(next, station)) {
+        return;
+    }
+
+    if (next == mNeighbourStation && station.mUrl == mNeighbourUrl) {
+        return;
+    }
+    StopNeighbour();
+
+    size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (freeHeap < WEBRADIO_NEIGHBOUR_MIN_FREE_HEAP) {
+        ESP_LOGW(TAG, "[ neighbour ] %d bytes free heap, not enough for pre-buffering", freeHeap);
+        return;
+    }
+
+    // warmed with the next first audio or the result of the resolver task
+    StreamResolver::Stream_t stream;
+    if (!mResolver.Lookup(station, false, stream)) {
+        Trace(TraceLog::ResolveBegin, next);
+        mResolver.Request(station, false);
+        return;
+    }
+
+    ESP_LOGI(TAG, "[ neighbour ] pre-buffer station %d '%s'", next, stream.mUrl.c_str());
+    audio_element_msg_remove_listener(mHttp_neighbour, mEvt); // registered once, also after a swap
+    audio_element_msg_set_listener(mHttp_neighbour, mEvt);
+    SetReaderUri(mHttp_neighbour, stream);
+    if (audio_element_run(mHttp_neighbour) == ESP_OK && audio_element_resume(mHttp_neighbour, 0, 2000 / portTICK_RATE_MS) == ESP_OK) {
+        mNeighbourStation = next;
+        mNeighbourUrl = station.mUrl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WebRadio::StopNeighbour()
+{
+    if (mHttp_neighbour == NULL || mNeighbourStation == -2) {
+        return;
+    }
+
+    audio_element_stop(mHttp_neighbour);
+    audio_element_wait_for_stop(mHttp_neighbour);
+    audio_element_reset_state(mHttp_neighbour);
+    audio_element_reset_output_ringbuf(mHttp_neighbour);
+    mNeighbourStation = -2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// decoder type changed: stop, relink and restart the complete pipeline
+void WebRadio::AudioPipelineRelink(Station_t& station)
+{
     esp_err_t err, err1, err2;
 
+    if (mHttp_neighbour) {
+        // after a swap the active reader is not the one the pipeline has linked
+        audio_element_stop(mHttp_stream_reader);
+        audio_element_wait_for_stop(mHttp_stream_reader);
+        audio_element_reset_state(mHttp_stream_reader);
+    }
+
     err = audio_pipeline_stop(mPipeline);
     err1 = audio_pipeline_wait_for_stop(mPipeline);
     err2 = audio_pipeline_terminate(mPipeline);
     ESP_LOGI(TAG, "[ switch ] stop pipeline => %s, %s, %s", esp_err_to_name(err), esp_err_to_name(err1), esp_err_to_name(err2));
 
-    const char* link_tag[3] = { "http", station.mDecoder.c_str(), "i2s" };
+    const char* link_tag[5];
+    int link_count = GetLinkTags(link_tag, mHttpTag, station.mDecoder.c_str());
 
-    err = audio_pipeline_breakup_elements(mPipeline, mMp3_decoder);
-    err1 = audio_pipeline_breakup_elements(mPipeline, mAac_decoder);
-    ESP_LOGI(TAG, "[ switch ] pipeline breakup elements => %s, %s", esp_err_to_name(err), esp_err_to_name(err1));
+    err = mActDecoder ? audio_pipeline_breakup_elements(mPipeline, mActDecoder) : ESP_OK;
+    ESP_LOGI(TAG, "[ switch ] pipeline breakup elements => %s", esp_err_to_name(err));
 
-    err = audio_pipeline_relink(mPipeline, &link_tag[0], 3);
-    ESP_LOGI(TAG, "[ switch ] Relink it together http_stream-->audio_decoder(%s)-->i2s_stream-->[codec_chip] => %s", station.mDecoder.c_str(), esp_err_to_name(err));
+    audio_element_handle_t oldDecoder = mActDecoder;
+    GetDecoder(station.mDecoder.c_str(), true);
+
+    err = audio_pipeline_relink(mPipeline, &link_tag[0], link_count);
+    if (mHttp_neighbour) {
+        // the neighbour may have kept a ring buffer of the pipeline after a swap
+        audio_element_set_output_ringbuf(mHttp_neighbour, mNeighbourRb);
+        rb_reset(mNeighbourRb);
+    }
+    mActDecoder = GetDecoder(station.mDecoder.c_str(), false);
+    if (oldDecoder != NULL && oldDecoder != mActDecoder) {
+        mDecoderIdleTime = esp_timer_get_time(); // released after WEBRADIO_DECODER_IDLE_MS
+    }
+    ESP_LOGI(TAG, "[ switch ] Relink it together http_stream-->audio_decoder(%s)-->%sgain-->i2s_stream-->[codec_chip] => %s", station.mDecoder.c_str(), mResample_element ? "resample-->" : "", esp_err_to_name(err));
 
     err = audio_pipeline_set_listener(mPipeline, mEvt);
-    err1 = audio_element_set_uri(mHttp_stream_reader, station.mUrl.c_str());
-    ESP_LOGI(TAG, "[ switch ] Set up  uri '%s' => %s, %s", station.mUrl.c_str(), esp_err_to_name(err), esp_err_to_name(err1));
+    err1 = SetReaderUri(mHttp_stream_reader, mStream);
+    ESP_LOGI(TAG, "[ switch ] Set up  uri '%s' => %s, %s", mStream.mUrl.c_str(), esp_err_to_name(err), esp_err_to_name(err1));
 
     err = audio_pipeline_reset_ringbuffer(mPipeline);
     err1 = audio_pipeline_reset_elements(mPipeline);
@@ -326,55 +1131,129 @@ void WebRadio::AudioPipelineSwitchStation()
 
 ///////////////////////////////////////////////////////////////////////////////
 // Command Interface
+///////////////////////////////////////////////////////////////////////////////
+// commands can come from any task, they are executed in the audio event loop
+void WebRadio::PostCommand(Command_e cmd, int value)
+{
+    if (mCommandMutex == NULL) {
+        return; // before Start
+    }
+    xSemaphoreTake(mCommandMutex, portMAX_DELAY);
+    if (!mbCommandListener) {
+        xSemaphoreGive(mCommandMutex);
+        ESP_LOGW(TAG, "[ * ] No audio pipeline, command %d dropped", cmd);
+        return;
+    }
+
+    Command_t command = { cmd, value, esp_timer_get_time() };
+    bool bNotify;
+    if (!mCommands.Push(command, bNotify)) {
+        xSemaphoreGive(mCommandMutex);
+        ESP_LOGW(TAG, "[ * ] Command queue full, command %d dropped", cmd);
+        return;
+    }
+
+    // one doorbell event per batch, the commands itself stay in the ring; without the
+    // doorbell (event queue full) the loop finds them after its listen timeout
+    if (bNotify) {
+        audio_event_iface_msg_t msg = {};
+        msg.source_type = WEBRADIO_COMMAND_SOURCE;
+        if (audio_event_iface_sendout(mCommandEvt, &msg) != ESP_OK) {
+            ESP_LOGD(TAG, "[ * ] Command doorbell dropped");
+        }
+    }
+    xSemaphoreGive(mCommandMutex);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::SetStation(int actStation)
 {
-    ESP_LOGI(TAG, "[ * ] SetStation %d", actStation);
-    mData.SetActStation(actStation);
-    AudioPipelineSwitchStation();
+    PostCommand(CmdSetStation, actStation);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::SetNextStation()
 {
-    Settings_t settings;
-    mData.GetSettings(settings);
-
-    int next = settings.mActStation + 1;
-    if (next == settings.mStations.size()) {
-        next = 0;
-    }
-
-    mData.SetActStation(next);
-    AudioPipelineSwitchStation();
+    PostCommand(CmdNextStation);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::SetPreviousStation()
 {
-    Settings_t settings;
-    mData.GetSettings(settings);
-
-    int prev = settings.mActStation - 1;
-
-    if (prev < 0) {
-        prev = settings.mStations.size() - 1;
-    }
-
-    mData.SetActStation(prev);
-    AudioPipelineSwitchStation();
+    PostCommand(CmdPreviousStation);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::SetOnOff(bool bOn)
 {
+    PostCommand(CmdSetOnOff, bOn);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void WebRadio::SetVolume(int volume)
 {
-    mData.SetVolume(volume);
-    audio_hal_set_volume(mAudioBoardHandle->audio_hal, volume);
+    PostCommand(CmdSetVolume, volume);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// executes all queued commands, only the result of a burst is applied
+void WebRadio::ExecuteCommands()
+{
+    PendingCommands_t pending;
+    if (!mCommands.Drain(pending)) {
+        return;
+    }
+
+    if (pending.mbVolume || pending.mVolumeDelta != 0) {
+        int volume = pending.mbVolume ? pending.mVolume : mGain.GetVolume();
+        volume = std::min(100, std::max(0, volume + pending.mVolumeDelta));
+
+        mData.SetVolume(volume);
+        mGain.SetVolume(volume, WEBRADIO_VOLUME_RAMP_MS);
+        ESP_LOGI(TAG, "[ * ] Volume set to %d %%", volume);
+        Trace(TraceLog::Command, CmdSetVolume, volume);
+    }
+
+    if (pending.mbStation || pending.mStationDelta != 0) {
+        int station = pending.mStation;
+        if (pending.mStationDelta != 0) {
+            int count = mData.GetStationCount();
+            if (!pending.mbStation) {
+                station = mData.GetActStation();
+            }
+            if (count > 0) {
+                // from the act tune (-1) next is the first and previous the last preset
+                if (station < 0) {
+                    station = (pending.mStationDelta > 0) ? -1 : count;
+                }
+                station = (station + pending.mStationDelta) % count;
+                if (station < 0) {
+                    station += count;
+                }
+            }
+        }
+
+        ESP_LOGI(TAG, "[ * ] SetStation %d", station);
+        Trace(TraceLog::Command, CmdSetStation, station);
+        mSwitchTime = pending.mStationTime;
+        mData.SetActStation(station);
+        AudioPipelineSwitchStation();
+    }
+    else if (pending.mbResolved && mbSwitchPending) {
+        AudioPipelineSwitchStation();
+    }
+    else if (pending.mbResolved && mbReconnectPending) {
+        StreamResolver::Stream_t stream;
+        Station_t station;
+        mData.GetPlayStation(station);
+        if (mResolver.Lookup(station, false, stream)) {
+            mStream = stream;
+        }
+        Reconnect();
+    }
+    else if (pending.mbResolved && mStationStartTime == 0) {
+        WarmNeighbour(); // playback is stable
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -14,13 +14,25 @@
 #define _WEBRADIO_H_
 
 #include <string>
+#include "esp_timer.h"
+#include "freertos/semphr.h"
 #include "periph_wifi.h"
 #include "audio_pipeline.h"
+#include "http_stream.h"
 #include "periph_service.h"
 #include "board.h"
 
 #include "WifiWebRadio.h"
 #include "DataWebRadio.h"
+#include "CommandQueue.h"
+#include "JitterBuffer.h"
+#include "StreamResolver.h"
+#include "IcyReader.h"
+#include "GainStage.h"
+#include "Resampler.h"
+#include "PipelineStats.h"
+#include "TraceLog.h"
+#include "Telemetry.h"
 #include "mp3_decoder.h"
 
 extern "C" {
@@ -28,7 +40,6 @@ audio_element_handle_t create_mp3_decoder();
 audio_element_handle_t create_aac_decoder();
 audio_element_handle_t create_i2s_stream(audio_stream_type_t type);
 wifi_config_t* get_wifi_config_t();
-void esp_msg_debug(audio_event_iface_msg_t msg);
 void wifi_init_softap();
 void wifi_init_client();
 }
@@ -51,6 +62,46 @@ void wifi_init_client();
 
 extern const char* TAG;
 
+// 1: a station switch with the same decoder type restarts only http reader and decoder,
+// 0: always stop and relink the complete pipeline
+#define WEBRADIO_FAST_SWITCH 1
+// i2s stop events within this time after a station command belong to the switch
+#define WEBRADIO_SWITCH_GUARD_MS 3000
+
+// 1: a second http reader pre-buffers the next preset, next station swaps the readers
+#define WEBRADIO_WARM_NEIGHBOUR 0
+// RAM budget of the neighbour: ring buffer size and free heap that must remain
+#define WEBRADIO_NEIGHBOUR_RB_SIZE (16 * 1024)
+#define WEBRADIO_NEIGHBOUR_MIN_FREE_HEAP (48 * 1024)
+
+// fill level of the decoder input is checked with this period (adaptive pre-roll)
+#define WEBRADIO_JITTER_SAMPLE_MS 100
+// period of the bitrate measurement for the station statistics
+#define WEBRADIO_STATS_BITRATE_MS 30000
+
+// reconnect of the http reader after an error or end of stream, the delay doubles
+// with each failed attempt (+-25% jitter); after the last attempt the pipeline restarts
+#define WEBRADIO_RECONNECT_BASE_MS 200
+#define WEBRADIO_RECONNECT_MAX_MS 8000
+#define WEBRADIO_RECONNECT_ATTEMPTS 6
+
+// volume is applied in software, the codec stays at WEBRADIO_CODEC_VOLUME;
+// volume changes and station switches are ramped to avoid clicks
+#define WEBRADIO_CODEC_VOLUME 100
+#define WEBRADIO_VOLUME_RAMP_MS 50
+#define WEBRADIO_FADE_MS 30
+
+// all stations are converted to this rate, so the i2s clock is set once per session;
+// 0 removes the resampler and reclocks i2s per station
+#define WEBRADIO_RESAMPLE_RATE 44100
+#define WEBRADIO_RESAMPLE_QUALITY Resampler::Medium
+
+// only the linked decoder is kept, the other one is deleted after this idle time
+#define WEBRADIO_DECODER_IDLE_MS 30000
+
+// source type of commands posted to the audio event loop (next to AUDIO_ELEMENT_TYPE_xxx)
+#define WEBRADIO_COMMAND_SOURCE (0x01 << 25)
+
 //////////////////////////////////////////////////////////////////////
 class IWebRadioCommands {
 public:
@@ -76,8 +127,13 @@ public:
     WifiWebRadio& GetWifiWebRadio() { return mWifi; }
     DataWebRadio& GetDataWebRadio() { return mData; }
     IWebRadioCommands& GetCommandInterface() { return *this; }
+    PipelineStats& GetPipelineStats() { return mStats; }
+    int GetPipelineFill(PipelineStats::Stage_e stage); // bytes in the output ring buffer, -1 if none
+    TraceLog& GetTraceLog() { return mTrace; }
+    Telemetry& GetTelemetry() { return mTelemetry; }
+    void Trace(TraceLog::Event_e event, int32_t arg0 = 0, int32_t arg1 = 0) { mTrace.Add((uint32_t)esp_timer_get_time(), event, arg0, arg1); }
 
-    // command interface
+    // command interface, commands are queued and executed in the audio event loop
     void SetStation(int actStation);
     void SetNextStation();
     void SetPreviousStation();
@@ -88,15 +144,84 @@ private:
     void AudioPipeline();
     bool key_handler(audio_event_iface_msg_t& msg);
     void AudioPipelineSwitchStation();
+    bool AudioPipelineFastSwitch(Station_t& station, audio_element_handle_t decoder);
+    void AudioPipelineRelink(Station_t& station);
+    bool AudioPipelineSwapNeighbour(Station_t& station, audio_element_handle_t decoder);
+    void WarmNeighbour();
+    void StopNeighbour();
+    void ReportMusicInfo(audio_element_handle_t decoder);
+    audio_element_handle_t GetDecoder(const char* pType, bool bCreate);
+    void ReleaseIdleDecoder();
+    void UnregisterElement(audio_element_handle_t element);
+    void ReportHeap(const char* pWhen);
+    void FadeOut();
+    int GetLinkTags(const char* pTags[], const char* pHttpTag, const char* pDecoder);
+    void StartJitterBuffer(const Station_t& station);
+    void SampleJitterBuffer();
+    void ApplyJitterAction(JitterBuffer::Action_e action);
+    void StartStationStats(const Station_t& station);
+    bool PrepareStation(int index, Station_t& station, StreamResolver::Stream_t& stream, bool bWait); // index in the station list, -1 act tune
+    void SampleBitrate(int64_t now);
+    void ScheduleReconnect();
+    bool ServiceReconnect(); // false if the pipeline has to be restarted
+    void Reconnect();
+    esp_err_t SetReaderUri(audio_element_handle_t reader, const StreamResolver::Stream_t& stream);
+    static void resolver_done(void* pContext);
+    static int http_stream_event(http_stream_event_msg_t* msg);
+    void PostCommand(Command_e cmd, int value = 0);
+    void ExecuteCommands();
 
 private:
+    // user data of the http_stream hook, one per reader
+    typedef struct {
+        WebRadio* mpWebRadio;
+        audio_element_handle_t mReader;
+        IcyReader mIcy; // used in the reader task only
+        int64_t mReturnTime; // us, end of the last read, the ring buffer write follows
+    } HttpReader_t;
+
     esp_periph_set_handle_t mSet;
     audio_pipeline_handle_t mPipeline;
     audio_board_handle_t mAudioBoardHandle;
     audio_element_handle_t mHttp_stream_reader;
-    audio_element_handle_t mMp3_decoder;
+    const char* mHttpTag;                  // pipeline tag of mHttp_stream_reader
+    audio_element_handle_t mHttp_neighbour; // pre-buffers mNeighbourStation, NULL if disabled
+    const char* mNeighbourTag;
+    ringbuf_handle_t mNeighbourRb; // own ring buffer, not part of the pipeline
+    int mNeighbourStation;         // preset index, -2 if not warm
+    StationUrl_t mNeighbourUrl;
+    audio_element_handle_t mMp3_decoder; // created on demand, NULL if not in use
     audio_element_handle_t mAac_decoder;
+    audio_element_handle_t mI2s_stream_writer;
+    audio_element_handle_t mGain_element;
+    GainStage mGain;
+    audio_element_handle_t mResample_element; // NULL if WEBRADIO_RESAMPLE_RATE is 0
+    Resampler mResampler;
+    PipelineStats mStats;
+    TraceLog mTrace;
+    Telemetry mTelemetry;
+    audio_element_handle_t mActDecoder; // decoder linked into the pipeline
+    int64_t mSwitchTime;                // us, station command of the running switch, 0 if none
+    int64_t mSwitchBeginTime;           // us, the pipeline was switched, guards i2s stop events
+    bool mbSwitchPending;               // the switch waits for the resolver task
+    JitterBuffer mJitter;
+    StreamResolver mResolver;
+    StreamResolver::Stream_t mStream; // of the playing station
+    int64_t mJitterSampleTime;
+    StationId_t mStatsId;      // station of the statistics
+    int64_t mStationStartTime; // us, 0 after first audio
+    int64_t mBitrateTime;      // us, start of the bitrate period, 0 if not measuring
+    int64_t mBitrateBytes;
+    int mReconnectAttempts; // failed attempts since the last first audio
+    int64_t mReconnectTime; // us, due time of the pending reconnect, 0 if none
+    bool mbReconnectPending; // the reconnect waits for the resolver task
+    int64_t mDecoderIdleTime; // us, since the unlinked decoder is idle
+    HttpReader_t mHttpReaders[2];
     audio_event_iface_handle_t mEvt;
+    audio_event_iface_handle_t mCommandEvt; // doorbell of mCommands, created once, mEvt listens while the pipeline runs
+    SemaphoreHandle_t mCommandMutex;         // listener of mCommandEvt against PostCommand
+    bool mbCommandListener;                  // mEvt listens to mCommandEvt
+    CommandQueue mCommands;
 
     WifiWebRadio mWifi;
     DataWebRadio mData;
@@ -11,6 +11,7 @@
 ****************************************************************************************/
 
 #include <string.h>
+#include <algorithm>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -32,10 +33,12 @@
 #include "WifiWebRadio.h"
 
 #define AP_MAX_STA_CONN 4
-#define UDP_PORT 44948
 
 //EventGroupHandle_t WifiWebRadio::s_wifi_event_group;
 WebRadio* WifiWebRadio::mWebRadio = 0;
+ControlClient_t WifiWebRadio::mClients[CONTROL_MAX_CLIENTS];
+char WifiWebRadio::mUdpBuffer[CONTROL_BUFFER_SIZE];
+char WifiWebRadio::mResponse[CONTROL_BUFFER_SIZE];
 
 ///////////////////////////////////////////////////////////////////////////////
 WifiWebRadio::WifiWebRadio()
@@ -80,7 +83,9 @@ esp_err_t WifiWebRadio::StartClient(WebRadio* webRadio, esp_periph_set_handle_t&
 
     ESP_LOGI(TAG, "[ WIFI ] Connect to ap SSID:%s", credentials.mSSID.c_str());
 
-    xTaskCreate(udp_server_task, "udp_server", 2 * 4096, NULL, 5, NULL);
+    TaskHandle_t task = NULL;
+    xTaskCreate(control_server_task, "control_server", CONTROL_TASK_STACK_CLIENT, NULL, 5, &task);
+    webRadio->GetTelemetry().AddTask("control_server", CONTROL_TASK_STACK_CLIENT, task);
 
     // get and set own ip
     tcpip_adapter_ip_info_t sta_ip;
@@ -101,7 +106,9 @@ esp_err_t WifiWebRadio::StartAccessPoint(WebRadio* webRadio, esp_periph_set_hand
     mWebRadio = webRadio;
     wifi_init_softap();
 
-    xTaskCreate(udp_server_task, "udp_server", 4096, NULL, 5, NULL);
+    TaskHandle_t task = NULL;
+    xTaskCreate(control_server_task, "control_server", CONTROL_TASK_STACK_AP, NULL, 5, &task);
+    webRadio->GetTelemetry().AddTask("control_server", CONTROL_TASK_STACK_AP, task);
 
     // get and set own ip
     tcpip_adapter_ip_info_t sta_ip;
@@ -114,98 +121,288 @@ esp_err_t WifiWebRadio::StartAccessPoint(WebRadio* webRadio, esp_periph_set_hand
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void WifiWebRadio::udp_server_task(void* pvParameters)
+// udp discovery and tcp control connections are served by one select() loop,
+// slow commands (station switch, volume) are queued to the audio task
+void WifiWebRadio::control_server_task(void* pvParameters)
 {
-    char buffer[1024];
-    char addr_str[128];
-    int addr_family;
-    int ip_protocol;
     DataWebRadio& data = mWebRadio->GetDataWebRadio();
 
-    while (1) {
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        mClients[i].mSock = -1;
+        CloseClient(mClients[i]);
+    }
 
-        //#ifdef CONFIG_EXAMPLE_IPV4
+    while (1) {
         struct sockaddr_in destAddr;
         destAddr.sin_addr.s_addr = htonl(INADDR_ANY);
         destAddr.sin_family = AF_INET;
         destAddr.sin_port = htons(UDP_PORT);
-        addr_family = AF_INET;
-        ip_protocol = IPPROTO_IP;
-        inet_ntoa_r(destAddr.sin_addr, addr_str, sizeof(addr_str) - 1);
-        /*#else // IPV6
-        struct sockaddr_in6 destAddr;
-        bzero(&destAddr.sin6_addr.un, sizeof(destAddr.sin6_addr.un));
-        destAddr.sin6_family = AF_INET6;
-        destAddr.sin6_port = htons(UDP_PORT);
-        addr_family = AF_INET6;
-        ip_protocol = IPPROTO_IPV6;
-        inet6_ntoa_r(destAddr.sin6_addr, addr_str, sizeof(addr_str) - 1);
-#endif
-*/
-        int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-        if (sock < 0) {
+
+        int udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (udpSock < 0) {
             ESP_LOGE(TAG, "[ UDP ] Unable to create socket: errno %d", errno);
             break;
         }
-        ESP_LOGI(TAG, "[ UDP ] Socket created");
-
-        int err = bind(sock, (struct sockaddr*)&destAddr, sizeof(destAddr));
-        if (err < 0) {
+        if (bind(udpSock, (struct sockaddr*)&destAddr, sizeof(destAddr)) < 0) {
             ESP_LOGE(TAG, "[ UDP ] Socket unable to bind: errno %d", errno);
         }
-        ESP_LOGI(TAG, "[ UDP ] Socket binded");
+        ESP_LOGI(TAG, "[ UDP ] Socket binded, port %d", UDP_PORT);
+
+        // tcp control port is optional, discovery keeps working without it
+        destAddr.sin_port = htons(TCP_PORT);
+        int listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+        if (listenSock >= 0) {
+            int opt = 1;
+            setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+            if (bind(listenSock, (struct sockaddr*)&destAddr, sizeof(destAddr)) < 0 || listen(listenSock, 2) < 0) {
+                ESP_LOGE(TAG, "[ TCP ] Socket unable to listen: errno %d", errno);
+                close(listenSock);
+                listenSock = -1;
+            }
+            else {
+                ESP_LOGI(TAG, "[ TCP ] Listening, port %d", TCP_PORT);
+            }
+        }
 
         while (1) {
+            fd_set readSet;
+            fd_set writeSet;
+            FD_ZERO(&readSet);
+            FD_ZERO(&writeSet);
+            FD_SET(udpSock, &readSet);
+            int maxSock = udpSock;
+            bool bSubscribed = false;
+
+            if (listenSock >= 0) {
+                FD_SET(listenSock, &readSet);
+                maxSock = std::max(maxSock, listenSock);
+            }
+            for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+                if (mClients[i].mSock >= 0) {
+                    // a client with a pending response is not read until it is sent
+                    FD_SET(mClients[i].mSock, mClients[i].mOutLen > 0 ? &writeSet : &readSet);
+                    maxSock = std::max(maxSock, mClients[i].mSock);
+                    bSubscribed |= mClients[i].mbSubscribed;
+                }
+            }
 
-            ESP_LOGI(TAG, "[ UDP ] Waiting for data udp");
-            struct sockaddr_in6 sourceAddr; // Large enough for both IPv4 or IPv6
-            socklen_t socklen = sizeof(sourceAddr);
-            int len = recvfrom(sock, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&sourceAddr, &socklen);
-
-            // Error occured during receiving
-            if (len < 0) {
-                ESP_LOGE(TAG, "[ UDP ] recvfrom failed: errno %d", errno);
+            // subscribed clients: wake up periodically to push new titles
+            struct timeval timeout = { 0, CONTROL_PUSH_INTERVAL_MS * 1000 };
+            if (select(maxSock + 1, &readSet, &writeSet, NULL, bSubscribed ? &timeout : NULL) < 0) {
+                ESP_LOGE(TAG, "[ UDP ] select failed: errno %d", errno);
                 break;
             }
-            // Data received
-            else {
-                // Get the sender's ip address as string
-                if (sourceAddr.sin6_family == PF_INET) {
-                    inet_ntoa_r(((struct sockaddr_in*)&sourceAddr)->sin_addr.s_addr, addr_str, sizeof(addr_str) - 1);
+
+            if (FD_ISSET(udpSock, &readSet)) {
+                HandleUdp(udpSock, data);
+            }
+            if (listenSock >= 0 && FD_ISSET(listenSock, &readSet)) {
+                AcceptClient(listenSock);
+            }
+            for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+                if (mClients[i].mSock >= 0 && FD_ISSET(mClients[i].mSock, &writeSet)) {
+                    // the rest of the response, then the requests that came meanwhile
+                    if (!SendPending(mClients[i]) || !HandleRequests(mClients[i], data)) {
+                        CloseClient(mClients[i]);
+                    }
                 }
-                else if (sourceAddr.sin6_family == PF_INET6) {
-                    inet6_ntoa_r(sourceAddr.sin6_addr, addr_str, sizeof(addr_str) - 1);
+                if (mClients[i].mSock >= 0 && FD_ISSET(mClients[i].mSock, &readSet)) {
+                    if (!HandleClient(mClients[i], data)) {
+                        CloseClient(mClients[i]);
+                    }
                 }
-                buffer[len] = 0; // Null-terminate whatever we received and treat like a string...
+                if (mClients[i].mSock >= 0 && mClients[i].mbSubscribed && !PushNowPlaying(mClients[i], data)) {
+                    CloseClient(mClients[i]);
+                }
+            }
+        }
+
+        ESP_LOGE(TAG, "[ UDP ] Shutting down sockets and restarting...");
+        for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+            CloseClient(mClients[i]);
+        }
+        if (listenSock >= 0) {
+            close(listenSock);
+        }
+        shutdown(udpSock, 0);
+        close(udpSock);
+    }
+    vTaskDelete(NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// one datagram is one request, the response must fit into one datagram
+void WifiWebRadio::HandleUdp(int sock, DataWebRadio& data)
+{
+    struct sockaddr_in6 sourceAddr; // Large enough for both IPv4 or IPv6
+    socklen_t socklen = sizeof(sourceAddr);
+    int len = recvfrom(sock, mUdpBuffer, sizeof(mUdpBuffer) - 1, 0, (struct sockaddr*)&sourceAddr, &socklen);
+    if (len < 0) {
+        ESP_LOGE(TAG, "[ UDP ] recvfrom failed: errno %d", errno);
+        return;
+    }
+    mUdpBuffer[len] = 0; // Null-terminate whatever we received and treat like a string...
 
-                DataWebRadio::MessageType_e msgType = data.IsWebRadioRequest(buffer);
+    size_t size = HandleRequest(data, mUdpBuffer, mResponse, CONTROL_BUFFER_SIZE);
+    if (size > 0) {
+        if (sendto(sock, mResponse, size, 0, (struct sockaddr*)&sourceAddr, socklen) < 0) {
+            ESP_LOGE(TAG, "[ UDP ] Error occured during sending: errno %d", errno);
+        }
+    }
+}
 
-                if (msgType != DataWebRadio::NoWebRadioRequest) {
-                    ESP_LOGI(TAG, "[ UDP ] Received udp  %d bytes from %s:", len, addr_str);
-                    ESP_LOGI(TAG, "[ UDP ] rx: %s", buffer);
+///////////////////////////////////////////////////////////////////////////////
+void WifiWebRadio::AcceptClient(int listenSock)
+{
+    struct sockaddr_in sourceAddr;
+    socklen_t socklen = sizeof(sourceAddr);
+    int sock = accept(listenSock, (struct sockaddr*)&sourceAddr, &socklen);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "[ TCP ] accept failed: errno %d", errno);
+        return;
+    }
 
-                    data.HandleMessage(msgType, buffer, sizeof(buffer));
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (mClients[i].mSock < 0) {
+            char addr_str[16];
+            inet_ntoa_r(sourceAddr.sin_addr, addr_str, sizeof(addr_str));
+            ESP_LOGI(TAG, "[ TCP ] Client %d connected from %s", i, addr_str);
 
-                    ////////////////////////////////////
-                    if (data.CreateMessageResponse(msgType, buffer, sizeof(buffer))) {
-                        ESP_LOGI(TAG, "[ UDP ] tx: %s", buffer);
+            CloseClient(mClients[i]);
+            mClients[i].mSock = sock;
+            return;
+        }
+    }
 
-                        len = strlen(buffer);
-                        int err = sendto(sock, buffer, len, 0, (struct sockaddr*)&sourceAddr, sizeof(sourceAddr));
-                        if (err < 0) {
-                            ESP_LOGE(TAG, "[ UDP ] Error occured during sending: errno %d", errno);
-                            break;
-                        }
-                    }
+    ESP_LOGW(TAG, "[ TCP ] Too many clients, connection refused");
+    close(sock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// returns false if the connection has to be closed
+bool WifiWebRadio::HandleClient(ControlClient_t& client, DataWebRadio& data)
+{
+    int len = recv(client.mSock, client.mBuffer + client.mLen, sizeof(client.mBuffer) - 1 - client.mLen, 0);
+    if (len <= 0) {
+        return false;
+    }
+    client.mLen += len;
+    return HandleRequests(client, data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// handles the complete requests in the buffer until a response is pending,
+// keeps the rest for the next recv; false if the connection has to be closed
+bool WifiWebRadio::HandleRequests(ControlClient_t& client, DataWebRadio& data)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < client.mLen && client.mOutLen == 0; i++) {
+        if (client.mBuffer[i] != '\n' && client.mBuffer[i] != 0) {
+            continue;
+        }
+        client.mBuffer[i] = 0;
+
+        if (i > start) {
+            size_t size = HandleRequest(data, client.mBuffer + start, client.mOut, sizeof(client.mOut) - 1, &client);
+            if (size > 0) {
+                client.mOut[size++] = '\n';
+                client.mOutLen = size;
+                client.mOutPos = 0;
+                if (!SendPending(client)) {
+                    return false;
                 }
             }
         }
+        start = i + 1;
+    }
+
+    client.mLen -= start;
+    memmove(client.mBuffer, client.mBuffer + start, client.mLen);
+
+    if (client.mLen == sizeof(client.mBuffer) - 1 && client.mOutLen == 0) {
+        ESP_LOGE(TAG, "[ TCP ] Request too long");
+        return false;
+    }
+    return true;
+}
 
-        if (sock != -1) {
-            ESP_LOGE(TAG, "[ UDP ] Shutting down socket and restarting...");
-            shutdown(sock, 0);
-            close(sock);
+///////////////////////////////////////////////////////////////////////////////
+// sends what the socket takes without blocking, the rest follows when select reports
+// the socket writable; false on a real error
+bool WifiWebRadio::SendPending(ControlClient_t& client)
+{
+    while (client.mOutPos < client.mOutLen) {
+        int len = send(client.mSock, client.mOut + client.mOutPos, client.mOutLen - client.mOutPos, MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            ESP_LOGE(TAG, "[ TCP ] Error occured during sending: errno %d", errno);
+            return false;
         }
+        client.mOutPos += len;
     }
-    vTaskDelete(NULL);
+    client.mOutLen = 0;
+    client.mOutPos = 0;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WifiWebRadio::CloseClient(ControlClient_t& client)
+{
+    if (client.mSock >= 0) {
+        ESP_LOGI(TAG, "[ TCP ] Client disconnected");
+        shutdown(client.mSock, 0);
+        close(client.mSock);
+    }
+    client.mSock = -1;
+    client.mLen = 0;
+    client.mbSubscribed = false;
+    client.mOutLen = 0;
+    client.mOutPos = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sends the title if it changed since the last push, false if the connection has to be closed;
+// waits while a response is pending
+bool WifiWebRadio::PushNowPlaying(ControlClient_t& client, DataWebRadio& data)
+{
+    uint32_t sequence = data.GetNowPlayingSequence();
+    if (sequence == client.mNowPlaying || client.mOutLen > 0) {
+        return true;
+    }
+    client.mNowPlaying = sequence;
+
+    if (!data.CreateMessageResponse(DataWebRadio::NowPlaying, client.mOut, sizeof(client.mOut) - 1)) {
+        return true;
+    }
+    size_t size = strlen(client.mOut);
+    client.mOut[size++] = '\n';
+    client.mOutLen = size;
+    client.mOutPos = 0;
+    return SendPending(client);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// returns the length of the response in buffer response, 0 if there is none;
+// pClient: tcp connection of the request, NULL for udp
+size_t WifiWebRadio::HandleRequest(DataWebRadio& data, char* request, char* response, size_t size, ControlClient_t* pClient)
+{
+    DataWebRadio::MessageType_e msgType = data.IsWebRadioRequest(request);
+    if (msgType == DataWebRadio::NoWebRadioRequest) {
+        return 0;
+    }
+    ESP_LOGI(TAG, "[ UDP ] rx: %s", request);
+
+    data.HandleMessage(msgType, request, strlen(request) + 1);
+    if (pClient != NULL && msgType == DataWebRadio::NowPlaying) {
+        pClient->mbSubscribed = data.GetSubscribe();
+        pClient->mNowPlaying = data.GetNowPlayingSequence(); // the response is the current title
+    }
+
+    if (!data.CreateMessageResponse(msgType, response, size)) {
+        return 0;
+    }
+    ESP_LOGI(TAG, "[ UDP ] tx: %s", response);
+    return strlen(response);
 }
@@ -16,6 +16,29 @@
 #include "periph_wifi.h"
 
 class WebRadio;
+class DataWebRadio;
+
+#define UDP_PORT 44948
+#define TCP_PORT 44949
+#define CONTROL_MAX_CLIENTS 3
+#define CONTROL_BUFFER_SIZE 1024
+#define CONTROL_TCP_RESPONSE_SIZE 2048
+#define CONTROL_PUSH_INTERVAL_MS 500 // new titles are pushed to subscribed clients
+#define CONTROL_TASK_STACK_CLIENT (2 * 4096) // see the "telemetry" message before changing
+#define CONTROL_TASK_STACK_AP 4096
+
+// tcp control connection, requests are separated by '\n' or '\0';
+// one response at a time, the next request is handled when it is sent completely
+typedef struct {
+    int mSock;
+    size_t mLen;
+    bool mbSubscribed;    // now_playing is pushed
+    uint32_t mNowPlaying; // sequence of the last pushed title
+    char mBuffer[CONTROL_BUFFER_SIZE];
+    size_t mOutLen; // response in mOut, 0 if none
+    size_t mOutPos; // sent part of the response
+    char mOut[CONTROL_TCP_RESPONSE_SIZE];
+} ControlClient_t;
 
 //////////////////////////////////////////////////////////////////////
 class WifiWebRadio {
@@ -29,12 +52,23 @@ public:
     static esp_err_t event_handler(void* ctx, system_event_t* event);
 
 private:
-    static void udp_server_task(void* pvParameters);
+    static void control_server_task(void* pvParameters);
+    static void HandleUdp(int sock, DataWebRadio& data);
+    static void AcceptClient(int listenSock);
+    static bool HandleClient(ControlClient_t& client, DataWebRadio& data);
+    static bool HandleRequests(ControlClient_t& client, DataWebRadio& data);
+    static bool SendPending(ControlClient_t& client);
+    static void CloseClient(ControlClient_t& client);
+    static bool PushNowPlaying(ControlClient_t& client, DataWebRadio& data);
+    static size_t HandleRequest(DataWebRadio& data, char* request, char* response, size_t size, ControlClient_t* pClient = NULL);
 
 private:
     /* FreeRTOS event group to signal when we are connected*/
     // EventGroupHandle_t s_wifi_event_group;
     static WebRadio* mWebRadio;
+    static ControlClient_t mClients[CONTROL_MAX_CLIENTS];
+    static char mUdpBuffer[CONTROL_BUFFER_SIZE];
+    static char mResponse[CONTROL_BUFFER_SIZE]; // udp, tcp responses are in the client
     std::string mId;
     std::string mIp;
 };
@@ -13,8 +13,10 @@
 #ifndef DATA_JSON_INTERFACE_H
 #define DATA_JSON_INTERFACE_H
 
+#include <stdint.h>
+#include <string.h>
 #include <string>
-#include <vector>
+#include <algorithm>
 
 ///////////////////////////////////////////////////////////////////////////////
 #define LYRAT_NET_WEBRADIO "webradio"
@@ -38,82 +40,240 @@
 #define LYRAT_NET_RADIO "radio"
 #define LYRAT_NET_VOLUME "volume"
 #define LYRAT_NET_ACTSTATION "act"
+#define LYRAT_NET_ERROR "error" // of a rejected configuration
+#define LYRAT_NET_ERR_STATION_SIZE "station_too_long"
+#define LYRAT_NET_ERR_LIST_SIZE "station_list_too_large"
 
 #define LYRAT_NET_PLAYIDS "playids"
 #define LYRAT_NET_CHECK "check"
 
+#define LYRAT_NET_STATIONSTATS "station_stats"
+#define LYRAT_NET_PLAYS "plays"
+#define LYRAT_NET_TTFA "ttfa_ms"
+#define LYRAT_NET_UNDERRUNS "underruns"
+#define LYRAT_NET_BITRATE "kbps"
+#define LYRAT_NET_RECONNECTS "reconnects"
+#define LYRAT_NET_LASTERROR "last_error"
+#define LYRAT_NET_SCORE "score"
+
+#define LYRAT_NET_NOWPLAYING "now_playing"
+#define LYRAT_NET_TITLE "title"
+#define LYRAT_NET_SUBSCRIBE "subscribe"
+
+#define LYRAT_NET_STATS "stats"
+#define LYRAT_NET_UPTIME "uptime_ms"
+#define LYRAT_NET_STAGES "stages"
+#define LYRAT_NET_STAGE "stage"
+#define LYRAT_NET_KB_IN "kb_in"
+#define LYRAT_NET_KB_OUT "kb_out"
+#define LYRAT_NET_READ_WAIT "read_wait_ms"
+#define LYRAT_NET_WRITE_WAIT "write_wait_ms"
+#define LYRAT_NET_PROCESS "process_ms"
+#define LYRAT_NET_CHUNKS "chunks"
+#define LYRAT_NET_FILL "fill"
+
+#define LYRAT_NET_TRACE "trace"
+#define LYRAT_NET_FROM "from"
+#define LYRAT_NET_NEXT "next"
+#define LYRAT_NET_HEAD "head"
+#define LYRAT_NET_LOST "lost"
+#define LYRAT_NET_NOW "now_us"
+#define LYRAT_NET_DATA "data"
+
+#define LYRAT_NET_TELEMETRY "telemetry"
+#define LYRAT_NET_HEAP "heap"
+#define LYRAT_NET_FREE "free"
+#define LYRAT_NET_MIN_FREE "min_free"
+#define LYRAT_NET_LARGEST "largest"
+#define LYRAT_NET_MIN_LARGEST "min_largest"
+#define LYRAT_NET_TASKS "tasks"
+#define LYRAT_NET_STACK "stack"
+#define LYRAT_NET_STACK_FREE "stack_free"
+#define LYRAT_NET_ALLOCS "allocs"
+#define LYRAT_NET_COUNT "count"
+#define LYRAT_NET_FREES "frees"
+#define LYRAT_NET_BYTES "bytes"
+
+#define LYRAT_NET_PLAYID "play_id"
+#define LYRAT_NET_REMOVEID "remove_id"
+#define LYRAT_NET_FOUND "found"
+#define LYRAT_NET_INDEX "index"
+
 ///////////////////////////////////////////////////////////////////////////////
-typedef struct Station {
-    Station()
-        : mId("")
-        , mUrl("")
-        , mDecoder("")
-    {
-    }
-    Station(std::string id, std::string url, std::string decoder)
-        : mId(id)
-        , mUrl(url)
-        , mDecoder(decoder)
+// capacities of the settings, including the terminating 0
+#define LYRAT_STATION_ID_SIZE 40
+#define LYRAT_STATION_URL_SIZE 256
+#define LYRAT_STATION_DECODER_SIZE 8
+#define LYRAT_SSID_SIZE 33
+#define LYRAT_PASSWORD_SIZE 65
+#define LYRAT_BT_PAIR_SIZE 64
+#define LYRAT_RADIO_NAME_SIZE 64
+#define LYRAT_MAX_STATIONS 32
+
+///////////////////////////////////////////////////////////////////////////////
+// string of at most N - 1 characters stored inline, no heap; longer values are cut
+template <size_t N>
+class FixedString {
+public:
+    FixedString()
+        : mLength(0)
     {
+        mData[0] = 0;
     }
-    Station& operator=(const Station& src)
+    FixedString(const char* pStr) { Assign(pStr); }
+    FixedString(const FixedString& src) { Assign(src.mData, src.mLength); }
+    FixedString& operator=(const FixedString& src)
     {
         if (this != &src) {
-            mId = src.mId;
-            mUrl = src.mUrl;
-            mDecoder = src.mDecoder;
+            Assign(src.mData, src.mLength);
         }
         return *this;
     }
+    FixedString& operator=(const char* pStr)
+    {
+        Assign(pStr);
+        return *this;
+    }
+    FixedString& operator=(const std::string& str)
+    {
+        Assign(str.data(), str.length());
+        return *this;
+    }
+
+    // false if the value was cut
+    bool Assign(const char* pStr) { return Assign(pStr, strlen(pStr)); }
+    bool Assign(const char* pStr, size_t length)
+    {
+        bool bFit = length < N;
+        mLength = bFit ? length : N - 1;
+        memmove(mData, pStr, mLength);
+        mData[mLength] = 0;
+        return bFit;
+    }
+    void clear()
+    {
+        mLength = 0;
+        mData[0] = 0;
+    }
+
+    const char* c_str() const { return mData; }
+    const char* data() const { return mData; }
+    size_t length() const { return mLength; }
+    bool empty() const { return mLength == 0; }
+    static size_t capacity() { return N - 1; }
+
+    inline bool operator==(const FixedString& rhs) const { return mLength == rhs.mLength && memcmp(mData, rhs.mData, mLength) == 0; }
+    inline bool operator!=(const FixedString& rhs) const { return !(*this == rhs); }
+    inline bool operator==(const char* pStr) const { return strcmp(mData, pStr) == 0; }
+    inline bool operator!=(const char* pStr) const { return !(*this == pStr); }
+
+private:
+    uint16_t mLength;
+    char mData[N];
+};
+
+typedef FixedString<LYRAT_STATION_ID_SIZE> StationId_t;
+typedef FixedString<LYRAT_STATION_URL_SIZE> StationUrl_t;
+typedef FixedString<LYRAT_RADIO_NAME_SIZE> RadioName_t;
+
+///////////////////////////////////////////////////////////////////////////////
+typedef struct Station {
+    Station()
+    {
+    }
+    Station(const char* pId, const char* pUrl, const char* pDecoder)
+        : mId(pId)
+        , mUrl(pUrl)
+        , mDecoder(pDecoder)
+    {
+    }
     inline bool operator==(const Station& rhs) const
     {
         return (mId == rhs.mId) && (mUrl == rhs.mUrl) && (mDecoder == rhs.mDecoder);
     }
     inline bool operator!=(const Station& rhs) const { return !(*this == rhs); }
-    std::string mId;
-    std::string mUrl;
-    std::string mDecoder;
+    StationId_t mId;
+    StationUrl_t mUrl;
+    FixedString<LYRAT_STATION_DECODER_SIZE> mDecoder;
 } Station_t;
 
 ///////////////////////////////////////////////////////////////////////////////
-typedef struct Credentials {
-    Credentials()
-        : mSSID("")
-        , mPassword("")
+// presets, at most LYRAT_MAX_STATIONS
+class StationList {
+public:
+    StationList()
+        : mCount(0)
     {
     }
-    Credentials& operator=(const Credentials& src)
+    StationList& operator=(const StationList& src)
     {
         if (this != &src) {
-            mSSID = src.mSSID;
-            mPassword = src.mPassword;
+            mCount = src.mCount;
+            std::copy(src.begin(), src.end(), mStations);
         }
         return *this;
     }
+    inline bool operator==(const StationList& rhs) const
+    {
+        return mCount == rhs.mCount && std::equal(begin(), end(), rhs.begin());
+    }
+    inline bool operator!=(const StationList& rhs) const { return !(*this == rhs); }
+
+    int size() const { return mCount; }
+    bool empty() const { return mCount == 0; }
+    static int capacity() { return LYRAT_MAX_STATIONS; }
+    void clear() { mCount = 0; }
+    bool push_back(const Station_t& st) // false if full
+    {
+        if (mCount >= LYRAT_MAX_STATIONS) {
+            return false;
+        }
+        mStations[mCount++] = st;
+        return true;
+    }
+    void erase(int i) // following presets move up
+    {
+        if (i >= 0 && i < mCount) {
+            std::copy(mStations + i + 1, mStations + mCount, mStations + i);
+            mCount--;
+        }
+    }
+    void resize(int count) // limited to the capacity, new entries are empty
+    {
+        count = std::max(0, std::min(count, LYRAT_MAX_STATIONS));
+        std::fill(mStations + std::min(mCount, count), mStations + count, Station_t());
+        mCount = count;
+    }
+
+    Station_t& operator[](int i) { return mStations[i]; }
+    const Station_t& operator[](int i) const { return mStations[i]; }
+    const Station_t* begin() const { return mStations; }
+    const Station_t* end() const { return mStations + mCount; }
+
+    StationList(const StationList&) = delete; // no copies of the complete table on the stack
+
+private:
+    int mCount;
+    Station_t mStations[LYRAT_MAX_STATIONS];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+typedef struct Credentials {
     inline bool operator==(const Credentials& rhs) const
     {
         return (mSSID == rhs.mSSID) && (mPassword == rhs.mPassword);
     }
     inline bool operator!=(const Credentials& rhs) const { return !(*this == rhs); }
-    std::string mSSID;
-    std::string mPassword;
+    FixedString<LYRAT_SSID_SIZE> mSSID;
+    FixedString<LYRAT_PASSWORD_SIZE> mPassword;
 } Credentials_t;
 
 ///////////////////////////////////////////////////////////////////////////////
 typedef struct Bluetooth {
     Bluetooth()
         : mbEnabled(false)
-        , mPair("")
     {
     }
-    Bluetooth& operator=(const Bluetooth& src)
-    {
-        if (this != &src) {
-            mbEnabled = src.mbEnabled;
-            mPair = src.mPair;
-        }
-        return *this;
-    }
     inline bool operator==(const Bluetooth& rhs) const
     {
         return (mbEnabled == rhs.mbEnabled) && (mPair == rhs.mPair);
@@ -121,10 +281,11 @@ typedef struct Bluetooth {
     inline bool operator!=(const Bluetooth& rhs) const { return !(*this == rhs); }
 
     bool mbEnabled;
-    std::string mPair;
+    FixedString<LYRAT_BT_PAIR_SIZE> mPair;
 } Bluetooth_t;
 
 ///////////////////////////////////////////////////////////////////////////////
+// about 11 KB, lives once in the settings cache; readers take single values or a view
 typedef struct ActualSettings {
     ActualSettings()
         : mVolume(50)
@@ -136,9 +297,7 @@ typedef struct ActualSettings {
         if (this != &src) {
             mCredentials = src.mCredentials;
             mBluetooth = src.mBluetooth;
-            for (size_t i = 0; i < sizeof(mStations) / sizeof(Station_t); i++) {
-                mStations[i] = src.mStations[i];
-            }
+            mStations = src.mStations;
             mActTune = src.mActTune;
             mRadioName = src.mRadioName;
             mVolume = src.mVolume;
@@ -151,9 +310,7 @@ typedef struct ActualSettings {
         bool bEqual = (mRadioName == rhs.mRadioName) && (mVolume == rhs.mVolume) && (mActStation == rhs.mActStation);
         bEqual &= mCredentials == rhs.mCredentials;
         bEqual &= mBluetooth == rhs.mBluetooth;
-        for (size_t i = 0; i < mStations.size(); i++) {
-            bEqual &= mStations[i] == rhs.mStations[i];
-        }
+        bEqual &= mStations == rhs.mStations;
         bEqual &= mActTune == rhs.mActTune;
 
         return bEqual;
@@ -162,9 +319,9 @@ typedef struct ActualSettings {
 
     Credentials_t mCredentials;
     Bluetooth_t mBluetooth;
-    std::vector<Station_t> mStations;
+    StationList mStations;
     Station_t mActTune;
-    std::string mRadioName;
+    RadioName_t mRadioName;
     int mVolume;
     int mActStation;
 } Settings_t;
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+#
+#  WebRadio - Internet radio using Espressif's Lyrat board
+#  Written by Sebastian Hinz, http://radio-online.eu/
+#
+#  This code is in the Public Domain (or CC0 licensed, at your option.)
+#
+#  Decodes the binary trace ring (main/TraceLog.h) into Chrome trace JSON,
+#  to be opened in chrome://tracing or https://ui.perfetto.dev
+#
+#  Read the ring from the radio:
+#      trace_decode.py --host 192.168.1.20 -o trace.json
+#  or decode saved trace responses (one json per line):
+#      trace_decode.py responses.txt -o trace.json
+
+import argparse
+import base64
+import json
+import socket
+import struct
+import sys
+
+TCP_PORT = 44949  # WifiWebRadio.h
+ENTRY = struct.Struct("<IHHii")  # TraceLog::Entry_t
+
+# TraceLog::Event_e
+EVENTS = {
+    1: "audio_event",
+    2: "command",
+    3: "switch_begin",
+    4: "switch_end",
+    5: "music_info",
+    6: "jitter_pause",
+    7: "jitter_resume",
+    8: "http_error",
+    9: "reconnect",
+    10: "configuration",
+    11: "decoder_create",
+    12: "decoder_release",
+    13: "resolve_begin",
+    14: "resolve_end",
+}
+
+# audio_element_type_t of ESP-ADF audio_common.h and WEBRADIO_COMMAND_SOURCE
+SOURCE_TYPES = {
+    0x01 << 20: "unknown",
+    0x01 << 21: "element",
+    0x01 << 22: "player",
+    0x01 << 23: "service",
+    0x01 << 24: "periph",
+    0x01 << 25: "webradio_command",
+}
+
+# audio_element_msg_cmd_t of ESP-ADF audio_element.h
+ELEMENT_CMDS = {
+    0: "none",
+    1: "error",
+    2: "finish",
+    3: "stop",
+    4: "pause",
+    5: "resume",
+    6: "destroy",
+    8: "report_status",
+    9: "report_music_info",
+    10: "report_codec_fmt",
+    11: "report_position",
+}
+
+# CommandQueue.h Command_e
+COMMANDS = ["set_station", "next_station", "previous_station", "set_on_off", "set_volume", "change_volume", "resolved"]
+
+SWITCH_KINDS = ["relink", "fast", "neighbour"]
+
+
+def fetch(host, port):
+    """reads the ring page by page until the head is reached"""
+    pages = []
+    with socket.create_connection((host, port), timeout=5) as sock:
+        stream = sock.makefile("rwb")
+        position = 0
+        while True:
+            request = {"webradio": {"trace": {"from": position}}}
+            stream.write((json.dumps(request) + "\n").encode())
+            stream.flush()
+            response = json.loads(stream.readline())
+            trace = response["webradio"]["trace"]
+            pages.append(trace)
+            if trace["next"] == position or trace["next"] >= trace["head"]:
+                break
+            position = trace["next"]
+    return pages
+
+
+def read_pages(files):
+    pages = []
+    for name in files:
+        with (sys.stdin if name == "-" else open(name)) as f:
+            for line in f:
+                line = line.strip()
+                if line:
+                    pages.append(json.loads(line)["webradio"]["trace"])
+    return pages
+
+
+def decode(pages):
+    entries = []
+    lost = 0
+    for page in pages:
+        lost += page.get("lost", 0)
+        data = base64.b64decode(page["data"]) if page["data"] else b""
+        for offset in range(0, len(data) - ENTRY.size + 1, ENTRY.size):
+            entries.append(ENTRY.unpack_from(data, offset))
+    return entries, lost
+
+
+def audio_event_args(arg0, arg1):
+    cmd = (arg1 >> 16) & 0xFFFF
+    data = arg1 & 0xFFFF
+    source = SOURCE_TYPES.get(arg0)
+    if source is None and arg0 > (0x01 << 24) and arg0 < (0x01 << 25):
+        source = "periph+%d" % (arg0 - (0x01 << 24))
+    args = {"source": source or hex(arg0), "cmd": cmd, "data": data}
+    if arg0 == 0x01 << 21:
+        args["cmd"] = ELEMENT_CMDS.get(cmd, cmd)
+    return args
+
+
+def to_chrome(entries):
+    events = []
+    time = 0
+    last = None
+    for raw_time, event, seq, arg0, arg1 in entries:
+        # the 32 bit us timestamp wraps after 71 minutes
+        if last is not None:
+            time += (raw_time - last) & 0xFFFFFFFF
+        last = raw_time
+
+        name = EVENTS.get(event, "event_%d" % event)
+        record = {"name": name, "ts": time, "pid": 1, "tid": 1, "args": {"seq": seq}}
+
+        if event == 1:
+            record["args"].update(audio_event_args(arg0, arg1))
+        elif event == 2:
+            record["args"]["command"] = COMMANDS[arg0] if 0 <= arg0 < len(COMMANDS) else arg0
+            record["args"]["value"] = arg1
+        elif event == 5:
+            record["args"].update({"sample_rate": arg0, "bits": arg1 >> 8, "channels": arg1 & 0xFF})
+        else:
+            record["args"].update({"arg0": arg0, "arg1": arg1})
+
+        # switches and stalls as durations
+        if event == 3:
+            record.update({"name": "switch", "ph": "B"})
+            record["args"] = {"station": arg0}
+        elif event == 4:
+            record.update({"name": "switch", "ph": "E"})
+            record["args"] = {"station": arg0, "kind": SWITCH_KINDS[arg1] if 0 <= arg1 < len(SWITCH_KINDS) else arg1}
+        elif event == 6:
+            record.update({"name": "stall", "ph": "B", "tid": 2})
+            record["args"] = {"filled": arg0, "watermark": arg1}
+        elif event == 7:
+            record.update({"name": "stall", "ph": "E", "tid": 2})
+            record["args"] = {"filled": arg0, "stall_ms": arg1}
+        elif event == 13:
+            record.update({"name": "resolve", "ph": "B", "tid": 3})
+            record["args"] = {"station": arg0}
+        elif event == 14:
+            record.update({"name": "resolve", "ph": "E", "tid": 3})
+            record["args"] = {}
+        else:
+            record.update({"ph": "i", "s": "t"})
+        events.append(record)
+
+    events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": 1, "args": {"name": "audio events"}})
+    events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": 2, "args": {"name": "jitter buffer"}})
+    events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": 3, "args": {"name": "resolver"}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the WebRadio trace ring into Chrome trace JSON")
+    parser.add_argument("files", nargs="*", help="saved trace responses, one json per line ('-' for stdin)")
+    parser.add_argument("--host", help="read the ring from the radio at this address")
+    parser.add_argument("--port", type=int, default=TCP_PORT)
+    parser.add_argument("-o", "--output", help="output file, default stdout")
+    args = parser.parse_args()
+
+    if args.host:
+        pages = fetch(args.host, args.port)
+    elif args.files:
+        pages = read_pages(args.files)
+    else:
+        parser.error("either --host or a file is needed")
+
+    entries, lost = decode(pages)
+    if lost:
+        print("%d entries lost (overwritten before they were read)" % lost, file=sys.stderr)
+
+    text = json.dumps(to_chrome(entries), indent=1)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()